@@ -0,0 +1,167 @@
+#ifndef BACKGROUND_KEY_H
+#define BACKGROUND_KEY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BACKGROUND_KEY_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BACKGROUND_KEY_AVX2_TARGET
+#else
+#define BACKGROUND_KEY_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+/// <summary>How the alpha channel of a LiveSplit image is produced, packed into 64 bits to share it between threads.</summary>
+struct key_params
+{
+    /// <summary>The background color as 0xRRGGBB, which matches the BGRX byte order of a captured pixel.</summary>
+    uint32_t color;
+    /// <summary>How far each of the color channels may be off to still count as background.</summary>
+    uint8_t tolerance;
+    /// <summary>The alpha value of every pixel that isn't background.</summary>
+    uint8_t alpha;
+    /// <summary>Whether the background color is made transparent at all.</summary>
+    bool keyed;
+
+    /// <summary>Checks whether the image needs to go through the kernel instead of being copied as it is.</summary>
+    bool enabled() const
+    {
+        return keyed || alpha != 255;
+    }
+
+    uint64_t pack() const
+    {
+        return uint64_t(color & 0xffffff) | uint64_t(tolerance) << 24 | uint64_t(alpha) << 32 | uint64_t(keyed) << 40;
+    }
+
+    static key_params unpack(uint64_t bits)
+    {
+        return { uint32_t(bits & 0xffffff), uint8_t(bits >> 24), uint8_t(bits >> 32), ((bits >> 40) & 1) != 0 };
+    }
+};
+
+/// <summary>
+/// Copies rows of a captured 32-bit image while replacing its meaningless alpha channel: pixels within tolerance of
+/// the background color become fully transparent and all others get the configured opacity. The color channels are
+/// kept as they are (straight alpha). SSE2 and AVX2 versions process four and eight pixels at a time and fall back to
+/// the scalar version for the remainder of a row. The source and destination may be the same memory.
+/// </summary>
+class background_key
+{
+public:
+    /// <summary>Copies and keys a block of rows.</summary>
+    /// <param name="dst">The top-left destination pixel.</param>
+    /// <param name="dst_pitch">Distance between two destination rows in bytes.</param>
+    /// <param name="src">The top-left source pixel.</param>
+    /// <param name="src_pitch">Distance between two source rows in bytes.</param>
+    /// <param name="width">Number of pixels per row.</param>
+    /// <param name="rows">Number of rows.</param>
+    /// <param name="params">Background color, tolerance and opacity.</param>
+    static void apply(uint8_t* dst, size_t dst_pitch, const uint8_t* src, size_t src_pitch, uint32_t width, uint32_t rows, const key_params& params)
+    {
+        static const row_function s_row_function = select_row_function();
+        for (uint32_t y = 0; y < rows; y++, dst += dst_pitch, src += src_pitch)
+            s_row_function(dst, src, width, params);
+    }
+
+    /// <summary>The reference implementation that the vectorized versions must match exactly.</summary>
+    static void apply_row_scalar(uint8_t* dst, const uint8_t* src, uint32_t width, const key_params& params)
+    {
+        const uint32_t opaque = uint32_t(params.alpha) << 24;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t pixel;
+            memcpy(&pixel, src + x * 4, sizeof(pixel));
+            pixel &= 0xffffff;
+            bool background = params.keyed;
+            for (uint32_t shift = 0; shift < 24 && background; shift += 8)
+            {
+                const int difference = int((pixel >> shift) & 0xff) - int((params.color >> shift) & 0xff);
+                background = (difference < 0 ? -difference : difference) <= params.tolerance;
+            }
+            pixel |= background ? 0 : opaque;
+            memcpy(dst + x * 4, &pixel, sizeof(pixel));
+        }
+    }
+
+#ifdef BACKGROUND_KEY_X86
+    static void apply_row_sse2(uint8_t* dst, const uint8_t* src, uint32_t width, const key_params& params)
+    {
+        const __m128i color = _mm_set1_epi32(int(params.color & 0xffffff));
+        const __m128i tolerance = _mm_set1_epi8(char(params.tolerance));
+        const __m128i color_mask = _mm_set1_epi32(0xffffff);
+        const __m128i opaque = _mm_set1_epi32(int(uint32_t(params.alpha) << 24));
+        const __m128i keyed = _mm_set1_epi32(params.keyed ? -1 : 0);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + x * 4)), color_mask);
+            // |pixel - color| per byte, minus the tolerance with saturation, is zero for channels within tolerance.
+            const __m128i difference = _mm_or_si128(_mm_subs_epu8(pixels, color), _mm_subs_epu8(color, pixels));
+            const __m128i outside = _mm_and_si128(_mm_subs_epu8(difference, tolerance), color_mask);
+            const __m128i background = _mm_and_si128(_mm_cmpeq_epi32(outside, _mm_setzero_si128()), keyed);
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(pixels, _mm_andnot_si128(background, opaque)));
+        }
+        apply_row_scalar(dst + x * 4, src + x * 4, width - x, params);
+    }
+
+    BACKGROUND_KEY_AVX2_TARGET static void apply_row_avx2(uint8_t* dst, const uint8_t* src, uint32_t width, const key_params& params)
+    {
+        const __m256i color = _mm256_set1_epi32(int(params.color & 0xffffff));
+        const __m256i tolerance = _mm256_set1_epi8(char(params.tolerance));
+        const __m256i color_mask = _mm256_set1_epi32(0xffffff);
+        const __m256i opaque = _mm256_set1_epi32(int(uint32_t(params.alpha) << 24));
+        const __m256i keyed = _mm256_set1_epi32(params.keyed ? -1 : 0);
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256i pixels = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + x * 4)), color_mask);
+            const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(pixels, color), _mm256_subs_epu8(color, pixels));
+            const __m256i outside = _mm256_and_si256(_mm256_subs_epu8(difference, tolerance), color_mask);
+            const __m256i background = _mm256_and_si256(_mm256_cmpeq_epi32(outside, _mm256_setzero_si256()), keyed);
+            _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_or_si256(pixels, _mm256_andnot_si256(background, opaque)));
+        }
+        apply_row_sse2(dst + x * 4, src + x * 4, width - x, params);
+    }
+#endif
+
+private:
+    typedef void (*row_function)(uint8_t* dst, const uint8_t* src, uint32_t width, const key_params& params);
+
+    static row_function select_row_function()
+    {
+#ifdef BACKGROUND_KEY_X86
+        return has_avx2() ? &apply_row_avx2 : &apply_row_sse2;
+#else
+        return &apply_row_scalar;
+#endif
+    }
+
+#ifdef BACKGROUND_KEY_X86
+    /// <summary>Checks that the CPU supports AVX2 and the OS saves the YMM registers on context switches.</summary>
+    static bool has_avx2()
+    {
+#ifdef _MSC_VER
+        int registers[4];
+        __cpuid(registers, 0);
+        if (registers[0] < 7)
+            return false;
+        __cpuid(registers, 1);
+        const int OSXSAVE = 1 << 27, AVX = 1 << 28;
+        if ((registers[2] & (OSXSAVE | AVX)) != (OSXSAVE | AVX) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(registers, 7, 0);
+        return (registers[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+};
+
+#endif //BACKGROUND_KEY_H
@@ -0,0 +1,156 @@
+#ifndef CAPTURE_PHASE_PREDICTOR_H
+#define CAPTURE_PHASE_PREDICTOR_H
+
+#include <algorithm>
+#include <cstdint>
+
+/// <summary>
+/// Predicts when the overlay will be drawn next and how long a capture takes, so that the worker thread can start
+/// a capture as late as possible and still have it published before that draw. The time between draws is the median
+/// of the recent intervals, which ignores the odd hitch, but captures aim for the shortest recent interval, so that
+/// jitter doesn't make them miss. A capture takes as long as the 90th percentile of the recent captures plus a
+/// margin. The margin doubles whenever a capture misses the draw it was meant for and shrinks again after a run of
+/// captures that made it. Starting late only pays off while the capture takes a small part of a frame and rarely
+/// misses, so captures start right away when they would take up most of a frame or when several of the recent ones
+/// missed. Like capture_scheduler it doesn't read any clock itself; all times are passed in by the
+/// caller in microseconds, so it behaves the same for a recorded trace.
+/// </summary>
+class capture_phase_predictor
+{
+public:
+    /// <summary>Number of recent intervals between draws that the frame time is estimated from.</summary>
+    static constexpr uint32_t FRAME_SAMPLES = 16;
+    /// <summary>Number of recent capture durations that the capture time is estimated from.</summary>
+    static constexpr uint32_t CAPTURE_SAMPLES = 20;
+    /// <summary>Captures are started right away until this many draws and captures were observed.</summary>
+    static constexpr uint32_t MIN_SAMPLES = 8;
+    static constexpr uint64_t MIN_MARGIN_US = 500;
+    static constexpr uint64_t MAX_MARGIN_US = 8000;
+    /// <summary>Number of captures in a row that must make their draw before the margin shrinks.</summary>
+    static constexpr uint32_t SHRINK_AFTER_HITS = 32;
+    /// <summary>Intervals between draws longer than this, like while the game is loading, are not frame times.</summary>
+    static constexpr uint64_t MAX_FRAME_US = 100000;
+    /// <summary>Captures start right away when the capture time and margin exceed this share of a frame.</summary>
+    static constexpr uint32_t MAX_FRAME_PERCENT = 75;
+    /// <summary>Captures start right away while more of the last CAPTURE_SAMPLES captures than this missed.</summary>
+    static constexpr uint32_t MAX_RECENT_MISSES = 1;
+
+    /// <summary>Forgets everything learned, for example after the overlay was hidden for a while.</summary>
+    void reset()
+    {
+        *this = capture_phase_predictor();
+    }
+
+    /// <summary>Records that the overlay was drawn.</summary>
+    void on_draw(uint64_t now_us)
+    {
+        if (_last_draw_us != 0 && now_us - _last_draw_us <= MAX_FRAME_US)
+        {
+            _frames[_frame_count++ % FRAME_SAMPLES] = now_us - _last_draw_us;
+            _frame_us = percentile(_frames, (std::min)(_frame_count, FRAME_SAMPLES), 50);
+            _shortest_frame_us = *std::min_element(_frames, _frames + (std::min)(_frame_count, FRAME_SAMPLES));
+        }
+        _last_draw_us = now_us;
+    }
+
+    /// <summary>Records the outcome of a capture that was published to the render thread.</summary>
+    /// <param name="duration_us">The time from starting the capture to publishing it.</param>
+    /// <param name="missed">Whether the overlay was drawn before the capture was published, so that the draw it
+    /// was meant for showed the previous frame.</param>
+    void on_capture(uint64_t duration_us, bool missed)
+    {
+        _captures[_capture_count++ % CAPTURE_SAMPLES] = duration_us;
+        _capture_us = percentile(_captures, (std::min)(_capture_count, CAPTURE_SAMPLES), 90);
+        _missed_history = ((_missed_history << 1) | (missed ? 1 : 0)) & ((1u << CAPTURE_SAMPLES) - 1);
+        if (missed)
+        {
+            _margin_us = (std::min)(_margin_us * 2, MAX_MARGIN_US);
+            _misses++;
+            _hits = 0;
+        }
+        else if (++_hits >= SHRINK_AFTER_HITS)
+        {
+            _margin_us = (std::max)(_margin_us - _margin_us / 4, MIN_MARGIN_US);
+            _hits = 0;
+        }
+    }
+
+    /// <summary>How long to wait before starting a capture, so that it is published just before the next draw.</summary>
+    /// <param name="now_us">The time at which the capture could be started right away.</param>
+    /// <returns>The delay in microseconds, or 0 to capture right away.</returns>
+    uint64_t start_delay_us(uint64_t now_us) const
+    {
+        if (_frame_count < MIN_SAMPLES || _capture_count < MIN_SAMPLES)
+            return 0;
+        if ((_capture_us + _margin_us) * 100 > _frame_us * MAX_FRAME_PERCENT || recent_misses() > MAX_RECENT_MISSES)
+            return 0;
+        // Aim for the draw coming as early as any of the recent ones, so that a jittery frame time doesn't make
+        // captures miss.
+        const uint64_t start_us = _last_draw_us + _shortest_frame_us - (std::min)(_capture_us + _margin_us, _shortest_frame_us);
+        return start_us > now_us ? start_us - now_us : 0;
+    }
+
+    /// <summary>When the overlay is expected to be drawn next, or 0 while nothing was drawn.</summary>
+    uint64_t next_draw_us() const
+    {
+        return _last_draw_us != 0 ? _last_draw_us + _frame_us : 0;
+    }
+
+    /// <summary>The estimated time between two draws.</summary>
+    uint64_t frame_us() const
+    {
+        return _frame_us;
+    }
+
+    /// <summary>The estimated duration of a capture, without the margin.</summary>
+    uint64_t capture_us() const
+    {
+        return _capture_us;
+    }
+
+    uint64_t margin_us() const
+    {
+        return _margin_us;
+    }
+
+    /// <summary>Number of captures that were published after the draw they were meant for.</summary>
+    uint64_t misses() const
+    {
+        return _misses;
+    }
+
+    /// <summary>Number of the last CAPTURE_SAMPLES captures that missed their draw.</summary>
+    uint32_t recent_misses() const
+    {
+        uint32_t count = 0;
+        for (uint32_t history = _missed_history; history != 0; history &= history - 1)
+            count++;
+        return count;
+    }
+
+private:
+    template <uint32_t count>
+    static uint64_t percentile(const uint64_t (&samples)[count], uint32_t used, uint32_t percent)
+    {
+        uint64_t sorted[count];
+        std::copy(samples, samples + used, sorted);
+        const uint32_t rank = (used - 1) * percent / 100;
+        std::nth_element(sorted, sorted + rank, sorted + used);
+        return sorted[rank];
+    }
+
+    uint64_t _frames[FRAME_SAMPLES] = {};
+    uint32_t _frame_count = 0;
+    uint64_t _frame_us = 0;
+    uint64_t _shortest_frame_us = 0;
+    uint64_t _last_draw_us = 0;
+    uint64_t _captures[CAPTURE_SAMPLES] = {};
+    uint32_t _capture_count = 0;
+    uint64_t _capture_us = 0;
+    uint64_t _margin_us = MIN_MARGIN_US;
+    uint32_t _hits = 0;
+    uint64_t _misses = 0;
+    uint32_t _missed_history = 0;
+};
+
+#endif //CAPTURE_PHASE_PREDICTOR_H
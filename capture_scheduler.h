@@ -0,0 +1,135 @@
+#ifndef CAPTURE_SCHEDULER_H
+#define CAPTURE_SCHEDULER_H
+
+#include <algorithm>
+#include <cstdint>
+
+/// <summary>
+/// Decides on which presented frames the worker thread should capture LiveSplit. It doesn't read any clock itself;
+/// all times are passed in by the caller in microseconds, so it behaves the same for a recorded sequence of calls.
+/// </summary>
+class capture_scheduler
+{
+public:
+    /// <summary>Capture rate that captures on every presented frame.</summary>
+    static constexpr int RATE_EVERY_FRAME = 0;
+    /// <summary>Capture rate that follows the interval at which LiveSplit's image is observed to change.</summary>
+    static constexpr int RATE_MATCH_LIVESPLIT = -1;
+    /// <summary>Number of identical captures in a row before adaptive mode starts backing off.</summary>
+    static constexpr uint32_t BACKOFF_THRESHOLD = 8;
+    /// <summary>The longest interval that adaptive mode backs off to.</summary>
+    static constexpr uint64_t MAX_BACKOFF_US = 250000;
+    /// <summary>Number of observed change intervals that make up an estimate of LiveSplit's repaint interval.</summary>
+    static constexpr uint32_t CALIBRATION_SAMPLES = 15;
+    /// <summary>How long an estimate of LiveSplit's repaint interval is used before measuring again.</summary>
+    static constexpr uint64_t RECALIBRATION_US = 10000000;
+
+    /// <summary>Changes the capture rate. Any learned or backed off state is reset.</summary>
+    /// <param name="rate">Captures per second, or one of the RATE_ constants.</param>
+    /// <param name="adaptive">Whether to capture less often while LiveSplit's image doesn't change.</param>
+    void configure(int rate, bool adaptive)
+    {
+        _rate = rate;
+        _adaptive = adaptive;
+        _unchanged = 0;
+        _samples = 0;
+        _estimate_us = 0;
+        _last_change_us = 0;
+    }
+
+    /// <summary>Checks whether a capture should be started for the frame presented at the given time.</summary>
+    bool is_due(uint64_t now_us) const
+    {
+        return !_started || now_us - _last_start_us >= interval_us();
+    }
+
+    /// <summary>The current minimum time between the start of two captures.</summary>
+    uint64_t interval_us() const
+    {
+        uint64_t interval = 0;
+        if (_rate > 0)
+            interval = 1000000 / _rate;
+        else if (_rate == RATE_MATCH_LIVESPLIT)
+            interval = _estimate_us;
+
+        if (_adaptive && _unchanged > BACKOFF_THRESHOLD)
+        {
+            // Double the interval for every further identical capture, starting from at least a millisecond.
+            const uint32_t doublings = (std::min)(_unchanged - BACKOFF_THRESHOLD, 16u);
+            interval = (std::min)((std::max)(interval, uint64_t(1000)) << doublings, (std::max)(interval, MAX_BACKOFF_US));
+        }
+        return interval;
+    }
+
+    /// <summary>The estimated interval at which LiveSplit repaints or 0 while it is still being measured.</summary>
+    uint64_t estimate_us() const
+    {
+        return _estimate_us;
+    }
+
+    /// <summary>Records that a capture was started.</summary>
+    void on_capture_started(uint64_t now_us)
+    {
+        // Keep fixed rates from drifting, unless we fell behind by more than an interval.
+        const uint64_t interval = interval_us();
+        if (_started && interval != 0 && now_us - _last_start_us < 2 * interval)
+            _last_start_us += interval;
+        else
+            _last_start_us = now_us;
+        _started = true;
+    }
+
+    /// <summary>Records the outcome of a capture.</summary>
+    /// <param name="now_us">The time at which the capture was found to differ or not from the previous one.</param>
+    /// <param name="changed">Whether LiveSplit's image changed.</param>
+    void on_capture_finished(uint64_t now_us, bool changed)
+    {
+        if (!changed)
+        {
+            _unchanged++;
+            return;
+        }
+        _unchanged = 0;
+
+        if (_rate == RATE_MATCH_LIVESPLIT)
+        {
+            // The estimate is only measured while capturing every frame, since a slower capture rate can only observe
+            // changes at multiples of its own interval. After a while the estimate is dropped to measure it again.
+            if (_estimate_us != 0)
+            {
+                if (now_us - _estimate_time_us >= RECALIBRATION_US)
+                {
+                    _estimate_us = 0;
+                    _samples = 0;
+                    _last_change_us = 0;
+                }
+            }
+            else
+            {
+                if (_last_change_us != 0)
+                    _intervals[_samples++] = now_us - _last_change_us;
+                _last_change_us = now_us;
+                if (_samples == CALIBRATION_SAMPLES)
+                {
+                    std::nth_element(_intervals, _intervals + CALIBRATION_SAMPLES / 2, _intervals + CALIBRATION_SAMPLES);
+                    _estimate_us = _intervals[CALIBRATION_SAMPLES / 2];
+                    _estimate_time_us = now_us;
+                }
+            }
+        }
+    }
+
+private:
+    int _rate = RATE_EVERY_FRAME;
+    bool _adaptive = false;
+    bool _started = false;
+    uint64_t _last_start_us = 0;
+    uint32_t _unchanged = 0;
+    uint32_t _samples = 0;
+    uint64_t _intervals[CALIBRATION_SAMPLES] = {};
+    uint64_t _last_change_us = 0;
+    uint64_t _estimate_us = 0;
+    uint64_t _estimate_time_us = 0;
+};
+
+#endif //CAPTURE_SCHEDULER_H
@@ -9,352 +9,2430 @@ const char* const INI_ALIGNMENT_X = "AlignmentX";
 const char* const INI_ALIGNMENT_Y = "AlignmentY";
 const char* const INI_OFFSET_X = "OffsetX";
 const char* const INI_OFFSET_Y = "OffsetY";
+const char* const INI_CAPTURE_RATE = "CaptureRate";
+const char* const INI_CAPTURE_ADAPTIVE = "CaptureAdaptive";
+const char* const INI_CAPTURE_LATE = "CaptureLate";
+const char* const INI_SHOW_STATISTICS = "ShowStatistics";
+const char* const INI_STATISTICS_CSV = "StatisticsCsv";
+const char* const INI_RECORD = "Record";
+const char* const INI_FRAME_SOURCE = "FrameSource";
+const char* const INI_KEY_BACKGROUND = "KeyBackground";
+const char* const INI_KEY_COLOR = "KeyColor";
+const char* const INI_KEY_TOLERANCE = "KeyTolerance";
+const char* const INI_OPACITY = "Opacity";
+const char* const INI_SCALE = "Scale";
+const char* const INI_SCALE_FILTER = "ScaleFilter";
+const char* const INI_REGIONS = "Regions";
+const char* const INI_SOURCES = "Sources";
+const char* const INI_TEXTURE_UPLOAD = "TextureUpload";
+const wchar_t* const STATISTICS_CSV_FILE_NAME = L"livesplit_overlay_statistics.csv";
+/// <summary>
+/// How often the recorder's writer thread encodes and writes what was queued, unless it is woken earlier because
+/// frames are piling up.
+/// </summary>
+const DWORD RECORDER_INTERVAL_MS = 10;
+const char* const CAPTURE_RATE_NAMES = "Every frame\0" "30 Hz\0" "60 Hz\0" "120 Hz\0" "Match LiveSplit\0";
+const int CAPTURE_RATES[] = { capture_scheduler::RATE_EVERY_FRAME, 30, 60, 120, capture_scheduler::RATE_MATCH_LIVESPLIT };
+const char* const FRAME_SOURCE_NAMES = "LiveSplit window\0" "Synthetic timer (300x100)\0" "Synthetic splits (300x460)\0" "Synthetic splits, 4K scaled (600x920)\0" "LiveSplit Server (native timer)\0" "Shared memory publisher\0";
+const int FRAME_SOURCE_LIVESPLIT = 0;
+/// <summary>Width, split count and scale of the synthetic frame sources, following FRAME_SOURCE_LIVESPLIT.</summary>
+const uint32_t SYNTHETIC_LAYOUTS[][3] = { { 300, 0, 1 }, { 300, 15, 1 }, { 300, 15, 2 } };
+/// <summary>Frame source that draws the timer from the state reported by the LiveSplit Server instead of capturing it.</summary>
+const int FRAME_SOURCE_SERVER = 1 + int(std::size(SYNTHETIC_LAYOUTS));
+/// <summary>Frame source that reads the frames another process publishes through a shared_frame_ring.</summary>
+const int FRAME_SOURCE_SHARED_MEMORY = FRAME_SOURCE_SERVER + 1;
+/// <summary>How long the shared frame ring may go without a new frame before it is opened again, in case its publisher created it anew.</summary>
+const uint64_t SHARED_RING_REOPEN_US = 2000000;
+/// <summary>How far the extrapolated timer may be off before a new timer state is handed to the render thread.</summary>
+const int64_t TIMER_TOLERANCE_US = 4000;
+/// <summary>How often the timer state is queried from the LiveSplit Server. The render thread advances the time in between.</summary>
+const uint64_t SERVER_POLL_INTERVAL_US = 100000;
+const char* const SCALE_FILTER_NAMES = "Box filter (CPU)\0" "Bilinear filter (CPU)\0" "GPU\0";
+/// <summary>Scale filter that leaves the image at its captured size and lets the GPU scale it while drawing.</summary>
+const int SCALE_FILTER_GPU = 2;
+const char* const TEXTURE_UPLOAD_NAMES = "Staging buffers (optimal tiling)\0" "Mapped textures (linear tiling)\0";
+/// <summary>
+/// How Vulkan uploads frames: through staging buffers into an optimally tiled texture, or into mapped linear textures
+/// that the worker thread can capture straight into. D3D12 always uses staging buffers and the other APIs always map.
+/// </summary>
+const int TEXTURE_UPLOAD_STAGING = 0;
+const int TEXTURE_UPLOAD_MAPPED = 1;
+const size_t MAX_REGIONS = 8;
+const size_t MAX_SOURCES = 4;
+/// <summary>The range of an additional window's priority and capture rate, where a rate of 0 follows LiveSplit.</summary>
+const int MAX_SOURCE_PRIORITY = 9;
+const int MAX_SOURCE_RATE = 120;
+/// <summary>How long the worker thread may spend on capturing additional windows in one pass. Windows that don't fit keep their previous image.</summary>
+const uint64_t SOURCE_TIME_BUDGET_US = 4000;
+/// <summary>Placement of a frame region: the whole LiveSplit window, or the n-th region or additional window from the settings.</summary>
+const uint32_t PLACEMENT_LIVESPLIT = 0;
+const uint32_t PLACEMENT_REGION = 1;
+const uint32_t PLACEMENT_SOURCE = PLACEMENT_REGION + MAX_REGIONS;
 const char* const SPINNER_CHARS = "|\\-/";
-const resource_view_desc TEXTURE_VIEW_DESCRIPTOR = resource_view_desc(format::b8g8r8a8_unorm);
+const uint64_t MAX_FRAMES_IN_FLIGHT = 3;
+/// <summary>
+/// How long a device's destruction waits for the worker thread to finish a pass that may be writing to the device's
+/// upload ring, before it leaves the ring alone instead.
+/// </summary>
+const DWORD RING_RELEASE_TIMEOUT_MS = 200;
+
+/// <summary>A part of the LiveSplit window that is shown on its own, with its own placement on screen.</summary>
+struct livesplit_region
+{
+    /// <summary>Left, top, width and height of the part in the LiveSplit window.</summary>
+    int source[4];
+    float alignment[2];
+    int offsets[2];
+};
+
+/// <summary>Another window that is captured along with LiveSplit and shown with its own placement on screen.</summary>
+struct capture_source
+{
+    /// <summary>File name of the window's executable, as UTF-8.</summary>
+    char image[64];
+    /// <summary>The window title as UTF-8, where * stands for any text and ? for any single character.</summary>
+    char title[128];
+    float alignment[2];
+    int offsets[2];
+    /// <summary>Windows with a higher priority are captured first when the time budget runs out.</summary>
+    int priority;
+    /// <summary>Captures per second, or 0 to capture the window whenever LiveSplit is captured.</summary>
+    int rate;
+};
+
+/// <summary>What the worker thread needs to know about an additional window.</summary>
+struct shared_capture_source
+{
+    std::wstring image_suffix;
+    std::wstring title;
+    int priority;
+    int rate;
+};
 
 // Settings
 static bool g_show_livesplit = true;
 static float g_livesplit_alignment[2] = { 0 ,0 };
 static int g_livesplit_offsets[2] = { 0 ,0 };
+static int g_capture_rate = capture_scheduler::RATE_EVERY_FRAME;
+static bool g_capture_adaptive = false;
+static bool g_capture_late = true;
+static bool g_show_statistics = false;
+static bool g_statistics_csv = false;
+static bool g_record = false;
+static std::atomic<int> g_frame_source = FRAME_SOURCE_LIVESPLIT;
+static bool g_key_background = false;
+static float g_key_color[3] = { 0, 0, 0 };
+static int g_key_tolerance = 8;
+static float g_opacity = 1;
+static float g_scale = 1;
+static int g_scale_filter = image_scaler::FILTER_BOX;
+static int g_texture_upload = TEXTURE_UPLOAD_STAGING;
+static std::vector<livesplit_region> g_livesplit_regions;
+static std::vector<capture_source> g_capture_sources;
+static std::atomic<uint64_t> g_key_params = key_params { 0, 8, 255, false }.pack();
+static std::atomic<float> g_shared_scale = 1;
+static std::atomic<int> g_shared_scale_filter = image_scaler::FILTER_BOX;
+static std::mutex g_shared_layout_mutex;
+static std::vector<dirty_rect> g_shared_regions;
+static std::vector<shared_capture_source> g_shared_sources;
+static std::atomic<uint32_t> g_shared_layout_version = 0;
+
+/// <summary>The parts of the pipeline whose duration is measured for the statistics.</summary>
+enum pipeline_stage
+{
+    STAGE_DISCOVERY, // Looking for the LiveSplit window on the worker thread.
+    STAGE_CAPTURE,   // Copying the LiveSplit window with GetDIBits() on the worker thread.
+    STAGE_DIFF,      // Finding the changed tiles on the worker thread.
+    STAGE_SCALE,     // Scaling images down and packing regions on the worker thread.
+    STAGE_KEYING,    // Copying or keying the changed parts of images into the upload ring on the worker thread.
+    STAGE_RECORD,    // Queuing a copy of each published image for the recorder on the worker thread.
+    STAGE_UPLOAD,    // Mapping, copying to and unmapping textures on the render thread.
+    STAGE_SUBMIT,    // Adding the LiveSplit image to ImGui's draw list on the render thread.
+    STAGE_DRAW,      // All of the above that happens on the render thread.
+    STAGE_AGE,       // The time from starting a capture until its frame is first drawn, which is latency, not work.
+    STAGE_COUNT
+};
+const char* const STAGE_NAMES[STAGE_COUNT] = { "discovery", "capture", "diff", "scale", "keying", "record", "upload", "submit", "draw", "age" };
+
+/// <summary>A part of a frame's image and the placement on screen it is drawn with.</summary>
+struct frame_region
+{
+    dirty_rect rect;
+    /// <summary>PLACEMENT_LIVESPLIT, or PLACEMENT_REGION or PLACEMENT_SOURCE plus the index in the respective setting.</summary>
+    uint32_t placement;
+};
+
+/// <summary>
+/// A copy of the LiveSplit window, handed from the worker thread to the render thread. Its image is either in pixels
+/// or in the upload ring's texture ring_texture.
+/// </summary>
+struct livesplit_frame : frame_image
+{
+    /// <summary>When the worker thread started the pass that captured the frame, in microseconds.</summary>
+    uint64_t captured_us = 0;
+    /// <summary>The upload ring the image was captured into, or 0 if it was captured into pixels.</summary>
+    uint64_t ring_id = 0;
+    /// <summary>
+    /// The texture of an upload ring that the frame is drawn from. The worker thread hands each frame one that the GPU
+    /// is done with, which the render thread copies the image to if it is in pixels.
+    /// </summary>
+    size_t ring_texture = 0;
+    /// <summary>Host memory for the image, used until the render thread provides an upload ring of the right size.</summary>
+    std::vector<uint8_t> pixels;
+    /// <summary>The factor to scale the image by when drawing it, if it wasn't already scaled by the worker thread.</summary>
+    float draw_scale = 1;
+    /// <summary>Where the regions and additional windows were packed into the image, or nothing to show the whole image.</summary>
+    std::vector<frame_region> regions;
+    /// <summary>Whether timer holds a state received from the LiveSplit Server, which is then drawn as text.</summary>
+    bool timer_connected = false;
+    timer_state timer;
+    /// <summary>An error or informational message for the OSD.</summary>
+    std::string status;
+};
+
+/// <summary>The worker thread's state of an additional window.</summary>
+struct source_state
+{
+    /// <summary>The index in the settings, which decides the placement.</summary>
+    uint32_t index = 0;
+    std::unique_ptr<window_discovery> discovery;
+    int priority = 0;
+    int rate = 0;
+    HWND window_handle = NULL;
+    /// <summary>The last captured image as top-down BGRX rows.</summary>
+    std::vector<uint8_t> pixels;
+    uint32_t width = 0, height = 0;
+    uint64_t last_capture_us = 0;
+    bool have_image = false;
+};
+
+/// <summary>The worker thread's state of the shared frame ring.</summary>
+struct shared_ring_state
+{
+    shared_frame_ring ring;
+    /// <summary>The sequence of the frame that was read last, or 0 if the next frame must be read regardless.</summary>
+    uint64_t sequence = 0;
+    /// <summary>The number of frames published so far and when it last changed, to notice a publisher that left.</summary>
+    uint64_t published = 0;
+    uint64_t published_us = 0;
+};
+
+/// <summary>An image that compose_capture() packs into the frame.</summary>
+struct capture_piece
+{
+    const uint8_t* data;
+    size_t row_pitch;
+    uint32_t width, height;
+    uint32_t placement;
+};
+
+/// <summary>
+/// Textures of an upload ring: one for each slot of the frame mailbox, and as many spares as frames the GPU may be
+/// behind, so that a slot always finds a texture the GPU no longer samples from.
+/// </summary>
+const size_t RING_TEXTURE_COUNT = frame_mailbox<livesplit_frame>::SLOT_COUNT + MAX_FRAMES_IN_FLIGHT;
+
+/// <summary>
+/// Persistently mapped textures that the worker thread writes frames to directly. Whoever owns a mailbox slot also
+/// owns the texture that the slot's frame names, so the render thread only has to bind the texture of the frame it
+/// took instead of copying the frame.
+/// </summary>
+struct upload_ring
+{
+    uint64_t id = 0;
+    /// <summary>The device the textures were created on.</summary>
+    device* api_device = nullptr;
+    uint32_t width = 0, height = 0;
+    resource textures[RING_TEXTURE_COUNT] = {};
+    resource_view views[RING_TEXTURE_COUNT] = {};
+    subresource_data mapped[RING_TEXTURE_COUNT] = {};
+    /// <summary>The ring epoch the worker thread must have seen before a retired ring can be destroyed.</summary>
+    uint64_t retire_epoch = 0;
+    /// <summary>The draw of its device after which the GPU no longer samples from a retired ring.</summary>
+    uint64_t retire_draw = 0;
+};
+
+/// <summary>Which frame an upload ring's texture holds, as far as the worker thread knows.</summary>
+struct ring_slot_content
+{
+    /// <summary>The ring the texture belongs to, or 0 if its content is unknown.</summary>
+    uint64_t ring_id;
+    uint64_t generation;
+    uint32_t width, height;
+};
+
+/// <summary>The parts of the image that a published generation changed, or the whole image.</summary>
+struct published_change
+{
+    uint64_t generation = 0;
+    bool full = true;
+    std::vector<dirty_rect> rects;
+};
+
+// Other globals
+static HANDLE g_thread;
+static HANDLE g_event_worker_go;
+/// <summary>Signaled while the worker thread isn't in a pass, so that it can be waited for without polling.</summary>
+static HANDLE g_event_worker_idle;
+static worker_lifecycle g_worker_lifecycle;
+static std::atomic<bool> g_terminate_thread = false;
+static std::atomic<bool> g_worker_busy = false;
+static std::atomic<bool> g_capture_changed = false;
+static bool g_capture_pending = false;
+static capture_scheduler g_capture_scheduler;
+/// <summary>Learns when to start captures on the render thread. The worker thread reports back through the atomics below.</summary>
+static capture_phase_predictor g_capture_phase;
+/// <summary>When the worker thread should start the capture it was woken for, or 0 to start right away.</summary>
+static std::atomic<uint64_t> g_capture_start_us = 0;
+/// <summary>How long the last capture took until it was published, or 0 if it didn't publish anything.</summary>
+static std::atomic<uint64_t> g_capture_duration_us = 0;
+/// <summary>Whether the overlay was drawn before the last capture was published.</summary>
+static std::atomic<bool> g_capture_missed = false;
+static std::atomic<uint64_t> g_last_draw_us = 0;
+static frame_mailbox<livesplit_frame> g_frames;
+static uint64_t g_frame_generation = 0;
+static std::string g_osd_text = "";
+static const char* g_texture_error = nullptr;
+static BITMAPINFOHEADER g_bitmap_info_header = { sizeof(BITMAPINFOHEADER), 0, 0, 1, 32, BI_RGB };
+static tile_diff g_tile_diff;
+static std::vector<uint8_t> g_capture_buffer;
+static uint32_t g_capture_width = 0, g_capture_height = 0;
+static image_scaler g_image_scaler;
+static std::vector<dirty_rect> g_regions;
+static std::vector<source_state> g_sources;
+static std::vector<capture_piece> g_capture_pieces;
+static std::vector<dirty_rect> g_capture_rows;
+static float g_draw_scale = 1;
+static HWND g_livesplit_window_handle = NULL;
+static window_discovery* g_window_discovery = nullptr;
+static std::atomic<upload_ring*> g_upload_ring = nullptr;
+static std::atomic<uint64_t> g_ring_epoch = 0;
+static std::atomic<uint64_t> g_worker_ring_epoch = 0;
+static upload_ring* g_ring = nullptr;
+static std::vector<upload_ring*> g_retired_rings;
+static uint64_t g_next_ring_id = 1;
+/// <summary>
+/// Host memory that the worker thread builds images for the upload ring in. Only the changed parts are then copied or
+/// keyed into the ring's texture, whose write-combined memory is slow to read back, so that neither change detection
+/// nor the recorder read from it.
+/// </summary>
+static std::vector<uint8_t> g_ring_staging_buffer;
+static ring_slot_content g_ring_texture_contents[RING_TEXTURE_COUNT] = {};
+/// <summary>The upload ring texture that each mailbox slot owns, and those that none does. Only the worker thread swaps them.</summary>
+static size_t g_ring_slot_textures[frame_mailbox<livesplit_frame>::SLOT_COUNT] = { 0, 1, 2 };
+static size_t g_ring_spare_textures[RING_TEXTURE_COUNT - frame_mailbox<livesplit_frame>::SLOT_COUNT] = { 3, 4, 5 };
+static_assert(RING_TEXTURE_COUNT == 6, "Every upload ring texture must start out in a slot or among the spares.");
+/// <summary>Counts the presents of the device that the upload rings are created on.</summary>
+static std::atomic<uint64_t> g_ring_draw_count = 0;
+/// <summary>For each upload ring texture, the value of g_ring_draw_count from which on the GPU no longer samples from it.</summary>
+static std::atomic<uint64_t> g_ring_texture_free_draws[RING_TEXTURE_COUNT] = {};
+/// <summary>The changes of the last published generations, indexed by generation modulo the count.</summary>
+static published_change g_published_changes[8];
+static std::vector<dirty_rect> g_ring_copy_rects;
+/// <summary>The device that new upload rings are created on. Retired rings may still belong to another one.</summary>
+static device* g_ring_device = nullptr;
+/// <summary>Guards the render side, which the render threads of several devices may run concurrently.</summary>
+static std::mutex g_render_mutex;
+static bool g_livesplit_showing = false;
+
+// Statistics
+static std::atomic<uint64_t> g_captured_bytes = 0;
+static uint64_t g_copied_bytes = 0;
+static uint64_t g_stats_start_us = 0;
+static uint64_t g_stats_frames = 0;
+static uint64_t g_stats_captured_bytes = 0;
+static uint64_t g_stats_copied_bytes = 0;
+static double g_captured_kib_per_frame = 0;
+static double g_copied_kib_per_frame = 0;
+static stage_histogram g_stage_histograms[STAGE_COUNT];
+static stage_histogram::summary g_stage_summaries[STAGE_COUNT] = {};
+static stage_histogram g_source_histograms[MAX_SOURCES];
+static stage_histogram::summary g_source_summaries[MAX_SOURCES] = {};
+static HMODULE g_module_handle = NULL;
+static FILE* g_statistics_csv_file = nullptr;
+static uint64_t g_statistics_csv_start_us = 0;
+static const char* g_statistics_error = nullptr;
+static frame_recorder g_recorder;
+/// <summary>Whether frames and presents are queued for the recorder's writer thread.</summary>
+static std::atomic<bool> g_recording = false;
+static HANDLE g_recorder_thread = NULL;
+static std::atomic<bool> g_recorder_stop = false;
+/// <summary>Wakes the recorder's writer thread. It lives as long as the add-on, since the worker thread may still
+/// signal it after a recording stopped.</summary>
+static HANDLE g_event_recorder_wake = NULL;
+/// <summary>Set by the writer thread when writing failed, so that recording isn't started over and over.</summary>
+static std::atomic<bool> g_recording_failed = false;
+static FILE* g_recording_file = nullptr;
+static const char* g_recording_error = nullptr;
+static uint64_t g_texture_creations = 0;
+static std::atomic<uint64_t> g_host_allocations = 0;
+/// <summary>The texture creations and host buffer allocations counted at the end of each of the last 60 seconds.</summary>
+static uint64_t g_allocation_history[60][2] = {};
+static uint32_t g_allocation_second = 0;
+static uint64_t g_textures_per_minute = 0;
+static uint64_t g_host_allocations_per_minute = 0;
+
+/// <summary>Gets the frequency of the high resolution performance counter, which is fixed at boot.</summary>
+static uint64_t get_counter_frequency()
+{
+    static LARGE_INTEGER s_frequency = {};
+    if (s_frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&s_frequency);
+    return uint64_t(s_frequency.QuadPart);
+}
+
+/// <summary>Reads the high resolution performance counter.</summary>
+/// <returns>The current time in microseconds.</returns>
+static uint64_t get_time_us()
+{
+    const uint64_t frequency = get_counter_frequency();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return uint64_t(counter.QuadPart) / frequency * 1000000 + uint64_t(counter.QuadPart) % frequency * 1000000 / frequency;
+}
+
+/// <summary>Measures the time from its construction to its destruction as one sample of a pipeline stage.</summary>
+class stage_timer
+{
+public:
+    explicit stage_timer(_In_ pipeline_stage stage) : stage_timer(g_stage_histograms[stage])
+    {
+    }
+
+    explicit stage_timer(_In_ stage_histogram& histogram) : _histogram(histogram)
+    {
+        QueryPerformanceCounter(&_start);
+    }
+
+    ~stage_timer()
+    {
+        LARGE_INTEGER end;
+        QueryPerformanceCounter(&end);
+        _histogram.record(uint64_t(end.QuadPart - _start.QuadPart) * 1000000000 / get_counter_frequency());
+    }
+
+private:
+    stage_histogram& _histogram;
+    LARGE_INTEGER _start;
+};
+
+/// <summary>Provides window_discovery with the desktop's windows through the Win32 API.</summary>
+class win32_window_enumerator : public window_enumerator
+{
+public:
+    void enumerate(std::vector<window_id>& windows) override
+    {
+        EnumWindows(&add_window, (LPARAM)&windows);
+    }
+
+    bool is_visible(window_id window) override
+    {
+        return IsWindowVisible((HWND)window) != FALSE;
+    }
+
+    uint32_t get_process_id(window_id window) override
+    {
+        DWORD process_id = 0;
+        GetWindowThreadProcessId((HWND)window, &process_id);
+        return process_id;
+    }
+
+    bool get_process_image(uint32_t process_id, std::wstring& image) override
+    {
+        HANDLE process_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id);
+        if (process_handle == NULL)
+            return false;
+
+        DWORD file_name_length;
+        while (true)
+        {
+            file_name_length = GetProcessImageFileNameW(process_handle, &_text_buffer[0], (DWORD)_text_buffer.size());
+            if (file_name_length != 0 || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+                break;
+            _text_buffer.resize(_text_buffer.size() * 2);
+        }
+        CloseHandle(process_handle);
+
+        image.assign(&_text_buffer[0], file_name_length);
+        return file_name_length != 0;
+    }
+
+    bool get_title(window_id window, std::wstring& title) override
+    {
+        const int title_length = GetWindowTextLengthW((HWND)window);
+        if ((size_t)title_length >= _text_buffer.size())
+            _text_buffer.resize(title_length + 1);
+        const int copied_length = GetWindowTextW((HWND)window, &_text_buffer[0], (int)_text_buffer.size());
+        title.assign(&_text_buffer[0], copied_length);
+        return true;
+    }
+
+private:
+    /// <summary>Collects the windows listed by EnumWindows().</summary>
+    static BOOL CALLBACK add_window(_In_ HWND hWnd, _In_ LPARAM lParam)
+    {
+        ((std::vector<window_id>*)lParam)->push_back((window_id)hWnd);
+        return TRUE;
+    }
+
+    std::vector<WCHAR> _text_buffer = std::vector<WCHAR>(64);
+};
+
+/// <summary>
+/// Forwards window notifications to the window discoveries of LiveSplit and the additional windows. The hooks are
+/// installed by the worker thread, which receives these calls while it waits for the next capture.
+/// </summary>
+static void CALLBACK on_window_event(_In_ HWINEVENTHOOK, _In_ DWORD event, _In_ HWND hWnd, _In_ LONG idObject, _In_ LONG idChild, _In_ DWORD, _In_ DWORD)
+{
+    if (hWnd == NULL || idObject != OBJID_WINDOW || idChild != CHILDID_SELF || g_window_discovery == nullptr)
+        return;
+
+    if (event == EVENT_OBJECT_DESTROY || event == EVENT_OBJECT_HIDE)
+    {
+        g_window_discovery->on_window_removed((window_enumerator::window_id)hWnd);
+        for (source_state& source : g_sources)
+            source.discovery->on_window_removed((window_enumerator::window_id)hWnd);
+    }
+    else if (GetAncestor(hWnd, GA_ROOT) == hWnd)
+    {
+        g_window_discovery->on_window_changed((window_enumerator::window_id)hWnd);
+        for (source_state& source : g_sources)
+            source.discovery->on_window_changed((window_enumerator::window_id)hWnd);
+    }
+}
+
+/// <summary>
+/// Resizes a host buffer. The capacity grows by size classes and never shrinks, so a buffer only allocates when the
+/// image outgrows the class it had, and not while LiveSplit's height keeps changing a little.
+/// </summary>
+/// <param name="buffer">The buffer to resize.</param>
+/// <param name="size">The new size in bytes.</param>
+static void resize_host_buffer(_Inout_ std::vector<uint8_t>& buffer, _In_ size_t size)
+{
+    if (size > buffer.capacity())
+    {
+        buffer.reserve(size_t(size_class::round_up(size)));
+        g_host_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    buffer.resize(size);
+}
+
+/// <summary>
+/// Decides where a frame's image goes. If the image fits into the upload ring, it is built in g_ring_staging_buffer
+/// and committed to the frame's ring texture once it is published. Otherwise it goes to the frame's host memory.
+/// </summary>
+/// <param name="frame">The frame to receive the image.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="width">Width of the image.</param>
+/// <param name="height">Height of the image.</param>
+static void prepare_frame_storage(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _In_ uint32_t width, _In_ uint32_t height)
+{
+    frame.width = width;
+    frame.height = height;
+    if (ring != nullptr && width <= ring->width && height <= ring->height)
+    {
+        frame.ring_id = ring->id;
+        frame.row_pitch = size_t(width) * 4;
+        resize_host_buffer(g_ring_staging_buffer, frame.row_pitch * height);
+        frame.data = g_ring_staging_buffer.data();
+    }
+    else
+    {
+        // The frame slots are recycled, so this only allocates when the image grew since the slot was last used.
+        frame.ring_id = 0;
+        frame.row_pitch = size_t(width) * 4;
+        resize_host_buffer(frame.pixels, frame.row_pitch * height);
+        frame.data = frame.pixels.data();
+    }
+}
+
+/// <summary>
+/// Decides where the worker thread captures an image to. Without regions, additional windows or scaling on the CPU
+/// that is the frame's storage. Otherwise the image is captured at full size into g_capture_buffer and
+/// compose_capture() packs the regions into the frame, scaling them on the way.
+/// </summary>
+/// <param name="frame">The frame to receive the image.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="width">Width of the captured image.</param>
+/// <param name="height">Height of the captured image.</param>
+/// <param name="cpu_scale">The factor the worker thread scales the image by, or 1.</param>
+/// <param name="row_pitch">Receives the distance between two rows of the captured image in bytes.</param>
+/// <returns>The top-left pixel of the captured image.</returns>
+static uint8_t* prepare_capture(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _In_ uint32_t width, _In_ uint32_t height, _In_ float cpu_scale, _Out_ size_t& row_pitch)
+{
+    if (cpu_scale == 1 && g_regions.empty() && g_sources.empty())
+    {
+        prepare_frame_storage(frame, ring, width, height);
+        row_pitch = frame.row_pitch;
+        return frame.data;
+    }
+    g_capture_width = width;
+    g_capture_height = height;
+    row_pitch = size_t(width) * 4;
+    resize_host_buffer(g_capture_buffer, row_pitch * height);
+    return g_capture_buffer.data();
+}
+
+/// <summary>
+/// Collects the rows of the LiveSplit window that the regions cover, merging overlapping and adjacent ranges, so
+/// that only those need to be captured.
+/// </summary>
+/// <param name="height">Height of the LiveSplit window.</param>
+static void collect_capture_rows(_In_ uint32_t height)
+{
+    g_capture_rows.clear();
+    for (const dirty_rect& region : g_regions)
+    {
+        const uint32_t bottom = (std::min)(region.bottom, height);
+        if (region.top < bottom && region.left < region.right)
+            g_capture_rows.push_back({ 0, region.top, 0, bottom });
+    }
+    std::sort(g_capture_rows.begin(), g_capture_rows.end(), [](const dirty_rect& a, const dirty_rect& b) { return a.top < b.top; });
+    size_t merged = 0;
+    for (size_t i = 0; i < g_capture_rows.size(); i++)
+    {
+        if (merged != 0 && g_capture_rows[i].top <= g_capture_rows[merged - 1].bottom)
+            g_capture_rows[merged - 1].bottom = (std::max)(g_capture_rows[merged - 1].bottom, g_capture_rows[i].bottom);
+        else
+            g_capture_rows[merged++] = g_capture_rows[i];
+    }
+    g_capture_rows.resize(merged);
+}
+
+/// <summary>
+/// Packs the regions of the image in g_capture_buffer and the images of the additional windows into the frame's
+/// storage, scaling them down on the way. The pieces are stacked on top of each other, so the texture is as wide as
+/// the widest piece. Without regions, the whole LiveSplit image is one piece.
+/// </summary>
+/// <param name="frame">The frame to receive the image.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="cpu_scale">The factor to scale the image by, or 1.</param>
+/// <param name="filter">The filter to scale the image with.</param>
+/// <param name="have_livesplit">Whether g_capture_buffer holds an image of LiveSplit.</param>
+static void compose_capture(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _In_ float cpu_scale, _In_ image_scaler::filter filter, _In_ bool have_livesplit)
+{
+    // Collect the pieces. Regions outside the LiveSplit window are clipped and left out when they end up empty.
+    g_capture_pieces.clear();
+    const size_t src_pitch = size_t(g_capture_width) * 4;
+    if (have_livesplit && g_regions.empty())
+    {
+        g_capture_pieces.push_back({ g_capture_buffer.data(), src_pitch, g_capture_width, g_capture_height, PLACEMENT_LIVESPLIT });
+    }
+    for (size_t i = 0; have_livesplit && i < g_regions.size(); i++)
+    {
+        const dirty_rect& region = g_regions[i];
+        const uint32_t width = (std::min)(region.right, g_capture_width) - (std::min)(region.left, g_capture_width);
+        const uint32_t height = (std::min)(region.bottom, g_capture_height) - (std::min)(region.top, g_capture_height);
+        if (width != 0 && height != 0)
+            g_capture_pieces.push_back({ g_capture_buffer.data() + region.top * src_pitch + region.left * 4, src_pitch, width, height, PLACEMENT_REGION + uint32_t(i) });
+    }
+    for (const source_state& source : g_sources)
+    {
+        if (source.have_image)
+            g_capture_pieces.push_back({ source.pixels.data(), size_t(source.width) * 4, source.width, source.height, PLACEMENT_SOURCE + source.index });
+    }
+
+    // Lay out the atlas.
+    uint32_t atlas_width = 1, atlas_height = 0;
+    frame.regions.resize(g_capture_pieces.size());
+    for (size_t i = 0; i < g_capture_pieces.size(); i++)
+    {
+        const uint32_t scaled_width = image_scaler::scaled_size(g_capture_pieces[i].width, cpu_scale);
+        const uint32_t scaled_height = image_scaler::scaled_size(g_capture_pieces[i].height, cpu_scale);
+        frame.regions[i] = { { 0, atlas_height, scaled_width, atlas_height + scaled_height }, g_capture_pieces[i].placement };
+        atlas_width = (std::max)(atlas_width, scaled_width);
+        atlas_height += scaled_height;
+    }
+    prepare_frame_storage(frame, ring, atlas_width, (std::max)(atlas_height, 1u));
+
+    for (size_t i = 0; i < g_capture_pieces.size(); i++)
+    {
+        const capture_piece& piece = g_capture_pieces[i];
+        const dirty_rect& rect = frame.regions[i].rect;
+        const uint32_t width = rect.right - rect.left, height = rect.bottom - rect.top;
+        uint8_t* dst = frame.data + rect.top * frame.row_pitch;
+        if (cpu_scale == 1)
+        {
+            for (uint32_t y = 0; y < height; y++)
+                memcpy(dst + y * frame.row_pitch, piece.data + y * piece.row_pitch, size_t(width) * 4);
+        }
+        else
+        {
+            g_image_scaler.scale(piece.data, piece.width, piece.height, piece.row_pitch, dst, width, height, frame.row_pitch, filter);
+        }
+        // Clear the unused part of the atlas, so that stale pixels don't show up as changes.
+        if (width < atlas_width)
+        {
+            for (uint32_t y = 0; y < height; y++)
+                memset(dst + y * frame.row_pitch + width * 4, 0, size_t(atlas_width - width) * 4);
+        }
+    }
+}
+
+/// <summary>Paints a synthetic LiveSplit-like image, in place of a capture of the LiveSplit window.</summary>
+/// <param name="frame">The frame to receive the image.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="source">The configured synthetic frame source.</param>
+/// <param name="cpu_scale">The factor the worker thread scales the image by, or 1.</param>
+static void render_synthetic_frame(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _In_ const synthetic_frame_source& source, _In_ float cpu_scale)
+{
+    const uint64_t now = get_time_us();
+    const uint32_t height = source.height(now);
+    size_t row_pitch;
+    uint8_t* data = prepare_capture(frame, ring, source.width(), height, cpu_scale, row_pitch);
+    source.render(now, height, data, row_pitch);
+    g_captured_bytes.fetch_add(row_pitch * height, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Copies the LiveSplit window, into the image that prepare_frame_storage() chose for the frame.
+/// </summary>
+/// <param name="frame">The frame to receive the image. On failure, its status is set.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="cpu_scale">The factor the worker thread scales the image by, or 1.</param>
+/// <returns>true if a new image was captured.</returns>
+static bool capture_livesplit(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _In_ float cpu_scale)
+{
+    // Get device context handle from the LiveSplit window, to get at its buffered image.
+    HDC device_context_handle = GetWindowDC(g_livesplit_window_handle);
+    if (device_context_handle == NULL)
+    {
+        // The LiveSplit window probably closed, let's search for it again next time.
+        g_window_discovery->invalidate();
+        frame.status = "Couldn't acquire LiveSplit device context.";
+        return false;
+    }
+
+    // Acquire the bitmap that contains the rendering of LiveSplit.
+    HBITMAP bitmap_handle = (HBITMAP)GetCurrentObject(device_context_handle, OBJ_BITMAP);
+
+    bool success = false;
+    BITMAPCOREHEADER bitmap_core_header { sizeof(BITMAPCOREHEADER) };
+    if (GetDIBits(device_context_handle, bitmap_handle, 0, 0, NULL, (LPBITMAPINFO)&bitmap_core_header, DIB_RGB_COLORS))
+    {
+        size_t row_pitch;
+        uint8_t* data = prepare_capture(frame, ring, bitmap_core_header.bcWidth, bitmap_core_header.bcHeight, cpu_scale, row_pitch);
+        g_bitmap_info_header.biWidth = LONG(row_pitch / 4);
+        g_bitmap_info_header.biHeight = -bitmap_core_header.bcHeight;
+        if (g_regions.empty())
+        {
+            success = GetDIBits(device_context_handle, bitmap_handle, 0, bitmap_core_header.bcHeight, data, (LPBITMAPINFO)&g_bitmap_info_header, DIB_RGB_COLORS);
+            if (success)
+                g_captured_bytes.fetch_add(row_pitch * bitmap_core_header.bcHeight, std::memory_order_relaxed);
+        }
+        else
+        {
+            // Only copy the rows the regions need. Scan lines are counted from the bottom of the bitmap, even though
+            // they are stored top-down in our buffer.
+            success = true;
+            collect_capture_rows(bitmap_core_header.bcHeight);
+            for (const dirty_rect& rows : g_capture_rows)
+            {
+                const UINT count = rows.bottom - rows.top;
+                if (!GetDIBits(device_context_handle, bitmap_handle, bitmap_core_header.bcHeight - rows.bottom, count, data + rows.top * row_pitch, (LPBITMAPINFO)&g_bitmap_info_header, DIB_RGB_COLORS))
+                {
+                    success = false;
+                    break;
+                }
+                g_captured_bytes.fetch_add(row_pitch * count, std::memory_order_relaxed);
+            }
+        }
+        if (!success)
+        {
+            frame.status = "Failed to copy LiveSplit window contents.";
+        }
+    }
+    else
+    {
+        frame.status = "Failed to query buffer format of LiveSplit device context.";
+    }
+
+    // Release the device context from LiveSplit so it can continue rendering.
+    ReleaseDC(g_livesplit_window_handle, device_context_handle);
+    return success;
+}
+
+/// <summary>
+/// Copies the newest frame that a publisher process put into the shared frame ring, instead of capturing LiveSplit.
+/// Like a capture, it goes straight into the upload ring's texture if that matches the frame's size. Frames that were
+/// read before aren't copied again. The ring is opened again when its layout changed or nothing was published for a
+/// while, since a publisher that started over may have created a new one.
+/// </summary>
+/// <param name="frame">The frame to receive the image. On failure, its status is set.</param>
+/// <param name="ring">The current upload ring or nullptr.</param>
+/// <param name="shared">The shared frame ring, which is opened here once a publisher created it.</param>
+/// <param name="cpu_scale">The factor the worker thread scales the image by, or 1.</param>
+/// <param name="unchanged">Set if the newest frame is the one that was read last, which is then not copied.</param>
+/// <returns>true if an image was copied or is unchanged.</returns>
+static bool read_shared_frame(_Inout_ livesplit_frame& frame, _In_opt_ const upload_ring* ring, _Inout_ shared_ring_state& shared, _In_ float cpu_scale, _Out_ bool& unchanged)
+{
+    unchanged = false;
+    const uint64_t now = get_time_us();
+    if (shared.ring.is_open() && (shared.ring.layout_changed() || now - shared.published_us >= SHARED_RING_REOPEN_US))
+        shared.ring.close();
+    if (!shared.ring.is_open())
+    {
+        shared.sequence = 0;
+        if (!shared.ring.open(shared_frame_ring::DEFAULT_NAME))
+        {
+            frame.status = "Waiting for a frame publisher ";
+            frame.status += SPINNER_CHARS[GetTickCount64() / 200 % 4];
+            return false;
+        }
+        shared.published = shared.ring.published();
+        shared.published_us = now;
+    }
+
+    const uint64_t published = shared.ring.published();
+    if (published != shared.published)
+    {
+        shared.published = published;
+        shared.published_us = now;
+    }
+    if (published == 0)
+    {
+        frame.status = "Waiting for the first published frame.";
+        return false;
+    }
+    if (published == shared.sequence)
+    {
+        unchanged = true;
+        return true;
+    }
+
+    shared_frame_ring::frame_info info;
+    const bool success = shared.ring.read([&](uint32_t width, uint32_t height, size_t& row_pitch) {
+        return prepare_capture(frame, ring, width, height, cpu_scale, row_pitch);
+    }, info);
+    if (success)
+    {
+        shared.sequence = info.sequence;
+        g_captured_bytes.fetch_add(size_t(info.width) * 4 * info.height, std::memory_order_relaxed);
+    }
+    else
+    {
+        shared.sequence = 0;
+        frame.status = "The frame publisher overwrote every frame while it was being read.";
+    }
+    return success;
+}
+
+/// <summary>Copies an additional window the same way as LiveSplit into the pixels of its state.</summary>
+/// <param name="source">The additional window, which must have been found.</param>
+/// <returns>true if a new image was captured.</returns>
+static bool capture_source_window(_Inout_ source_state& source)
+{
+    HDC device_context_handle = GetWindowDC(source.window_handle);
+    if (device_context_handle == NULL)
+    {
+        source.discovery->invalidate();
+        return false;
+    }
+
+    HBITMAP bitmap_handle = (HBITMAP)GetCurrentObject(device_context_handle, OBJ_BITMAP);
+    bool success = false;
+    BITMAPCOREHEADER bitmap_core_header { sizeof(BITMAPCOREHEADER) };
+    if (GetDIBits(device_context_handle, bitmap_handle, 0, 0, NULL, (LPBITMAPINFO)&bitmap_core_header, DIB_RGB_COLORS))
+    {
+        source.width = bitmap_core_header.bcWidth;
+        source.height = bitmap_core_header.bcHeight;
+        resize_host_buffer(source.pixels, size_t(source.width) * 4 * source.height);
+        BITMAPINFOHEADER bitmap_info_header = { sizeof(BITMAPINFOHEADER), LONG(source.width), -LONG(source.height), 1, 32, BI_RGB };
+        success = GetDIBits(device_context_handle, bitmap_handle, 0, source.height, source.pixels.data(), (LPBITMAPINFO)&bitmap_info_header, DIB_RGB_COLORS) != 0;
+        if (success)
+            g_captured_bytes.fetch_add(source.pixels.size(), std::memory_order_relaxed);
+    }
+    ReleaseDC(source.window_handle, device_context_handle);
+    return success;
+}
+
+/// <summary>
+/// Captures the additional windows that are due, in order of priority. Once a pass has used up its time budget, the
+/// remaining windows keep their previous image and get their turn on a later pass. A window that has no image yet
+/// is captured regardless, so that a slow window with high priority can't hide all the others for good.
+/// </summary>
+/// <param name="pass_start">When the worker thread started this pass, in microseconds.</param>
+static void capture_sources(_In_ uint64_t pass_start)
+{
+    for (source_state& source : g_sources)
+    {
+        const uint64_t now = get_time_us();
+        if (source.have_image && source.rate > 0 && now - source.last_capture_us < 1000000 / uint64_t(source.rate))
+            continue;
+        if (source.have_image && now - pass_start >= SOURCE_TIME_BUDGET_US)
+            continue;
+
+        stage_timer timer(g_source_histograms[source.index]);
+        source.last_capture_us = now;
+        source.window_handle = (HWND)source.discovery->find(now);
+        source.have_image = source.window_handle != NULL && !IsIconic(source.window_handle) && capture_source_window(source);
+    }
+}
+
+/// <summary>
+/// Replaces the worker thread's additional windows with the ones from the settings, sorted by priority.
+/// </summary>
+/// <param name="enumerator">Lists the desktop's windows for the window discoveries.</param>
+/// <param name="polling">Whether the window discoveries have to poll, because there are no window notifications.</param>
+static void update_sources(_In_ window_enumerator& enumerator, _In_ bool polling)
+{
+    g_sources.clear();
+    for (size_t i = 0; i < g_shared_sources.size(); i++)
+    {
+        const shared_capture_source& shared = g_shared_sources[i];
+        source_state source;
+        source.index = uint32_t(i);
+        source.discovery.reset(new window_discovery(enumerator, shared.image_suffix.c_str(), shared.title.c_str()));
+        source.discovery->set_polling(polling);
+        source.priority = shared.priority;
+        source.rate = shared.rate;
+        g_sources.push_back(std::move(source));
+    }
+    std::stable_sort(g_sources.begin(), g_sources.end(), [](const source_state& a, const source_state& b) { return a.priority > b.priority; });
+}
+
+/// <summary>Waits until the given time while dispatching window notifications, or returns right away without a timer.</summary>
+/// <param name="timer">A high resolution waitable timer, since the default timer resolution is coarser than a frame.</param>
+/// <param name="time_us">The time to wait for, in microseconds.</param>
+static void wait_until(_In_opt_ HANDLE timer, _In_ uint64_t time_us)
+{
+    const uint64_t now = get_time_us();
+    if (timer == NULL || time_us <= now)
+        return;
+    // Relative due times are negative and counted in 100 ns.
+    LARGE_INTEGER due;
+    due.QuadPart = -int64_t(time_us - now) * 10;
+    if (!SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE))
+        return;
+    while (MsgWaitForMultipleObjects(1, &timer, FALSE, INFINITE, QS_ALLINPUT) == WAIT_OBJECT_0 + 1)
+    {
+        MSG message;
+        while (PeekMessageW(&message, NULL, 0, 0, PM_REMOVE))
+            DispatchMessageW(&message);
+    }
+}
+
+/// <summary>Remembers which parts of the image a published generation changed.</summary>
+/// <param name="frame">The frame that is being published.</param>
+/// <param name="have_image">Whether the frame shows an image.</param>
+static void record_published_change(_In_ const livesplit_frame& frame, _In_ bool have_image)
+{
+    published_change& change = g_published_changes[frame.generation % std::size(g_published_changes)];
+    change.generation = frame.generation;
+    change.full = !have_image;
+    change.rects = frame.dirty_rects;
+}
+
+/// <summary>
+/// Brings the frame's upload ring texture up to date with the image in g_ring_staging_buffer, keying it on the way.
+/// Only the parts that changed since the texture was last written are copied, which are found in the changes of the
+/// generations in between. Afterwards the frame refers to the texture.
+/// </summary>
+/// <param name="frame">The frame that is being published, built in g_ring_staging_buffer.</param>
+/// <param name="ring">The upload ring the frame was built for.</param>
+static void commit_ring_frame(_Inout_ livesplit_frame& frame, _In_ const upload_ring* ring)
+{
+    const size_t texture = frame.ring_texture;
+    ring_slot_content& content = g_ring_texture_contents[texture];
+    bool full = content.ring_id != ring->id || content.width != frame.width || content.height != frame.height || content.generation >= frame.generation;
+    g_ring_copy_rects.clear();
+    for (uint64_t generation = content.generation + 1; !full && generation <= frame.generation; generation++)
+    {
+        const published_change& change = g_published_changes[generation % std::size(g_published_changes)];
+        full = change.generation != generation || change.full;
+        g_ring_copy_rects.insert(g_ring_copy_rects.end(), change.rects.begin(), change.rects.end());
+    }
+    if (full)
+        g_ring_copy_rects.assign(1, { 0, 0, frame.width, frame.height });
+
+    const subresource_data& mapped = ring->mapped[texture];
+    for (const dirty_rect& rect : g_ring_copy_rects)
+        frame_upload::copy_rows({ (uint8_t*)mapped.data + rect.top * mapped.row_pitch + rect.left * 4, mapped.row_pitch, 0 }, frame, rect);
+    content = { ring->id, frame.generation, frame.width, frame.height };
+    frame.data = (uint8_t*)mapped.data;
+    frame.row_pitch = mapped.row_pitch;
+}
+
+/// <summary>
+/// Queues a copy of a published image for the recorder and wakes the writer thread once half of the recorder's slots
+/// are taken, so that a high frame rate doesn't run out of slots before the writer's next interval.
+/// </summary>
+/// <param name="data">The image, which must not change until this returns.</param>
+/// <param name="row_pitch">Bytes between the image's rows.</param>
+/// <param name="width">Width of the image.</param>
+/// <param name="height">Height of the image.</param>
+/// <param name="captured_us">When the capture of the image started.</param>
+static void queue_recorded_frame(_In_ const uint8_t* data, _In_ size_t row_pitch, _In_ uint32_t width, _In_ uint32_t height, _In_ uint64_t captured_us)
+{
+    stage_timer timer(STAGE_RECORD);
+    g_recorder.push_frame(g_frame_generation, captured_us, data, row_pitch, width, height);
+    if (g_recorder.queued_frames() >= frame_recorder::FRAME_SLOTS / 2)
+        SetEvent(g_event_recorder_wake);
+}
+
+/// <summary>
+/// Makes sure that the back slot owns an upload ring texture that the GPU no longer samples from, swapping it for a
+/// spare one if it was drawn too recently. Only textures of the front slot are drawn, so once the GPU is done with a
+/// texture, it stays done until the slot that owns it is published and taken again.
+/// </summary>
+/// <returns>false if the GPU still samples from all textures the back slot could use.</returns>
+static bool claim_ring_texture()
+{
+    const uint64_t draw_count = g_ring_draw_count.load(std::memory_order_acquire);
+    size_t& texture = g_ring_slot_textures[g_frames.back_index()];
+    if (g_ring_texture_free_draws[texture].load(std::memory_order_acquire) <= draw_count)
+        return true;
+    for (size_t& spare : g_ring_spare_textures)
+    {
+        if (g_ring_texture_free_draws[spare].load(std::memory_order_acquire) <= draw_count)
+        {
+            std::swap(texture, spare);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>Tells the render thread that the worker thread's pass is over and whether it captured a change.</summary>
+static void end_pass(_In_ bool changed)
+{
+    g_capture_changed.store(changed, std::memory_order_relaxed);
+    g_worker_busy.store(false, std::memory_order_release);
+    SetEvent(g_event_worker_idle);
+}
+
+/// <summary>
+/// Waits until the next capture is due or the LiveSplit overlay is removed. Window notifications are delivered as
+/// messages in the meantime.
+/// </summary>
+static void wait_for_next_pass()
+{
+    while (MsgWaitForMultipleObjects(1, &g_event_worker_go, FALSE, INFINITE, QS_ALLINPUT) == WAIT_OBJECT_0 + 1)
+    {
+        MSG message;
+        while (PeekMessageW(&message, NULL, 0, 0, PM_REMOVE))
+            DispatchMessageW(&message);
+    }
+}
+
+/// <summary>
+/// The worker thread is responsible for finding the LiveSplit window and copying it into the back slot of the frame
+/// mailbox, or for painting a synthetic image there instead. Frames are only published when they differ from the
+/// previous one, so the render thread can tell from a gap in the generation numbers whether it missed some changes.
+/// Nobody waits for the thread to exit, so it holds a reference on the add-on's module until it did.
+/// </summary>
+/// <param name="module">The add-on's module, which the thread releases when it exits.</param>
+static DWORD WINAPI worker_thread(_In_ LPVOID module)
+{
+    bool published_image = false;
+    std::string published_status;
+    uint64_t published_key_bits = 0;
+    float published_scale = 1;
+    int published_scale_filter = image_scaler::FILTER_BOX;
+    uint32_t layout_version = 0;
+
+    // Look for LiveSplit when windows appear or change instead of polling all windows. Without the notifications we
+    // fall back to polling.
+    win32_window_enumerator window_enumerator;
+    window_discovery discovery(window_enumerator, L"\\LiveSplit.exe", L"LiveSplit");
+    g_window_discovery = &discovery;
+    const HWINEVENTHOOK window_hooks[] = {
+        SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, NULL, &on_window_event, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS),
+        SetWinEventHook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, NULL, &on_window_event, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS)
+    };
+    const bool polling = window_hooks[0] == NULL || window_hooks[1] == NULL;
+    discovery.set_polling(polling);
+    synthetic_frame_source synthetic_source;
+    livesplit_server_client server_client;
+    shared_ring_state shared_ring;
+    bool published_timer_connected = false;
+    timer_state published_timer;
+    bool server_connected = false;
+    timer_state server_timer;
+    uint64_t next_server_poll_us = 0;
+    // Without a high resolution timer, captures start right after the present as before.
+    const HANDLE phase_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+    while (!g_terminate_thread)
+    {
+        // Start as late as the render thread asked for, so that the frame is as fresh as possible when it is drawn.
+        // The capture is meant for the first draw after being woken up.
+        const uint64_t woken_us = get_time_us();
+        wait_until(phase_timer, g_capture_start_us.load(std::memory_order_relaxed));
+        const uint64_t pass_start = get_time_us();
+        livesplit_frame& frame = g_frames.back();
+        frame.status.clear();
+        frame.timer_connected = false;
+        bool have_livesplit = false;
+        bool reuse_published = false;
+        // The published image that is queued for the recorder once the pass is done.
+        bool record_frame = false;
+        const uint8_t* recorded_data = nullptr;
+        size_t recorded_row_pitch = 0;
+        uint32_t recorded_width = 0, recorded_height = 0;
+
+        // Pick up the newest upload ring. Reporting the epoch read before it tells the render thread that any ring
+        // retired up to that epoch is no longer in use by this thread.
+        const uint64_t ring_epoch = g_ring_epoch.load(std::memory_order_acquire);
+        const upload_ring* const ring = g_upload_ring.load(std::memory_order_acquire);
+        g_worker_ring_epoch.store(ring_epoch, std::memory_order_release);
+        if (!claim_ring_texture())
+        {
+            // Like an upload that finds all staging buffers in flight, the capture is skipped instead of waiting, and
+            // the render thread asks for another one on the next present.
+            g_capture_duration_us.store(0, std::memory_order_relaxed);
+            end_pass(false);
+            wait_for_next_pass();
+            continue;
+        }
+        frame.ring_texture = g_ring_slot_textures[g_frames.back_index()];
+
+        // Images are only scaled down on the CPU, and only below the size where the GPU's filter would start to skip
+        // pixels. Upscaling would only make the texture larger, so the GPU does that.
+        const float scale = g_shared_scale.load(std::memory_order_relaxed);
+        const int scale_filter = g_shared_scale_filter.load(std::memory_order_relaxed);
+        const float cpu_scale = scale < image_scaler::MIN_GPU_SCALE && scale_filter != SCALE_FILTER_GPU ? scale : 1;
+
+        // A different background key, opacity or scale affects every pixel, so it counts as a change of the whole
+        // image, and a frame from the shared frame ring has to be read again. Images that need keying are built in
+        // host memory, so that only their changed parts are keyed into the upload ring.
+        const uint64_t key_bits = g_key_params.load(std::memory_order_relaxed);
+        if (key_bits != published_key_bits || scale != published_scale || scale_filter != published_scale_filter)
+        {
+            g_tile_diff.invalidate();
+            shared_ring.sequence = 0;
+            published_key_bits = key_bits;
+            published_scale = scale;
+            published_scale_filter = scale_filter;
+        }
+        const bool recording = g_recording.load(std::memory_order_relaxed);
+
+        // Pick up changed regions and additional windows. This only takes the lock after the settings were edited.
+        frame.regions.clear();
+        if (g_shared_layout_version.load(std::memory_order_acquire) != layout_version)
+        {
+            std::lock_guard<std::mutex> lock(g_shared_layout_mutex);
+            g_regions = g_shared_regions;
+            update_sources(window_enumerator, polling);
+            layout_version = g_shared_layout_version.load(std::memory_order_relaxed);
+            g_tile_diff.invalidate();
+            shared_ring.sequence = 0;
+        }
+        const bool compose = cpu_scale != 1 || !g_regions.empty() || !g_sources.empty();
+
+        // Find the LiveSplit window, unless a synthetic image is shown instead.
+        const int frame_source = g_frame_source.load(std::memory_order_relaxed);
+        if (frame_source == FRAME_SOURCE_LIVESPLIT)
+        {
+            stage_timer timer(STAGE_DISCOVERY);
+            g_livesplit_window_handle = (HWND)discovery.find(get_time_us());
+        }
+
+        if (frame_source == FRAME_SOURCE_SERVER)
+        {
+            // Only the timer state is queried, the render thread advances the time on every frame it draws. The state
+            // only changes when the runner splits, pauses or resets, so the server isn't asked on every pass.
+            const uint64_t now = get_time_us();
+            if (now >= next_server_poll_us)
+            {
+                stage_timer timer(STAGE_CAPTURE);
+                next_server_poll_us = now + SERVER_POLL_INTERVAL_US;
+                server_connected = server_client.poll(&get_time_us, server_timer);
+            }
+            frame.timer_connected = server_connected;
+            if (server_connected)
+            {
+                frame.timer = server_timer;
+            }
+            else
+            {
+                frame.status = "Waiting for LiveSplit Server ";
+                frame.status += SPINNER_CHARS[GetTickCount64() / 200 % 4];
+            }
+        }
+        else if (frame_source == FRAME_SOURCE_SHARED_MEMORY)
+        {
+            // Without a new frame, the image that was published last still stands. Composing it anew works from the
+            // previous frame, which is still in g_capture_buffer.
+            stage_timer timer(STAGE_CAPTURE);
+            bool unchanged;
+            have_livesplit = read_shared_frame(frame, ring, shared_ring, cpu_scale, unchanged);
+            reuse_published = unchanged && !compose;
+        }
+        else if (frame_source != FRAME_SOURCE_LIVESPLIT)
+        {
+            const uint32_t* layout = SYNTHETIC_LAYOUTS[frame_source - 1];
+            synthetic_source.configure(layout[0], layout[1], layout[2]);
+            stage_timer timer(STAGE_CAPTURE);
+            render_synthetic_frame(frame, ring, synthetic_source, cpu_scale);
+            have_livesplit = true;
+        }
+        else if (g_livesplit_window_handle != NULL)
+        {
+            if (!IsIconic(g_livesplit_window_handle))
+            {
+                stage_timer timer(STAGE_CAPTURE);
+                have_livesplit = capture_livesplit(frame, ring, cpu_scale);
+            }
+            else
+            {
+                frame.status = "LiveSplit is minimized.";
+            }
+        }
+        else
+        {
+            frame.status = "Waiting for LiveSplit ";
+            frame.status += SPINNER_CHARS[GetTickCount64() / 200 % 4];
+        }
+
+        // The additional windows share the frame with LiveSplit, but are shown even while LiveSplit isn't.
+        bool have_image = have_livesplit;
+        if (!g_sources.empty())
+        {
+            capture_sources(pass_start);
+            for (const source_state& source : g_sources)
+                have_image |= source.have_image;
+        }
+
+        if (frame_source != FRAME_SOURCE_SHARED_MEMORY)
+            shared_ring.sequence = 0;
+
+        if (have_image && compose)
+        {
+            stage_timer timer(STAGE_SCALE);
+            compose_capture(frame, ring, cpu_scale, image_scaler::filter(scale_filter), have_livesplit);
+        }
+
+        // Find out which parts of the image changed.
+        bool changed = false;
+        if (have_image && !reuse_published)
+        {
+            stage_timer timer(STAGE_DIFF);
+            changed = g_tile_diff.update(frame.data, frame.width, frame.height, frame.row_pitch);
+        }
+        else if (!have_image)
+        {
+            frame.width = 0;
+            frame.height = 0;
+            g_tile_diff.invalidate();
+        }
+
+        // A timer state only counts as a change if the render thread would extrapolate a different time from the
+        // previous one, or show a different split.
+        if (frame.timer_connected != published_timer_connected || (frame.timer_connected && !published_timer.matches(frame.timer, TIMER_TOLERANCE_US)))
+        {
+            changed = true;
+            published_timer_connected = frame.timer_connected;
+            published_timer = frame.timer;
+        }
+
+        // Hand the frame over to the render thread if it shows anything new.
+        if (changed || have_image != published_image || frame.status != published_status)
+        {
+            g_tile_diff.collect_dirty_rects(frame.dirty_rects);
+            g_tile_diff.clear_dirty();
+            frame.keying = key_params::unpack(key_bits);
+            frame.draw_scale = scale / cpu_scale;
+            frame.generation = ++g_frame_generation;
+            frame.captured_us = pass_start;
+            record_published_change(frame, have_image);
+            // Remember the image in host memory for the recorder, since the frame belongs to the render thread once
+            // it is published.
+            record_frame = recording;
+            recorded_data = frame.data;
+            recorded_row_pitch = frame.row_pitch;
+            recorded_width = frame.width;
+            recorded_height = frame.height;
+            if (have_image && frame.ring_id != 0)
+            {
+                stage_timer timer(STAGE_KEYING);
+                commit_ring_frame(frame, ring);
+            }
+            else
+            {
+                // The render thread copies images in host memory into whichever ring it has.
+                g_ring_texture_contents[frame.ring_texture].ring_id = 0;
+            }
+            published_image = have_image;
+            published_status = frame.status;
+            g_frames.publish();
+            g_capture_duration_us.store((std::max)(get_time_us() - pass_start, uint64_t(1)), std::memory_order_relaxed);
+            g_capture_missed.store(g_last_draw_us.load(std::memory_order_relaxed) > woken_us, std::memory_order_relaxed);
+        }
+        else
+        {
+            g_capture_duration_us.store(0, std::memory_order_relaxed);
+        }
+
+        end_pass(changed);
+        // The recorded image is in host memory that only this thread writes, so the recorder's copy of it is made
+        // after the pass counts as done. It then overlaps the wait for the next capture instead of delaying it.
+        if (record_frame)
+            queue_recorded_frame(recorded_data, recorded_row_pitch, recorded_width, recorded_height, pass_start);
+        wait_for_next_pass();
+    }
+
+    for (HWINEVENTHOOK window_hook : window_hooks)
+    {
+        if (window_hook != NULL)
+            UnhookWinEvent(window_hook);
+    }
+    if (phase_timer != NULL)
+        CloseHandle(phase_timer);
+    g_window_discovery = nullptr;
+    g_sources.clear();
+    FreeLibraryAndExitThread((HMODULE)module, 0);
+}
+
+/// <summary>Creates a texture that LiveSplit frames can be written to from the host, and a view on it.</summary>
+/// <param name="device">The device to create the texture on.</param>
+/// <param name="width">Width of the LiveSplit window.</param>
+/// <param name="height">Height of the LiveSplit window.</param>
+/// <param name="texture">Receives the texture.</param>
+/// <param name="texture_view">Receives the view on the texture.</param>
+/// <returns>true on success. On failure g_texture_error is set and nothing needs to be destroyed.</returns>
+static bool create_livesplit_texture(_In_ device* device, _In_ uint32_t width, _In_ uint32_t height, _Out_ resource& texture, _Out_ resource_view& texture_view)
+{
+    g_texture_creations++;
+    g_texture_error = frame_upload::create_mapped_texture(device, width, height, texture, texture_view);
+    return g_texture_error == nullptr;
+}
+
+/// <summary>Unmaps and destroys the textures of an upload ring.</summary>
+static void destroy_upload_ring(_In_ upload_ring* ring)
+{
+    for (size_t i = 0; i < RING_TEXTURE_COUNT; i++)
+    {
+        if (ring->mapped[i].data != nullptr)
+            ring->api_device->unmap_texture_region(ring->textures[i], 0);
+        if (ring->views[i].handle != 0)
+            ring->api_device->destroy_resource_view(ring->views[i]);
+        if (ring->textures[i].handle != 0)
+            ring->api_device->destroy_resource(ring->textures[i]);
+    }
+    delete ring;
+}
+
+/// <summary>Creates an upload ring on g_ring_device and maps all of its textures for as long as the ring exists.</summary>
+/// <returns>The new ring or nullptr on failure, in which case g_texture_error is set.</returns>
+static upload_ring* create_upload_ring(_In_ uint32_t width, _In_ uint32_t height)
+{
+    upload_ring* ring = new upload_ring();
+    ring->id = g_next_ring_id++;
+    ring->api_device = g_ring_device;
+    ring->width = width;
+    ring->height = height;
+    for (size_t i = 0; i < RING_TEXTURE_COUNT; i++)
+    {
+        if (!create_livesplit_texture(g_ring_device, width, height, ring->textures[i], ring->views[i]))
+        {
+            destroy_upload_ring(ring);
+            return nullptr;
+        }
+        if (!g_ring_device->map_texture_region(ring->textures[i], 0, nullptr, map_access::write_only, &ring->mapped[i]))
+        {
+            ring->mapped[i] = {};
+            destroy_upload_ring(ring);
+            g_texture_error = "Failed to map texture to host memory.";
+            return nullptr;
+        }
+    }
+    return ring;
+}
+
+/// <summary>
+/// Creates an optimally tiled texture that only the GPU accesses, a view on it and the staging buffers that frames
+/// are copied to it from.
+/// </summary>
+/// <returns>true on success. On failure g_texture_error is set and nothing needs to be destroyed.</returns>
+static bool create_staged_texture(_In_ device* device, _In_ uint32_t width, _In_ uint32_t height, _Out_ livesplit_texture& texture)
+{
+    g_texture_creations++;
+    g_texture_error = frame_upload::create_staged_texture(device, width, height, texture);
+    return g_texture_error == nullptr;
+}
+
+struct device_cache;
+
+/// <summary>
+/// Creates the textures of a device_cache's texture pool. The GPU may still sample from a texture the pool replaces
+/// or copy to it, so it is retired rather than destroyed.
+/// </summary>
+class livesplit_texture_factory : public resource_factory<livesplit_texture>
+{
+public:
+    explicit livesplit_texture_factory(_In_ device_cache& cache) : _cache(cache)
+    {
+    }
+
+    bool create(uint32_t width, uint32_t height, livesplit_texture& texture) override;
+    void destroy(livesplit_texture& texture) override;
+
+private:
+    device_cache& _cache;
+};
+
+/// <summary>
+/// Creates the upload rings of g_upload_ring_pool. The current ring may still be in use by the worker thread and
+/// the GPU, so it is retired rather than destroyed.
+/// </summary>
+class upload_ring_factory : public resource_factory<upload_ring*>
+{
+public:
+    bool create(uint32_t width, uint32_t height, upload_ring*& ring) override
+    {
+        ring = create_upload_ring(width, height);
+        return ring != nullptr;
+    }
+
+    void destroy(upload_ring*& ring) override;
+};
+
+/// <summary>
+/// What a device keeps to show the frames of the one capture stream that all devices share. Each device uploads a
+/// frame into its own texture at most once, no matter how many of its swapchains draw it. The cache lives as long as
+/// the device, so a swapchain that is recreated, for example on a display mode change, finds its textures still
+/// there.
+/// </summary>
+struct device_cache
+{
+    explicit device_cache(_In_ device* device) : api_device(device), texture_factory(*this), texture_pool(texture_factory, 2)
+    {
+    }
+
+    device* const api_device;
+    livesplit_texture_factory texture_factory;
+    resource_pool<livesplit_texture> texture_pool;
+    /// <summary>The texture pool's current texture, or nullptr.</summary>
+    livesplit_texture* texture = nullptr;
+    /// <summary>Generation of the frame that was last taken over, so that it isn't taken over twice.</summary>
+    uint64_t frame_generation = 0;
+    /// <summary>Generation of the frame the texture holds, or 0 if there is nothing to show.</summary>
+    uint64_t uploaded_generation = 0;
+    /// <summary>Whether frames come from the upload ring instead of being uploaded into the texture.</summary>
+    bool use_upload_ring = false;
+    /// <summary>Set after the upload ring failed, so that the device sticks to its texture.</summary>
+    bool upload_ring_failed = false;
+    /// <summary>Whether textures are copied to from staging buffers instead of being mapped.</summary>
+    bool use_staging = false;
+    /// <summary>Signaled after each batch of copies from staging buffers, most recently with fence_value.</summary>
+    fence upload_fence = {};
+    uint64_t fence_value = 0;
+    /// <summary>Counts the presents on the device, which retired textures wait for.</summary>
+    uint64_t draw_count = 0;
+    std::vector<livesplit_texture> retired_textures;
+    uint32_t swapchain_count = 0;
+};
+
+bool livesplit_texture_factory::create(uint32_t width, uint32_t height, livesplit_texture& texture)
+{
+    if (_cache.use_staging)
+        return create_staged_texture(_cache.api_device, width, height, texture);
+    texture = {};
+    return create_livesplit_texture(_cache.api_device, width, height, texture.texture, texture.view);
+}
+
+void livesplit_texture_factory::destroy(livesplit_texture& texture)
+{
+    // Every swapchain on the device counts as a draw, so wait for that many more.
+    texture.retire_draw = _cache.draw_count + MAX_FRAMES_IN_FLIGHT * (std::max)(_cache.swapchain_count, 1u);
+    _cache.retired_textures.push_back(texture);
+}
+
+static upload_ring_factory g_upload_ring_factory;
+// Replaced rings can't be handed out again before they are released, so the ring pool keeps no spares.
+static resource_pool<upload_ring*> g_upload_ring_pool(g_upload_ring_factory, 0);
+static std::vector<std::unique_ptr<device_cache>> g_device_caches;
+
+/// <summary>Finds the cache of a device, or nullptr if none of its swapchains has been seen yet.</summary>
+static device_cache* find_device_cache(_In_ device* device)
+{
+    for (const std::unique_ptr<device_cache>& cache : g_device_caches)
+    {
+        if (cache->api_device == device)
+            return cache.get();
+    }
+    return nullptr;
+}
+
+/// <summary>
+/// Hands a new upload ring to the worker thread and retires the current one. A retired ring is destroyed once the
+/// worker thread reported that it moved on and the GPU finished the frames that might still sample from it.
+/// </summary>
+/// <param name="ring">The new upload ring or nullptr.</param>
+static void replace_upload_ring(_In_opt_ upload_ring* ring)
+{
+    if (ring == g_ring)
+        return;
+    g_upload_ring.store(ring, std::memory_order_release);
+    const uint64_t epoch = g_ring_epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (g_ring != nullptr)
+    {
+        // Every swapchain on the ring's device counts as a draw, so wait for that many more.
+        const device_cache* const cache = find_device_cache(g_ring->api_device);
+        g_ring->retire_epoch = epoch;
+        g_ring->retire_draw = cache != nullptr ? cache->draw_count + MAX_FRAMES_IN_FLIGHT * (std::max)(cache->swapchain_count, 1u) : 0;
+        g_retired_rings.push_back(g_ring);
+    }
+    g_ring = ring;
+}
+
+void upload_ring_factory::destroy(upload_ring*& ring)
+{
+    if (ring == g_ring)
+        replace_upload_ring(nullptr);
+    else
+        destroy_upload_ring(ring);
+}
+
+/// <summary>
+/// Destroys the retired upload rings of a device that are no longer in use. An idle worker thread doesn't use any
+/// ring, and can only be woken by whoever holds g_render_mutex, so a parked worker thread doesn't keep its last ring
+/// alive.
+/// </summary>
+/// <param name="cache">The device.</param>
+/// <param name="all">Destroy all that the worker thread is done with, regardless of the GPU, because the device goes away.</param>
+static void release_retired_rings(_In_ const device_cache& cache, _In_ bool all)
+{
+    const bool worker_idle = !g_worker_busy.load(std::memory_order_acquire);
+    const uint64_t worker_epoch = g_worker_ring_epoch.load(std::memory_order_acquire);
+    for (auto it = g_retired_rings.begin(); it != g_retired_rings.end();)
+    {
+        if ((*it)->api_device == cache.api_device && (worker_idle || worker_epoch >= (*it)->retire_epoch)
+            && (all || cache.draw_count >= (*it)->retire_draw))
+        {
+            destroy_upload_ring(*it);
+            it = g_retired_rings.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/// <summary>Destroys the retired textures of a device that the GPU is done with.</summary>
+/// <param name="cache">The device.</param>
+/// <param name="all">Destroy all of them, after waiting for their copies, because the device goes away.</param>
+static void release_retired_textures(_Inout_ device_cache& cache, _In_ bool all)
+{
+    if (cache.retired_textures.empty())
+        return;
+    device* const device = cache.api_device;
+    const uint64_t completed = cache.upload_fence.handle != 0 ? device->get_completed_fence_value(cache.upload_fence) : 0;
+    for (auto it = cache.retired_textures.begin(); it != cache.retired_textures.end();)
+    {
+        if (all && !it->staging.idle(completed))
+            device->wait(cache.upload_fence, it->staging.last_value());
+        if (all || (cache.draw_count >= it->retire_draw && it->staging.idle(completed)))
+        {
+            frame_upload::destroy_texture(device, *it);
+            it = cache.retired_textures.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/// <summary>Retires the LiveSplit textures of a device. They are destroyed once the GPU is done with them.</summary>
+static void destroy_texture(_Inout_ device_cache& cache)
+{
+    cache.texture_pool.clear();
+    cache.texture = nullptr;
+    cache.uploaded_generation = 0;
+    cache.frame_generation = 0;
+}
+
+/// <summary>
+/// Destroys the upload rings of a device that goes away. Its textures must be gone before the device is, so if the
+/// worker thread may still be writing to one of them, this waits up to RING_RELEASE_TIMEOUT_MS for its current pass
+/// to finish. That is the only place where the render thread waits for the worker thread, and only on a device's
+/// destruction. The caller holds g_render_mutex, so no other pass can start.
+/// </summary>
+/// <param name="cache">The device.</param>
+static void destroy_upload_rings(_In_ const device_cache& cache)
+{
+    if (g_ring_device == cache.api_device)
+    {
+        g_upload_ring_pool.clear();
+        g_ring_device = nullptr;
+    }
+    release_retired_rings(cache, true);
+    const bool in_use = std::any_of(g_retired_rings.begin(), g_retired_rings.end(), [&cache](const upload_ring* ring) { return ring->api_device == cache.api_device; });
+    if (!in_use)
+        return;
+    if (g_thread == NULL || !g_worker_busy.load(std::memory_order_acquire) || WaitForSingleObject(g_event_worker_idle, RING_RELEASE_TIMEOUT_MS) == WAIT_OBJECT_0)
+    {
+        release_retired_rings(cache, true);
+    }
+    else
+    {
+        // A worker thread that hangs, for example on a LiveSplit window that doesn't respond, must not hang the game
+        // along with it. The rings it may still write to are left to the device rather than destroyed under it.
+        g_retired_rings.erase(std::remove_if(g_retired_rings.begin(), g_retired_rings.end(),
+            [&cache](const upload_ring* ring) { return ring->api_device == cache.api_device; }), g_retired_rings.end());
+    }
+}
+
+/// <summary>
+/// Decides how each device gets frames into a texture. D3D12 has no textures that can be mapped for sampling, so it
+/// copies from staging buffers into an optimally tiled texture, as Vulkan does by default. With mapped textures
+/// instead, the worker thread can write frames straight into an upload ring. The ring's textures belong to one
+/// device and are only reused once that device's draws from them are done, so this only works while LiveSplit is
+/// shown on a single device. Otherwise every device uploads the shared frames on its own.
+/// </summary>
+static void choose_upload_path()
+{
+    for (const std::unique_ptr<device_cache>& cache : g_device_caches)
+    {
+        const device_api api = cache->api_device->get_api();
+        const bool use_staging = api == device_api::d3d12 || (api == device_api::vulkan && g_texture_upload == TEXTURE_UPLOAD_STAGING);
+        if (use_staging != cache->use_staging)
+        {
+            destroy_texture(*cache);
+            cache->use_staging = use_staging;
+        }
+        if (use_staging && cache->upload_fence.handle == 0 && !cache->api_device->create_fence(0, fence_flags::none, &cache->upload_fence))
+        {
+            cache->upload_fence = {};
+            g_texture_error = "Failed to create fence.";
+        }
+
+        const bool use_upload_ring = g_livesplit_showing && g_device_caches.size() == 1 && !cache->upload_ring_failed
+            && api == device_api::vulkan && !use_staging;
+        if (use_upload_ring == cache->use_upload_ring)
+            continue;
+
+        // The current frame is taken over again on the other path.
+        cache->use_upload_ring = use_upload_ring;
+        if (use_upload_ring)
+        {
+            // Rings of another device are retired and destroyed once the worker thread and that device are done.
+            destroy_texture(*cache);
+            if (g_ring_device != cache->api_device)
+                g_upload_ring_pool.clear();
+            g_ring_device = cache->api_device;
+        }
+        else
+        {
+            g_upload_ring_pool.clear();
+            cache->frame_generation = 0;
+            cache->uploaded_generation = 0;
+        }
+    }
+}
+
+/// <summary>
+/// Makes a device's LiveSplit texture show a frame. The texture comes from the device's texture pool and is usually
+/// larger than the frame, so that it survives LiveSplit resizing. A texture that fails to be created is only
+/// attempted again once LiveSplit moves to another size class.
+/// </summary>
+/// <param name="cache">The device to show the frame on.</param>
+/// <param name="queue">The command queue to copy on, for textures with staging buffers.</param>
+/// <param name="frame">The newest LiveSplit frame from the mailbox.</param>
+static void update_texture(_Inout_ device_cache& cache, _In_ command_queue* queue, _In_ const livesplit_frame& frame)
+{
+    // Keep the texture while LiveSplit is gone, so that it is ready when LiveSplit comes back.
+    if (frame.width == 0)
+    {
+        cache.uploaded_generation = 0;
+        return;
+    }
+    // A frame captured into an upload ring that has been replaced since can't be read anymore. The texture keeps
+    // showing the previous one.
+    if (frame.ring_id != 0 && (g_ring == nullptr || frame.ring_id != g_ring->id))
+        return;
+
+    if (cache.use_staging && cache.upload_fence.handle == 0)
+        return;
+    const uint64_t previous = cache.texture != nullptr ? cache.texture->texture.handle : 0;
+    cache.texture = cache.texture_pool.acquire(frame.width, frame.height, get_time_us());
+    if (cache.texture == nullptr || cache.texture->texture.handle != previous)
+    {
+        // Another texture doesn't hold the previous frame, so it needs the whole image.
+        cache.uploaded_generation = 0;
+    }
+
+    if (cache.texture != nullptr)
+    {
+        stage_timer timer(STAGE_UPLOAD);
+        bool success;
+        if (cache.use_staging)
+        {
+            const size_t index = cache.texture->staging.acquire(cache.api_device->get_completed_fence_value(cache.upload_fence));
+            if (index == staging_ring::NONE)
+            {
+                // All staging buffers are still in flight. The texture keeps the previous frame, and this one is tried
+                // again on the next draw.
+                cache.frame_generation = 0;
+                return;
+            }
+            success = frame_upload::upload_staged(queue, *cache.texture, cache.upload_fence, cache.fence_value, frame, cache.uploaded_generation, index, g_copied_bytes);
+        }
+        else
+        {
+            success = frame_upload::upload_mapped(cache.api_device, cache.texture->texture, frame, cache.uploaded_generation, g_copied_bytes);
+        }
+        if (success)
+        {
+            cache.uploaded_generation = frame.generation;
+            g_texture_error = nullptr;
+        }
+        else
+        {
+            cache.uploaded_generation = 0;
+            g_texture_error = "Failed to upload LiveSplit window to texture.";
+        }
+    }
+}
+
+/// <summary>
+/// Makes the upload ring show a frame. Frames captured into the current ring only need their texture bound. Frames
+/// in host memory are copied once into the ring texture that the worker thread handed to the frame. The ring comes
+/// from g_upload_ring_pool, which replaces it when the frame doesn't fit or has been much smaller for a while, so
+/// that the worker thread can capture into it from then on.
+/// </summary>
+/// <param name="cache">The device that owns the upload ring.</param>
+/// <param name="frame">The LiveSplit frame that was just taken from the mailbox.</param>
+static void update_upload_ring(_Inout_ device_cache& cache, _In_ const livesplit_frame& frame)
+{
+    // Keep the ring while LiveSplit is gone, so that it is ready when LiveSplit comes back.
+    cache.uploaded_generation = 0;
+    if (frame.width == 0)
+        return;
+
+    upload_ring* const* ring = g_upload_ring_pool.acquire(frame.width, frame.height, get_time_us());
+    if (ring == nullptr)
+    {
+        // Keep going with a single texture that is uploaded to from the render thread.
+        cache.upload_ring_failed = true;
+        choose_upload_path();
+        return;
+    }
+    replace_upload_ring(*ring);
+
+    if (frame.ring_id == 0)
+    {
+        stage_timer timer(STAGE_UPLOAD);
+        const dirty_rect full = { 0, 0, frame.width, frame.height };
+        g_copied_bytes += frame_upload::copy_rows(g_ring->mapped[frame.ring_texture], frame, full);
+    }
+    else if (frame.ring_id != g_ring->id)
+    {
+        // The frame was captured into a ring that has been replaced since, so there is nothing to show.
+        return;
+    }
+    cache.uploaded_generation = frame.generation;
+}
+
+/// <summary>Opens or closes the statistics CSV file next to the add-on, as the setting demands.</summary>
+static void update_statistics_csv_file()
+{
+    if (g_statistics_csv && g_statistics_csv_file == nullptr && g_statistics_error == nullptr)
+    {
+        WCHAR path[MAX_PATH];
+        DWORD length = GetModuleFileNameW(g_module_handle, path, MAX_PATH);
+        while (length != 0 && path[length - 1] != L'\\')
+            length--;
+        std::wstring file_name(path, length);
+        file_name += STATISTICS_CSV_FILE_NAME;
+        if (length == 0 || _wfopen_s(&g_statistics_csv_file, file_name.c_str(), L"a") != 0)
+        {
+            g_statistics_csv_file = nullptr;
+            g_statistics_error = "Failed to open the statistics CSV file.";
+            return;
+        }
+        fseek(g_statistics_csv_file, 0, SEEK_END);
+        if (ftell(g_statistics_csv_file) == 0)
+            fputs("time_s,stage,count,p50_us,p99_us,max_us\n", g_statistics_csv_file);
+        g_statistics_csv_start_us = get_time_us();
+    }
+    else if (!g_statistics_csv && g_statistics_csv_file != nullptr)
+    {
+        fclose(g_statistics_csv_file);
+        g_statistics_csv_file = nullptr;
+    }
+}
+
+/// <summary>Appends the stage durations of the last second to the statistics CSV file.</summary>
+static void write_statistics_csv(_In_ uint64_t now)
+{
+    const double time_s = (now - g_statistics_csv_start_us) / 1000000.0;
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const stage_histogram::summary& summary = g_stage_summaries[stage];
+        fprintf(g_statistics_csv_file, "%.3f,%s,%u,%.3f,%.3f,%.3f\n", time_s, STAGE_NAMES[stage], summary.count,
+            summary.p50_ns / 1000.0, summary.p99_ns / 1000.0, summary.max_ns / 1000.0);
+    }
+    for (size_t i = 0; i < g_capture_sources.size(); i++)
+    {
+        // Executable names may contain commas and quotes, so the stage is quoted with any quotes doubled.
+        std::string stage = "\"capture ";
+        for (const char* c = g_capture_sources[i].image; *c != '\0'; c++)
+            stage.append(*c == '"' ? 2 : 1, *c);
+        stage += '"';
+        const stage_histogram::summary& summary = g_source_summaries[i];
+        fprintf(g_statistics_csv_file, "%.3f,%s,%u,%.3f,%.3f,%.3f\n", time_s, stage.c_str(), summary.count,
+            summary.p50_ns / 1000.0, summary.p99_ns / 1000.0, summary.max_ns / 1000.0);
+    }
+}
 
-// Other globals
-static device* g_device = nullptr;
-static HANDLE g_thread;
-static HANDLE g_event_worker_go, g_event_worker_done;
-static bool g_terminate_thread = false;
-static std::string g_osd_text = "";
-static bool g_create_texture = false;
-static bool g_destroy_texture = false;
-static bool g_have_livesplit_copy = false;
-static resource_desc g_texture_descriptor = resource_desc(0, 0, 1, 1, format::b8g8r8a8_unorm, 1, memory_heap::cpu_to_gpu, resource_usage::shader_resource_pixel, resource_flags::dynamic);
-static BITMAPINFOHEADER g_bitmap_info_header = { sizeof(BITMAPINFOHEADER), 0, 0, 1, 32, BI_RGB };
-static void* g_live_split_window_copy;
-static resource g_texture = {};
-static resource_view g_texture_view = {};
-static HWND g_livesplit_window_handle = NULL;
+/// <summary>
+/// The recorder's writer thread encodes the frames and presents queued in g_recorder every RECORDER_INTERVAL_MS, or
+/// as soon as the worker thread signals that frames are piling up, and writes them to g_recording_file, which it
+/// closes when it is told to stop. Nobody waits for the thread to exit, so it holds a reference on the add-on's module
+/// until it did.
+/// </summary>
+/// <param name="module">The add-on's module, which the thread releases when it exits.</param>
+static DWORD WINAPI recorder_thread(_In_ LPVOID module)
+{
+    bool written = g_recorder.begin(g_recording_file);
+    while (written && !g_recorder_stop.load(std::memory_order_acquire))
+    {
+        WaitForSingleObject(g_event_recorder_wake, RECORDER_INTERVAL_MS);
+        written = g_recorder.drain(g_recording_file);
+    }
+    // Whatever was queued before the producers stopped still goes into the file.
+    if (written)
+        written = g_recorder.drain(g_recording_file);
+    if (fclose(g_recording_file) != 0 || !written)
+        g_recording_failed.store(true, std::memory_order_release);
+    FreeLibraryAndExitThread((HMODULE)module, 0);
+}
 
-/// <summary>Identifies the LiveSplit window. Used in a callback to EnumWindows().</summary>
-/// <param name="hWnd">The current window being examined.</param>
-/// <returns>FALSE when LiveSplit has been found to stop the enumeration, TRUE otherwise.</returns>
-static BOOL CALLBACK identify_livesplit_window(_In_ HWND hWnd, _In_ LPARAM)
+/// <summary>Opens a new recording file next to the add-on, named after the current time, and starts the writer thread.</summary>
+static void start_recording()
 {
-    // Window must not be a hidden window.
-    if (IsWindowVisible(hWnd))
+    WCHAR path[MAX_PATH];
+    DWORD length = GetModuleFileNameW(g_module_handle, path, MAX_PATH);
+    while (length != 0 && path[length - 1] != L'\\')
+        length--;
+    SYSTEMTIME local_time;
+    GetLocalTime(&local_time);
+    WCHAR file_name[64];
+    swprintf_s(file_name, L"livesplit_overlay_%04u%02u%02u_%02u%02u%02u.lsrec", local_time.wYear, local_time.wMonth, local_time.wDay,
+        local_time.wHour, local_time.wMinute, local_time.wSecond);
+    const std::wstring file_path = std::wstring(path, length) + file_name;
+    if (length == 0 || _wfopen_s(&g_recording_file, file_path.c_str(), L"wb") != 0)
     {
-        // Check that this window belongs to a "LiveSplit.exe" process, as it could be e.g. an Explorer window open on the LiveSplit folder.
-        DWORD processId = 0;
-        GetWindowThreadProcessId(hWnd, &processId);
-        if (processId)
-        {
-            HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
-            if (hProcess != NULL)
-            {
-                DWORD fileNameLen;
-                static std::vector<WCHAR> textBuffer(64);
-                while (true)
-                {
-                    fileNameLen = GetProcessImageFileNameW(hProcess, &textBuffer[0], (DWORD)textBuffer.size());
-                    if (fileNameLen != 0 || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
-                        break;
-                    textBuffer.resize(textBuffer.size() * 2);
-                }
+        g_recording_file = nullptr;
+        g_recording_failed = true;
+        g_recording_error = "Failed to open the recording file.";
+        return;
+    }
+    setvbuf(g_recording_file, nullptr, _IOFBF, 256 * 1024);
 
-                if (fileNameLen >= 14 && CompareStringOrdinal(&textBuffer[fileNameLen - 14], 14, L"\\LiveSplit.exe", 14, FALSE) == CSTR_EQUAL)
-                {
-                    // Verify that the window's title is actually "LiveSplit".
-                    // We do this after identifying the process or else we could query our game's window which might become unresponsive.
-                    if (GetWindowTextLength(hWnd) == 9)
-                    {
-                        int captionLen = GetWindowTextW(hWnd, &textBuffer[0], (int)textBuffer.size());
-                        if (CompareStringOrdinal(&textBuffer[0], captionLen, L"LiveSplit", 9, FALSE) == CSTR_EQUAL)
-                        {
-                            g_livesplit_window_handle = hWnd;
-                            return FALSE;
-                        }
-                    }
-                }
-                CloseHandle(hProcess);
-            }
-        }
+    HMODULE module = NULL;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)&recorder_thread, &module);
+    g_recorder_stop = false;
+    g_recorder_thread = CreateThread(NULL, 0, &recorder_thread, module, 0, NULL);
+    if (g_recorder_thread == NULL)
+    {
+        FreeLibrary(module);
+        fclose(g_recording_file);
+        g_recording_file = nullptr;
+        g_recording_failed = true;
+        g_recording_error = "Failed to start the recording thread.";
+        return;
     }
-    return TRUE;
+    g_recording.store(true, std::memory_order_relaxed);
 }
 
 /// <summary>
-/// The worker thread is always run first. It is responsible for finding the LiveSplit window, getting its dimensions
-/// and copying it to an intermediate buffer provided by the main thread.
+/// Starts recording while LiveSplit is shown and recording is enabled, and stops it otherwise. A writer thread that
+/// is told to stop finishes writing on its own and is only cleaned up once it exited, so this never waits for it, and
+/// a new recording only starts after that. The caller holds g_render_mutex.
 /// </summary>
-/// <returns>0</returns>
-static DWORD WINAPI worker_thread(_In_ LPVOID)
+static void update_recording()
 {
-    while (!g_terminate_thread)
+    if (g_recorder_thread != NULL && g_recorder_stop.load(std::memory_order_relaxed) && WaitForSingleObject(g_recorder_thread, 0) == WAIT_OBJECT_0)
     {
-        // Reset the texture (re)creation status.
-        g_create_texture = false;
-        g_destroy_texture = g_texture_view.handle != 0;
+        CloseHandle(g_recorder_thread);
+        g_recorder_thread = NULL;
+        g_recording_file = nullptr;
+        if (g_recording_failed.load(std::memory_order_acquire) && g_recording_error == nullptr)
+            g_recording_error = "Failed to write the recording file.";
+    }
 
-        // Find the LiveSplit window.
-        if (g_livesplit_window_handle == NULL)
-        {
-            static ULONGLONG s_last_window_search_tick = 0;
-            ULONGLONG now = GetTickCount64();
-            if (now - s_last_window_search_tick >= 1000)
-            {
-                EnumWindows(&identify_livesplit_window, 0);
-                s_last_window_search_tick = now;
-            }
-        }
+    const bool record = g_record && g_livesplit_showing && !g_recording_failed.load(std::memory_order_acquire);
+    if (record && g_recorder_thread == NULL)
+    {
+        start_recording();
+    }
+    else if (!record && g_recorder_thread != NULL && !g_recorder_stop.load(std::memory_order_relaxed))
+    {
+        g_recording.store(false, std::memory_order_relaxed);
+        g_recorder_stop.store(true, std::memory_order_release);
+        SetEvent(g_event_recorder_wake);
+    }
+}
 
-        if (g_livesplit_window_handle != NULL)
-        {
-            if (!IsIconic(g_livesplit_window_handle))
-            {
-                // Get device context handle from the LiveSplit window, to get at its buffered image.
-                HDC device_context_handle = GetWindowDC(g_livesplit_window_handle);
-                if (device_context_handle != NULL)
-                {
-                    // Acquire the bitmap that contains the rendering of LiveSplit.
-                    HBITMAP bitmap_handle = (HBITMAP)GetCurrentObject(device_context_handle, OBJ_BITMAP);
-
-                    BITMAPCOREHEADER bitmap_core_header { sizeof(BITMAPCOREHEADER) };
-                    if (GetDIBits(device_context_handle, bitmap_handle, 0, 0, NULL, (LPBITMAPINFO)&bitmap_core_header, DIB_RGB_COLORS))
-                    {
-                        // Inform main thread that it needs to recreate the texture if LiveSplit window size changed.
-                        g_create_texture =
-                            bitmap_core_header.bcWidth != g_texture_descriptor.texture.width ||
-                            bitmap_core_header.bcHeight != g_texture_descriptor.texture.height;
-
-                        if (g_create_texture)
-                        {
-                            g_bitmap_info_header.biHeight = -bitmap_core_header.bcHeight;
-                            g_texture_descriptor.texture.width = bitmap_core_header.bcWidth;
-                            g_texture_descriptor.texture.height = bitmap_core_header.bcHeight;
-                        }
-                        else if (g_live_split_window_copy)
-                        {
-                            g_have_livesplit_copy = GetDIBits(device_context_handle, bitmap_handle, 0, bitmap_core_header.bcHeight, g_live_split_window_copy, (LPBITMAPINFO)&g_bitmap_info_header, DIB_RGB_COLORS);
-                            if (g_have_livesplit_copy)
-                            {
-                                g_destroy_texture &= g_create_texture;
-                            }
-                            else
-                            {
-                                g_osd_text = "Failed to copy LiveSplit window contents.";
-                            }
-                        }
-                    }
-                    else
-                    {
-                        g_osd_text = "Failed to query buffer format of LiveSplit device context.";
-                    }
-
-                    // Release the device context from LiveSplit so it can continue rendering.
-                    ReleaseDC(g_livesplit_window_handle, device_context_handle);
-                }
-                else
-                {
-                    // The LiveSplit window probably closed, let's search for it again next time.
-                    g_livesplit_window_handle = NULL;
-                    g_osd_text = "Couldn't acquire LiveSplit device context.";
-                }
-            }
-            else
-            {
-                g_osd_text = "LiveSplit is minimized.";
-            }
-        }
-        else
-        {
-            g_osd_text = "Waiting for LiveSplit ";
-            g_osd_text += SPINNER_CHARS[GetTickCount64() / 200 % 4];
-        }
+/// <summary>
+/// Updates the per-frame capture and copy volumes, the stage durations and the allocation rates shown on the OSD
+/// once per second.
+/// </summary>
+static void update_statistics()
+{
+    const uint64_t now = get_time_us();
+    g_stats_frames++;
+    if (now - g_stats_start_us >= 1000000)
+    {
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            g_stage_summaries[stage] = g_stage_histograms[stage].roll();
+        for (size_t i = 0; i < MAX_SOURCES; i++)
+            g_source_summaries[i] = g_source_histograms[i].roll();
+        update_statistics_csv_file();
+        if (g_statistics_csv_file != nullptr)
+            write_statistics_csv(now);
 
-        // Wait until after a frame has been rendered or the LiveSplit overlay is removed.
-        SignalObjectAndWait(g_event_worker_done, g_event_worker_go, INFINITE, FALSE);
+        const uint64_t captured_bytes = g_captured_bytes.load(std::memory_order_relaxed);
+        g_captured_kib_per_frame = (captured_bytes - g_stats_captured_bytes) / 1024.0 / g_stats_frames;
+        g_copied_kib_per_frame = (g_copied_bytes - g_stats_copied_bytes) / 1024.0 / g_stats_frames;
+        g_stats_captured_bytes = captured_bytes;
+        g_stats_copied_bytes = g_copied_bytes;
+        g_stats_frames = 0;
+        g_stats_start_us = now;
+
+        // The slot for this second still holds the counts from a minute ago.
+        uint64_t* minute_ago = g_allocation_history[g_allocation_second++ % 60];
+        const uint64_t host_allocations = g_host_allocations.load(std::memory_order_relaxed);
+        g_textures_per_minute = g_texture_creations - minute_ago[0];
+        g_host_allocations_per_minute = host_allocations - minute_ago[1];
+        minute_ago[0] = g_texture_creations;
+        minute_ago[1] = host_allocations;
     }
+}
 
-    return 0;
+/// <summary>Finds the top-left corner on screen for something to draw with the given placement.</summary>
+/// <param name="width">Width of what is drawn.</param>
+/// <param name="height">Height of what is drawn.</param>
+/// <param name="alignment">Where to draw it, from 0 for left/top to 1 for right/bottom.</param>
+/// <param name="offsets">How far to keep it away from the borders.</param>
+static ImVec2 get_screen_position(_In_ float width, _In_ float height, _In_ const float alignment[2], _In_ const int offsets[2])
+{
+    const ImVec2 disp_size = ImGui::GetIO().DisplaySize;
+    ImVec2 position;
+    frame_upload::screen_position(disp_size.x, disp_size.y, width, height, alignment, offsets, position.x, position.y);
+    return position;
 }
 
-/// <summary>Destroys the LiveSplit texture and the view on it, if they exists. Also frees the offline copy of the LiveSplit window.</summary>
-static void destroy_texture()
+/// <summary>
+/// Draws a part of the LiveSplit texture as an ImGui image onto the game, leaving any scaling that wasn't done on
+/// the CPU to the GPU.
+/// </summary>
+/// <param name="texture_view">The view on the LiveSplit texture.</param>
+/// <param name="texture_width">Width of the LiveSplit texture.</param>
+/// <param name="texture_height">Height of the LiveSplit texture.</param>
+/// <param name="rect">The part of the texture to draw.</param>
+/// <param name="alignment">Where to draw it, from 0 for left/top to 1 for right/bottom.</param>
+/// <param name="offsets">How far to keep it away from the borders.</param>
+static void draw_region(_In_ resource_view texture_view, _In_ uint32_t texture_width, _In_ uint32_t texture_height, _In_ const dirty_rect& rect, _In_ const float alignment[2], _In_ const int offsets[2])
 {
-    if (g_texture_view.handle != 0)
-    {
-        g_device->destroy_resource_view(g_texture_view);
-        g_texture_view = {};
-    }
-    if (g_texture.handle != 0)
+    const ImVec2 disp_size = ImGui::GetIO().DisplaySize;
+    const draw_quad quad = frame_upload::place_region(disp_size.x, disp_size.y, texture_width, texture_height, rect, g_draw_scale, alignment, offsets);
+    ImGui::GetBackgroundDrawList()->AddImageQuad(texture_view.handle, ImVec2(quad.left, quad.top), ImVec2(quad.right, quad.top),
+        ImVec2(quad.right, quad.bottom), ImVec2(quad.left, quad.bottom), ImVec2(quad.u1, quad.v1), ImVec2(quad.u3, quad.v1),
+        ImVec2(quad.u3, quad.v3), ImVec2(quad.u1, quad.v3));
+}
+
+/// <summary>
+/// Draws the current split and the timer as text, from the state the LiveSplit Server reported, with the time
+/// advanced to this frame. It takes the place of the LiveSplit window and uses its placement, scale, background and
+/// opacity settings.
+/// </summary>
+/// <param name="timer">The last timer state received.</param>
+static void draw_native_timer(_In_ const timer_state& timer)
+{
+    char time_text[32];
+    timer_state::format_time(timer.time_at(get_time_us()), time_text, sizeof(time_text));
+    ImFont* font = ImGui::GetFont();
+    const float split_size = ImGui::GetFontSize() * g_scale;
+    const float timer_size = split_size * 2.5f;
+    const float padding = split_size / 2;
+    const ImVec2 split_extent = font->CalcTextSizeA(split_size, FLT_MAX, 0, timer.split_name.c_str());
+    const ImVec2 timer_extent = font->CalcTextSizeA(timer_size, FLT_MAX, 0, time_text);
+    const float width = max(split_extent.x, timer_extent.x) + 2 * padding;
+    const float height = (timer.split_name.empty() ? 0 : split_extent.y) + timer_extent.y + 2 * padding;
+    const ImVec2 p1 = get_screen_position(width, height, g_livesplit_alignment, g_livesplit_offsets);
+
+    // Like LiveSplit's timer, the color shows whether it is running, paused or finished.
+    ImU32 timer_color = IM_COL32(0x99, 0x99, 0x99, 255);
+    if (timer.phase == timer_state::PHASE_RUNNING)
+        timer_color = IM_COL32(0x22, 0xcc, 0x44, 255);
+    else if (timer.phase == timer_state::PHASE_ENDED)
+        timer_color = IM_COL32(0x29, 0x9f, 0xe8, 255);
+    const ImU32 alpha = ImU32(g_opacity * 255 + 0.5f) << 24;
+    ImDrawList* draw_list = ImGui::GetBackgroundDrawList();
+    if (!g_key_background)
+        draw_list->AddRectFilled(p1, ImVec2(p1.x + width, p1.y + height), ImGui::ColorConvertFloat4ToU32(ImVec4(g_key_color[0], g_key_color[1], g_key_color[2], g_opacity)));
+    if (!timer.split_name.empty())
+        draw_list->AddText(font, split_size, ImVec2(p1.x + padding, p1.y + padding), IM_COL32(255, 255, 255, 0) | alpha, timer.split_name.c_str());
+    draw_list->AddText(font, timer_size, ImVec2(p1.x + width - padding - timer_extent.x, p1.y + height - padding - timer_extent.y), (timer_color & 0xffffff) | alpha, time_text);
+}
+
+/// <summary>Looks up the placement on screen that a frame region is drawn with.</summary>
+/// <param name="placement">The placement of the frame region.</param>
+/// <param name="alignment">Receives where to draw the region.</param>
+/// <param name="offsets">Receives how far to keep the region away from the borders.</param>
+/// <returns>false if the region or additional window was removed from the settings since the frame was captured.</returns>
+static bool get_placement(_In_ uint32_t placement, _Out_ const float*& alignment, _Out_ const int*& offsets)
+{
+    alignment = g_livesplit_alignment;
+    offsets = g_livesplit_offsets;
+    if (placement >= PLACEMENT_SOURCE)
     {
-        g_device->destroy_resource(g_texture);
-        g_texture = {};
+        if (placement - PLACEMENT_SOURCE >= g_capture_sources.size())
+            return false;
+        alignment = g_capture_sources[placement - PLACEMENT_SOURCE].alignment;
+        offsets = g_capture_sources[placement - PLACEMENT_SOURCE].offsets;
     }
-    free(g_live_split_window_copy);
-    g_live_split_window_copy = nullptr;
-    g_have_livesplit_copy = false;
-    if (!g_create_texture)
+    else if (placement >= PLACEMENT_REGION)
     {
-        g_texture_descriptor.texture.width = 0;
-        g_texture_descriptor.texture.height = 0;
+        if (placement - PLACEMENT_REGION >= g_livesplit_regions.size())
+            return false;
+        alignment = g_livesplit_regions[placement - PLACEMENT_REGION].alignment;
+        offsets = g_livesplit_regions[placement - PLACEMENT_REGION].offsets;
     }
-    g_destroy_texture = false;
+    return true;
 }
 
 /// <summary>
-/// Here, on the main thread, we allocate the intermediate buffer for the LiveSplit window copy according to the
-/// dimensions provided by the worker thread. Once the worker thread has started filling it, we upload it to a GPU
-/// texture and render it as an ImGui image onto the game.
+/// Here, on the render thread of a device, we take the newest frame the worker thread published, without waiting
+/// for one. Every device takes the same frame over once: it is either uploaded into the device's texture or, with an
+/// upload ring, is already in a texture. The texture is then rendered as an ImGui image onto the game, also on
+/// frames where the worker thread had nothing new to show.
 /// </summary>
 /// <param name="runtime">The ReShade effect runtime.</param>
 static void draw_livesplit(_In_ effect_runtime* runtime)
 {
-    if (runtime->get_device() != g_device)
+    const std::lock_guard<std::mutex> lock(g_render_mutex);
+    device_cache* const cache = find_device_cache(runtime->get_device());
+    if (cache == nullptr)
         return;
 
-    WaitForSingleObject(g_event_worker_done, INFINITE);
+    stage_timer draw_timer(STAGE_DRAW);
+    // With several swapchains the draws of all of them are taken for one, which makes captures start earlier.
+    const uint64_t now = get_time_us();
+    g_capture_phase.on_draw(now);
+    g_last_draw_us.store(now, std::memory_order_relaxed);
+    if (g_frames.take())
+    {
+        g_osd_text = g_frames.front().status;
+        g_draw_scale = g_frames.front().draw_scale;
+        if (g_frames.front().width != 0 || g_frames.front().timer_connected)
+            g_stage_histograms[STAGE_AGE].record((now - g_frames.front().captured_us) * 1000);
+    }
+    const livesplit_frame& frame = g_frames.front();
+    if (frame.generation != cache->frame_generation)
+    {
+        cache->frame_generation = frame.generation;
+        if (cache->use_upload_ring)
+            update_upload_ring(*cache, frame);
+        else
+            update_texture(*cache, runtime->get_command_queue(), frame);
+    }
+    update_statistics();
 
-    // Handle worker thread requests to destroy and/or create the texture.
-    if (g_destroy_texture)
+    // The texture is usually larger than the frame, which only covers its top-left corner.
+    resource_view texture_view = cache->texture != nullptr ? cache->texture->view : resource_view {};
+    uint32_t width = cache->texture_pool.width();
+    uint32_t height = cache->texture_pool.height();
+    if (cache->use_upload_ring && g_ring != nullptr)
     {
-        destroy_texture();
+        texture_view = g_ring->views[frame.ring_texture];
+        width = g_ring->width;
+        height = g_ring->height;
     }
 
-    if (g_create_texture)
+    // Draw a quad for the whole LiveSplit texture or one for each region and additional window packed into it.
+    if (texture_view.handle != 0 && cache->uploaded_generation != 0)
     {
-        g_create_texture = false;
-        // For Vulkan I'm using cpu_only as a hack, since it enables linear tiling, allowing us to upload linear bitmap data.
-        g_texture_descriptor.heap = g_device->get_api() == device_api::vulkan ? memory_heap::cpu_only : memory_heap::cpu_to_gpu;
-        if (g_device->create_resource(g_texture_descriptor, nullptr, resource_usage::shader_resource_pixel, &g_texture))
-        {
-            if (g_device->create_resource_view(g_texture, resource_usage::shader_resource, TEXTURE_VIEW_DESCRIPTOR, &g_texture_view))
-            {
-                subresource_data buffer_info;
-                if (g_device->map_texture_region(g_texture, 0, nullptr, map_access::write_discard, &buffer_info))
-                {
-                    g_device->unmap_texture_region(g_texture, 0);
-                    g_bitmap_info_header.biWidth = buffer_info.row_pitch / 4;
-                    g_live_split_window_copy = malloc(buffer_info.row_pitch * -g_bitmap_info_header.biHeight);
-                    if (g_live_split_window_copy == nullptr)
-                    {
-                        g_osd_text = "Failed to allocate intermediate buffer for LiveSplit window copy.";
-                        g_destroy_texture = true;
-                    }
-                }
-                else
-                {
-                    g_osd_text = "Failed to map texture to host memory.";
-                    g_destroy_texture = true;
-                }
-            }
-            else
-            {
-                g_osd_text = "Failed to create resource view of texture.";
-            }
-        }
-        else
+        stage_timer submit_timer(STAGE_SUBMIT);
+        // Every swapchain on the device counts as a draw, so the worker thread waits for that many more before it
+        // writes to the ring texture again.
+        if (cache->use_upload_ring && g_ring != nullptr)
+            g_ring_texture_free_draws[frame.ring_texture].store(g_ring_draw_count.load(std::memory_order_relaxed)
+                + MAX_FRAMES_IN_FLIGHT * (std::max)(cache->swapchain_count, 1u), std::memory_order_release);
+        if (frame.regions.empty())
         {
-            g_osd_text = "Failed to create texture.";
+            const dirty_rect whole = { 0, 0, frame.width, frame.height };
+            draw_region(texture_view, width, height, whole, g_livesplit_alignment, g_livesplit_offsets);
         }
-
-        if (g_destroy_texture)
+        for (const frame_region& region : frame.regions)
         {
-            destroy_texture();
+            const float* alignment;
+            const int* offsets;
+            if (get_placement(region.placement, alignment, offsets))
+                draw_region(texture_view, width, height, region.rect, alignment, offsets);
         }
     }
+    if (frame.timer_connected)
+    {
+        stage_timer submit_timer(STAGE_SUBMIT);
+        draw_native_timer(frame.timer);
+    }
+
+    // The recording follows the first device, so that each game frame shows up once.
+    update_recording();
+    if (g_recording.load(std::memory_order_relaxed) && cache == g_device_caches.front().get())
+        g_recorder.push_present(now, cache->uploaded_generation);
+}
 
-    if (g_live_split_window_copy && g_have_livesplit_copy)
+/// <summary>This renders our error or informational messages into the default OSD that ReShade provides for its own FPS counter.</summary>
+static void draw_message_osd(_In_ effect_runtime*)
+{
+    // Show any error or informational message on the default OSD.
     {
-        // Upload worker thread's copy of LiveSplit into the texture.
-        subresource_data buffer_info;
-        if (g_device->map_texture_region(g_texture, 0, nullptr, map_access::write_discard, &buffer_info))
+        const std::lock_guard<std::mutex> lock(g_render_mutex);
+        if (g_osd_text.length())
+        {
+            ImGui::TextUnformatted(g_osd_text.c_str(), g_osd_text.c_str() + g_osd_text.length());
+        }
+        if (g_texture_error != nullptr)
         {
-            const char* const end = (char*)buffer_info.data + buffer_info.row_pitch * -g_bitmap_info_header.biHeight;
-            char* dst = (char*)buffer_info.data;
-            const char* src = (char*)g_live_split_window_copy;
-            while (dst != end)
+            ImGui::TextUnformatted(g_texture_error);
+        }
+        if (g_show_statistics)
+        {
+            ImGui::Text("LiveSplit capture: %.1f KiB/frame, host copy: %.1f KiB/frame", g_captured_kib_per_frame, g_copied_kib_per_frame);
+            ImGui::Text("Allocations: %llu textures/min, %llu host buffers/min", g_textures_per_minute, g_host_allocations_per_minute);
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                const stage_histogram::summary& summary = g_stage_summaries[stage];
+                ImGui::Text("%-9s %4u/s  p50 %7.1f us  p99 %7.1f us  max %7.1f us", STAGE_NAMES[stage], summary.count,
+                    summary.p50_ns / 1000.0, summary.p99_ns / 1000.0, summary.max_ns / 1000.0);
+            }
+            for (size_t i = 0; i < g_capture_sources.size(); i++)
             {
-                memcpy(dst, src, buffer_info.row_pitch);
-                src += buffer_info.row_pitch;
-                dst += buffer_info.row_pitch;
+                const stage_histogram::summary& summary = g_source_summaries[i];
+                ImGui::Text("%-9s %4u/s  p50 %7.1f us  p99 %7.1f us  max %7.1f us  (%s)", "window", summary.count,
+                    summary.p50_ns / 1000.0, summary.p99_ns / 1000.0, summary.max_ns / 1000.0, g_capture_sources[i].image);
             }
-            g_device->unmap_texture_region(g_texture, 0);
-            g_osd_text = "";
         }
-        else
+        if (g_statistics_error != nullptr)
         {
-            g_osd_text = "Failed to upload LiveSplit window to texture.";
+            ImGui::TextUnformatted(g_statistics_error);
         }
-
-        // Draw a quad with the LiveSplit texture on the background.
-        if (g_texture_view.handle != 0 && g_have_livesplit_copy)
+        if (g_recording.load(std::memory_order_relaxed))
+        {
+            ImGui::Text("Recording: %.1f MiB, dropped %llu frames, %llu presents", g_recorder.bytes_written() / 1048576.0,
+                g_recorder.dropped_frames(), g_recorder.dropped_presents());
+        }
+        if (g_recording_error != nullptr)
         {
-            ImVec2 disp_size = ImGui::GetIO().DisplaySize;
-            ImVec2 offsets = {
-                min(g_livesplit_offsets[0], (disp_size.x - g_texture_descriptor.texture.width) / 2),
-                min(g_livesplit_offsets[1], (disp_size.y - g_texture_descriptor.texture.height) / 2)
-            };
-            ImVec2 p1 = ImVec2(
-                offsets.x + g_livesplit_alignment[0] * (disp_size.x - 2 * offsets.x - g_texture_descriptor.texture.width),
-                offsets.y + g_livesplit_alignment[1] * (disp_size.y - 2 * offsets.y - g_texture_descriptor.texture.height)
-            );
-            ImVec2 p3 = ImVec2(p1.x + g_texture_descriptor.texture.width, p1.y + g_texture_descriptor.texture.height);
-            ImVec2 p2 = ImVec2(p3.x, p1.y);
-            ImVec2 p4 = ImVec2(p1.x, p3.y);
-            ImGui::GetBackgroundDrawList()->AddImageQuad(g_texture_view.handle, p1, p2, p3, p4);
+            ImGui::TextUnformatted(g_recording_error);
         }
     }
 }
 
-/// <summary>This renders our error or informational messages into the default OSD that ReShade provides for its own FPS counter.</summary>
-static void draw_message_osd(_In_ effect_runtime*)
+/// <summary>Starts a worker thread, which begins with a capture right away. The caller holds g_render_mutex.</summary>
+static void start_worker()
 {
-    // Show any error or informational message on the default OSD.
+    // The worker thread keeps the add-on loaded until it exited, since nobody waits for it.
+    HMODULE module = NULL;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)&worker_thread, &module);
+    g_event_worker_go = CreateEvent(NULL, FALSE, FALSE, NULL);
+    g_event_worker_idle = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_worker_busy = true;
+    g_capture_start_us = 0;
+    g_capture_duration_us = 0;
+    g_thread = CreateThread(NULL, 0, &worker_thread, module, 0, NULL);
+    if (g_thread == NULL)
     {
-        if (g_osd_text.length())
+        FreeLibrary(module);
+        g_worker_busy = false;
+        g_texture_error = "Failed to start the capture thread.";
+    }
+}
+
+/// <summary>
+/// Starts, stops and cleans up after the worker thread as g_worker_lifecycle decides. A worker thread that is told
+/// to stop finishes its current pass and exits on its own, and is only cleaned up once it did, so this never waits
+/// for it. The caller holds g_render_mutex.
+/// </summary>
+static void update_worker_lifecycle()
+{
+    bool exited = false;
+    if (g_worker_lifecycle.get_state() == worker_lifecycle::state::stopping)
+    {
+        exited = g_thread == NULL || WaitForSingleObject(g_thread, 0) == WAIT_OBJECT_0;
+        if (exited)
         {
-            ImGui::TextUnformatted(g_osd_text.c_str(), g_osd_text.c_str() + g_osd_text.length());
+            if (g_thread != NULL)
+                CloseHandle(g_thread);
+            CloseHandle(g_event_worker_go);
+            CloseHandle(g_event_worker_idle);
+            g_thread = NULL;
+            g_event_worker_go = NULL;
+            g_event_worker_idle = NULL;
+            g_terminate_thread = false;
+            g_worker_busy = false;
+            g_capture_pending = false;
         }
     }
+
+    switch (g_worker_lifecycle.update(get_time_us(), exited))
+    {
+    case worker_lifecycle::action::start:
+        start_worker();
+        break;
+    case worker_lifecycle::action::stop:
+        // Wakes the worker thread if it is parked, or else it finds the event signaled after its current pass.
+        g_terminate_thread = true;
+        SetEvent(g_event_worker_go);
+        break;
+    default:
+        break;
+    }
 }
 
-/// <summary>Sets up all the hooks and resources to show the LiveSplit window and frees resources when the overlay is being hidden.</summary>
+/// <summary>
+/// Sets up all the hooks and resources to show the LiveSplit window and frees graphics resources when the overlay is
+/// being hidden. Hiding only parks the worker thread, which is shared by all devices, so that showing LiveSplit again
+/// picks up where it left off. It is stopped after a while in standby or when the last device that could show
+/// LiveSplit goes away. Nothing here waits for the worker thread or the GPU. The caller holds g_render_mutex.
+/// </summary>
 /// <param name="show">Whether the LiveSplit overlay should be shown.</param>
 static void update_livesplit_visibility(_In_ bool show)
 {
-    static bool s_livesplit_showing = false;
+    show = show && !g_device_caches.empty();
+    g_worker_lifecycle.set_wanted(show, !g_device_caches.empty());
+    update_worker_lifecycle();
+    if (show && !g_livesplit_showing)
+    {
+        g_capture_phase.reset();
+        reshade::register_event<reshade::addon_event::reshade_overlay>(&draw_livesplit);
+        reshade::register_overlay("OSD", &draw_message_osd);
+        g_livesplit_showing = true;
+        choose_upload_path();
+    }
+    else if (!show && g_livesplit_showing)
+    {
+        reshade::unregister_overlay("OSD", &draw_message_osd);
+        reshade::unregister_event<reshade::addon_event::reshade_overlay>(&draw_livesplit);
+        g_livesplit_showing = false;
+        update_recording();
+        // Textures and upload rings are retired and destroyed on later presents, once the GPU and the worker thread
+        // are done with them.
+        for (const std::unique_ptr<device_cache>& cache : g_device_caches)
+            destroy_texture(*cache);
+        choose_upload_path();
+        g_texture_error = nullptr;
+        if (g_statistics_csv_file != nullptr)
+        {
+            fclose(g_statistics_csv_file);
+            g_statistics_csv_file = nullptr;
+        }
+    }
+}
+
+/// <summary>Converts the background key color from the settings dialog to 0xRRGGBB, as stored in the INI.</summary>
+static int get_key_color_rgb()
+{
+    return int(g_key_color[0] * 255 + 0.5f) << 16 | int(g_key_color[1] * 255 + 0.5f) << 8 | int(g_key_color[2] * 255 + 0.5f);
+}
+
+/// <summary>Hands the background key and opacity settings to the worker thread.</summary>
+static void update_key_params()
+{
+    const key_params params = { uint32_t(get_key_color_rgb()), uint8_t(g_key_tolerance), uint8_t(g_opacity * 255 + 0.5f), g_key_background };
+    g_key_params.store(params.pack(), std::memory_order_relaxed);
+}
+
+/// <summary>Converts UTF-8 text from the settings to the UTF-16 that the Win32 API uses.</summary>
+static std::wstring to_wide(_In_z_ const char* text)
+{
+    std::wstring result(strlen(text), L'\0');
+    const int length = MultiByteToWideChar(CP_UTF8, 0, text, int(strlen(text)), &result[0], int(result.size()));
+    result.resize(length);
+    return result;
+}
+
+/// <summary>Hands the source rectangles of the regions and the additional windows to look for to the worker thread.</summary>
+static void update_shared_layout()
+{
+    std::lock_guard<std::mutex> lock(g_shared_layout_mutex);
+    g_shared_regions.clear();
+    for (const livesplit_region& region : g_livesplit_regions)
+    {
+        const uint32_t left = uint32_t((std::max)(region.source[0], 0));
+        const uint32_t top = uint32_t((std::max)(region.source[1], 0));
+        g_shared_regions.push_back({ left, top, left + uint32_t((std::max)(region.source[2], 0)), top + uint32_t((std::max)(region.source[3], 0)) });
+    }
+    g_shared_sources.clear();
+    for (const capture_source& source : g_capture_sources)
+        g_shared_sources.push_back({ L"\\" + to_wide(source.image), to_wide(source.title), source.priority, source.rate });
+    g_shared_layout_version.fetch_add(1, std::memory_order_release);
+}
+
+/// <summary>Stores the regions in the INI as "left,top,width,height,alignment x,alignment y,offset x,offset y" separated by semicolons.</summary>
+static void save_regions()
+{
+    std::string value;
+    for (const livesplit_region& region : g_livesplit_regions)
+    {
+        char entry[128];
+        snprintf(entry, sizeof(entry), "%s%d,%d,%d,%d,%g,%g,%d,%d", value.empty() ? "" : ";", region.source[0], region.source[1], region.source[2], region.source[3],
+            region.alignment[0], region.alignment[1], region.offsets[0], region.offsets[1]);
+        value += entry;
+    }
+    reshade::set_config_value(nullptr, INI_SECTION, INI_REGIONS, value.c_str());
+}
+
+/// <summary>Reads the regions from the INI, see save_regions().</summary>
+static void load_regions()
+{
+    char value[1024] = "";
+    size_t size = sizeof(value);
+    g_livesplit_regions.clear();
+    if (!reshade::get_config_value(nullptr, INI_SECTION, INI_REGIONS, value, &size))
+        return;
+
+    const char* entry = value;
+    livesplit_region region;
+    int length = 0;
+    while (g_livesplit_regions.size() < MAX_REGIONS && sscanf_s(entry, "%d,%d,%d,%d,%f,%f,%d,%d%n", &region.source[0], &region.source[1], &region.source[2], &region.source[3],
+        &region.alignment[0], &region.alignment[1], &region.offsets[0], &region.offsets[1], &length) == 8)
+    {
+        region.alignment[0] = std::clamp(region.alignment[0], 0.0f, 1.0f);
+        region.alignment[1] = std::clamp(region.alignment[1], 0.0f, 1.0f);
+        g_livesplit_regions.push_back(region);
+        entry += length;
+        if (*entry != ';')
+            break;
+        entry++;
+    }
+}
+
+/// <summary>Shows the settings of the regions. Without any, the whole LiveSplit window is shown.</summary>
+static void draw_region_settings()
+{
+    if (!ImGui::TreeNode("Regions"))
+        return;
 
-    if (show && !s_livesplit_showing)
+    bool changed = false;
+    for (size_t i = 0; i < g_livesplit_regions.size(); i++)
     {
-        if (g_device->get_api() == device_api::d3d12)
+        livesplit_region& region = g_livesplit_regions[i];
+        ImGui::PushID(int(i));
+        changed |= ImGui::DragInt4("Left/Top/Width/Height in LiveSplit", region.source, 1, 0, INT_MAX, "%d", ImGuiSliderFlags_AlwaysClamp);
+        changed |= ImGui::SliderFloat2("Vertical/Horizontal Alignment", region.alignment, 0, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+        changed |= ImGui::DragInt2("Vertical/Horizontal Offsets", region.offsets, 1, 0, INT_MAX, NULL, 0);
+        const bool removed = ImGui::Button("Remove Region");
+        ImGui::PopID();
+        if (removed)
         {
-            g_osd_text = "LiveSplit Overlay: DX12 is not supported.";
+            g_livesplit_regions.erase(g_livesplit_regions.begin() + i);
+            changed = true;
+            break;
         }
-        else
+    }
+    if (g_livesplit_regions.size() < MAX_REGIONS && ImGui::Button("Add Region"))
+    {
+        g_livesplit_regions.push_back({ { 0, 0, 300, 100 }, { 0, 0 }, { 0, 0 } });
+        changed = true;
+    }
+    if (changed)
+    {
+        save_regions();
+        update_shared_layout();
+    }
+    ImGui::TreePop();
+}
+
+/// <summary>
+/// Stores the additional windows in the INI as "executable|title|alignment x,alignment y,offset x,offset y,priority,rate"
+/// separated by semicolons. Neither separator can be used in an executable name or title pattern. Windows without
+/// either are still being edited and not stored.
+/// </summary>
+static void save_sources()
+{
+    std::string value;
+    for (const capture_source& source : g_capture_sources)
+    {
+        if (source.image[0] == '\0' || source.title[0] == '\0')
+            continue;
+        char entry[256];
+        snprintf(entry, sizeof(entry), "%s%s|%s|%g,%g,%d,%d,%d,%d", value.empty() ? "" : ";", source.image, source.title,
+            source.alignment[0], source.alignment[1], source.offsets[0], source.offsets[1], source.priority, source.rate);
+        value += entry;
+    }
+    reshade::set_config_value(nullptr, INI_SECTION, INI_SOURCES, value.c_str());
+}
+
+/// <summary>Reads the additional windows from the INI, see save_sources().</summary>
+static void load_sources()
+{
+    char value[2048] = "";
+    size_t size = sizeof(value);
+    g_capture_sources.clear();
+    if (!reshade::get_config_value(nullptr, INI_SECTION, INI_SOURCES, value, &size))
+        return;
+
+    const char* entry = value;
+    capture_source source;
+    int length = 0;
+    while (g_capture_sources.size() < MAX_SOURCES && sscanf_s(entry, "%63[^|;]|%127[^|;]|%f,%f,%d,%d,%d,%d%n", source.image, unsigned(sizeof(source.image)),
+        source.title, unsigned(sizeof(source.title)), &source.alignment[0], &source.alignment[1], &source.offsets[0], &source.offsets[1],
+        &source.priority, &source.rate, &length) == 8)
+    {
+        source.alignment[0] = std::clamp(source.alignment[0], 0.0f, 1.0f);
+        source.alignment[1] = std::clamp(source.alignment[1], 0.0f, 1.0f);
+        source.priority = std::clamp(source.priority, 0, MAX_SOURCE_PRIORITY);
+        source.rate = std::clamp(source.rate, 0, MAX_SOURCE_RATE);
+        g_capture_sources.push_back(source);
+        entry += length;
+        if (*entry != ';')
+            break;
+        entry++;
+    }
+}
+
+/// <summary>Shows the settings of the windows that are captured along with LiveSplit.</summary>
+static void draw_source_settings()
+{
+    if (!ImGui::TreeNode("Additional Windows"))
+        return;
+
+    bool changed = false;
+    for (size_t i = 0; i < g_capture_sources.size(); i++)
+    {
+        capture_source& source = g_capture_sources[i];
+        ImGui::PushID(int(i));
+        changed |= ImGui::InputText("Executable", source.image, sizeof(source.image));
+        changed |= ImGui::InputText("Window Title (* and ? match any text)", source.title, sizeof(source.title));
+        changed |= ImGui::SliderFloat2("Vertical/Horizontal Alignment", source.alignment, 0, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+        changed |= ImGui::DragInt2("Vertical/Horizontal Offsets", source.offsets, 1, 0, INT_MAX, NULL, 0);
+        changed |= ImGui::SliderInt("Priority", &source.priority, 0, MAX_SOURCE_PRIORITY, "%d", ImGuiSliderFlags_AlwaysClamp);
+        changed |= ImGui::SliderInt("Capture Rate (Hz, 0 = with LiveSplit)", &source.rate, 0, MAX_SOURCE_RATE, "%d", ImGuiSliderFlags_AlwaysClamp);
+        const bool removed = ImGui::Button("Remove Window");
+        ImGui::PopID();
+        if (removed)
         {
-            g_event_worker_go = CreateEvent(NULL, FALSE, FALSE, NULL);
-            g_event_worker_done = CreateEvent(NULL, FALSE, FALSE, NULL);
-            g_thread = CreateThread(NULL, 0, &worker_thread, NULL, 0, NULL);
-            reshade::register_event<reshade::addon_event::reshade_overlay>(&draw_livesplit);
+            g_capture_sources.erase(g_capture_sources.begin() + i);
+            changed = true;
+            break;
         }
-        reshade::register_overlay("OSD", &draw_message_osd);
     }
-    else if (!show && s_livesplit_showing)
+    if (g_capture_sources.size() < MAX_SOURCES && ImGui::Button("Add Window"))
     {
-        reshade::unregister_overlay("OSD", &draw_message_osd);
-        if (g_device->get_api() != device_api::d3d12)
+        g_capture_sources.push_back({ "", "*", { 1, 0 }, { 0, 0 }, 0, 0 });
+        changed = true;
+    }
+    if (changed)
+    {
+        // The separators of the INI entry can't be stored in it.
+        for (capture_source& source : g_capture_sources)
         {
-            reshade::unregister_event<reshade::addon_event::reshade_overlay>(&draw_livesplit);
-            // Signal worker thread to terminate and close related handles
-            g_terminate_thread = true;
-            SignalObjectAndWait(g_event_worker_go, g_thread, INFINITE, FALSE);
-            g_terminate_thread = false;
-            CloseHandle(g_thread);
-            CloseHandle(g_event_worker_done);
-            CloseHandle(g_event_worker_go);
-            destroy_texture();
+            std::replace_if(std::begin(source.image), std::end(source.image), [](char c) { return c == '|' || c == ';'; }, '_');
+            std::replace_if(std::begin(source.title), std::end(source.title), [](char c) { return c == '|' || c == ';'; }, '?');
         }
+        save_sources();
+        update_shared_layout();
     }
-    s_livesplit_showing = show;
+    ImGui::TreePop();
 }
 
 /// <summary>This is the addon configuration section in ReShade.</summary>
@@ -363,6 +2441,7 @@ static void draw_settings_overlay(_In_ effect_runtime*)
     if (ImGui::Checkbox("Show LiveSplit", &g_show_livesplit))
     {
         reshade::set_config_value(nullptr, INI_SECTION, INI_SHOW, g_show_livesplit);
+        const std::lock_guard<std::mutex> lock(g_render_mutex);
         update_livesplit_visibility(g_show_livesplit);
     }
     if (ImGui::SliderFloat2("Vertical/Horizontal Alignment", g_livesplit_alignment, 0, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp))
@@ -375,41 +2454,229 @@ static void draw_settings_overlay(_In_ effect_runtime*)
         reshade::set_config_value(nullptr, INI_SECTION, INI_OFFSET_X, g_livesplit_offsets[0]);
         reshade::set_config_value(nullptr, INI_SECTION, INI_OFFSET_Y, g_livesplit_offsets[1]);
     }
+    int capture_rate_index = int(std::find(std::begin(CAPTURE_RATES), std::end(CAPTURE_RATES), g_capture_rate) - std::begin(CAPTURE_RATES));
+    if (ImGui::Combo("Capture Rate", &capture_rate_index, CAPTURE_RATE_NAMES))
+    {
+        g_capture_rate = CAPTURE_RATES[capture_rate_index];
+        reshade::set_config_value(nullptr, INI_SECTION, INI_CAPTURE_RATE, g_capture_rate);
+        g_capture_scheduler.configure(g_capture_rate, g_capture_adaptive);
+    }
+    if (ImGui::Checkbox("Capture less often while LiveSplit is idle", &g_capture_adaptive))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_CAPTURE_ADAPTIVE, g_capture_adaptive);
+        g_capture_scheduler.configure(g_capture_rate, g_capture_adaptive);
+    }
+    if (ImGui::Checkbox("Capture just before drawing", &g_capture_late))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_CAPTURE_LATE, g_capture_late);
+    }
+    int frame_source = g_frame_source.load(std::memory_order_relaxed);
+    if (ImGui::Combo("Frame Source", &frame_source, FRAME_SOURCE_NAMES))
+    {
+        g_frame_source.store(frame_source, std::memory_order_relaxed);
+        reshade::set_config_value(nullptr, INI_SECTION, INI_FRAME_SOURCE, frame_source);
+    }
+    draw_region_settings();
+    draw_source_settings();
+    if (ImGui::SliderFloat("Scale", &g_scale, 0.25f, 4, "%.2f", ImGuiSliderFlags_AlwaysClamp))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_SCALE, g_scale);
+        g_shared_scale.store(g_scale, std::memory_order_relaxed);
+    }
+    if (ImGui::Combo("Scaling", &g_scale_filter, SCALE_FILTER_NAMES))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_SCALE_FILTER, g_scale_filter);
+        g_shared_scale_filter.store(g_scale_filter, std::memory_order_relaxed);
+    }
+    if (ImGui::Combo("Vulkan Texture Upload", &g_texture_upload, TEXTURE_UPLOAD_NAMES))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_TEXTURE_UPLOAD, g_texture_upload);
+        const std::lock_guard<std::mutex> lock(g_render_mutex);
+        choose_upload_path();
+    }
+    if (ImGui::Checkbox("Transparent background", &g_key_background))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_KEY_BACKGROUND, g_key_background);
+        update_key_params();
+    }
+    if (ImGui::ColorEdit3("Background Color", g_key_color))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_KEY_COLOR, get_key_color_rgb());
+        update_key_params();
+    }
+    if (ImGui::SliderInt("Background Tolerance", &g_key_tolerance, 0, 255, "%d", ImGuiSliderFlags_AlwaysClamp))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_KEY_TOLERANCE, g_key_tolerance);
+        update_key_params();
+    }
+    if (ImGui::SliderFloat("Opacity", &g_opacity, 0, 1, "%.2f", ImGuiSliderFlags_AlwaysClamp))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_OPACITY, g_opacity);
+        update_key_params();
+    }
+    if (ImGui::Checkbox("Show statistics", &g_show_statistics))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_SHOW_STATISTICS, g_show_statistics);
+    }
+    if (ImGui::Checkbox("Write statistics to CSV", &g_statistics_csv))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_STATISTICS_CSV, g_statistics_csv);
+        g_statistics_error = nullptr;
+    }
+    if (ImGui::Checkbox("Record overlay to file", &g_record))
+    {
+        reshade::set_config_value(nullptr, INI_SECTION, INI_RECORD, g_record);
+        const std::lock_guard<std::mutex> lock(g_render_mutex);
+        g_recording_failed = false;
+        g_recording_error = nullptr;
+    }
 }
 
-/// <summary>Lets worker thread wake up and fetch the next copy of LiveSplit after a rendered frame.</summary>
-static void on_reshade_present(_In_ effect_runtime*)
+/// <summary>
+/// Lets worker thread wake up and fetch the next copy of LiveSplit after a rendered frame, if one is due. A capture
+/// that is still running when the next one becomes due simply delays it, so a stalled LiveSplit never blocks the game.
+/// Passes are only started under g_render_mutex, so that whoever holds it can wait for the worker thread to go idle.
+/// </summary>
+static void on_reshade_present(_In_ effect_runtime* runtime)
 {
-    SetEvent(g_event_worker_go);
+    const std::lock_guard<std::mutex> lock(g_render_mutex);
+    // Retired textures and upload rings are counted down on every present, so that they are released even while
+    // LiveSplit is hidden.
+    device_cache* const cache = find_device_cache(runtime->get_device());
+    if (cache != nullptr)
+    {
+        cache->draw_count++;
+        if (cache->api_device == g_ring_device)
+            g_ring_draw_count.fetch_add(1, std::memory_order_release);
+        release_retired_textures(*cache, false);
+        release_retired_rings(*cache, false);
+    }
+
+    update_worker_lifecycle();
+    if (!g_worker_lifecycle.wakes_worker() || g_thread == NULL || g_worker_busy.load(std::memory_order_acquire))
+        return;
+
+    const uint64_t now = get_time_us();
+    if (g_capture_pending)
+    {
+        g_capture_pending = false;
+        g_capture_scheduler.on_capture_finished(now, g_capture_changed.load(std::memory_order_relaxed));
+        const uint64_t duration = g_capture_duration_us.load(std::memory_order_relaxed);
+        if (duration != 0)
+            g_capture_phase.on_capture(duration, g_capture_missed.load(std::memory_order_relaxed));
+    }
+    if (g_capture_scheduler.is_due(now))
+    {
+        g_capture_scheduler.on_capture_started(now);
+        g_capture_start_us.store(g_capture_late ? now + g_capture_phase.start_delay_us(now) : 0, std::memory_order_relaxed);
+        g_capture_pending = true;
+        g_worker_busy.store(true, std::memory_order_relaxed);
+        ResetEvent(g_event_worker_idle);
+        SetEvent(g_event_worker_go);
+    }
 }
 
-/// <summary>Reacts to effect runtime creation and checks if the LiveSplit overlay is enabled in the addon settings.</summary>
-/// <param name="effect_runtime">The newly initialized ReShade effect runtime.</param>
+/// <summary>
+/// Reacts to swapchain creation by setting up the device's texture cache, if it is the device's first swapchain. The
+/// settings are read when the first swapchain of all appears.
+/// </summary>
+/// <param name="swapchain">The newly initialized swapchain.</param>
 static void on_init_swapchain(_In_ swapchain* swapchain)
 {
-    // Only react to the first device.
-    if (g_device == nullptr)
+    const std::lock_guard<std::mutex> lock(g_render_mutex);
+    if (g_device_caches.empty())
     {
-        g_device = swapchain->get_device();
         reshade::get_config_value(nullptr, INI_SECTION, INI_SHOW, g_show_livesplit);
         reshade::get_config_value(nullptr, INI_SECTION, INI_ALIGNMENT_X, g_livesplit_alignment[0]);
         reshade::get_config_value(nullptr, INI_SECTION, INI_ALIGNMENT_Y, g_livesplit_alignment[1]);
         reshade::get_config_value(nullptr, INI_SECTION, INI_OFFSET_X, g_livesplit_offsets[0]);
         reshade::get_config_value(nullptr, INI_SECTION, INI_OFFSET_Y, g_livesplit_offsets[1]);
-        update_livesplit_visibility(g_show_livesplit);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_CAPTURE_RATE, g_capture_rate);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_CAPTURE_ADAPTIVE, g_capture_adaptive);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_CAPTURE_LATE, g_capture_late);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_SHOW_STATISTICS, g_show_statistics);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_STATISTICS_CSV, g_statistics_csv);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_RECORD, g_record);
+        if (std::find(std::begin(CAPTURE_RATES), std::end(CAPTURE_RATES), g_capture_rate) == std::end(CAPTURE_RATES))
+            g_capture_rate = capture_scheduler::RATE_EVERY_FRAME;
+        int frame_source = FRAME_SOURCE_LIVESPLIT;
+        reshade::get_config_value(nullptr, INI_SECTION, INI_FRAME_SOURCE, frame_source);
+        if (frame_source < FRAME_SOURCE_LIVESPLIT || frame_source > FRAME_SOURCE_SHARED_MEMORY)
+            frame_source = FRAME_SOURCE_LIVESPLIT;
+        g_frame_source.store(frame_source, std::memory_order_relaxed);
+        int key_color = get_key_color_rgb();
+        reshade::get_config_value(nullptr, INI_SECTION, INI_KEY_BACKGROUND, g_key_background);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_KEY_COLOR, key_color);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_KEY_TOLERANCE, g_key_tolerance);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_OPACITY, g_opacity);
+        g_key_color[0] = ((key_color >> 16) & 0xff) / 255.0f;
+        g_key_color[1] = ((key_color >> 8) & 0xff) / 255.0f;
+        g_key_color[2] = (key_color & 0xff) / 255.0f;
+        g_key_tolerance = std::clamp(g_key_tolerance, 0, 255);
+        g_opacity = std::clamp(g_opacity, 0.0f, 1.0f);
+        update_key_params();
+        reshade::get_config_value(nullptr, INI_SECTION, INI_SCALE, g_scale);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_SCALE_FILTER, g_scale_filter);
+        g_scale = std::clamp(g_scale, 0.25f, 4.0f);
+        if (g_scale_filter < image_scaler::FILTER_BOX || g_scale_filter > SCALE_FILTER_GPU)
+            g_scale_filter = image_scaler::FILTER_BOX;
+        g_shared_scale.store(g_scale, std::memory_order_relaxed);
+        g_shared_scale_filter.store(g_scale_filter, std::memory_order_relaxed);
+        reshade::get_config_value(nullptr, INI_SECTION, INI_TEXTURE_UPLOAD, g_texture_upload);
+        if (g_texture_upload < TEXTURE_UPLOAD_STAGING || g_texture_upload > TEXTURE_UPLOAD_MAPPED)
+            g_texture_upload = TEXTURE_UPLOAD_STAGING;
+        load_regions();
+        load_sources();
+        update_shared_layout();
+        g_capture_scheduler.configure(g_capture_rate, g_capture_adaptive);
+    }
+
+    device* const device = swapchain->get_device();
+    device_cache* cache = find_device_cache(device);
+    if (cache == nullptr)
+    {
+        g_device_caches.push_back(std::make_unique<device_cache>(device));
+        cache = g_device_caches.back().get();
     }
+    cache->swapchain_count++;
+    update_livesplit_visibility(g_show_livesplit);
+    choose_upload_path();
 }
 
-/// <summary>Reacts to effect runtime desctruction and tears down the LiveSplit overlay.</summary>
-/// <param name="effect_runtime">The effect_runtime being destroyed.</param>
+/// <summary>
+/// Reacts to swapchain destruction. The device's texture cache and the worker thread stay, so that a swapchain that
+/// is recreated right away finds everything warm.
+/// </summary>
+/// <param name="swapchain">The swapchain being destroyed.</param>
 static void on_destroy_swapchain(_In_ swapchain* swapchain)
 {
-    // Only react to the device we initially picked up.
-    if (g_device == swapchain->get_device())
-    {
-        update_livesplit_visibility(false);
-        g_device = nullptr;
-    }
+    const std::lock_guard<std::mutex> lock(g_render_mutex);
+    device* const device = swapchain->get_device();
+    device_cache* const cache = find_device_cache(device);
+    if (cache != nullptr && cache->swapchain_count != 0)
+        cache->swapchain_count--;
+}
+
+/// <summary>
+/// Reacts to device destruction by destroying its texture cache and its upload rings. The worker thread is
+/// stopped when the last device that showed LiveSplit goes away.
+/// </summary>
+/// <param name="device">The device being destroyed.</param>
+static void on_destroy_device(_In_ device* device)
+{
+    const std::lock_guard<std::mutex> lock(g_render_mutex);
+    const auto it = std::find_if(g_device_caches.begin(), g_device_caches.end(), [device](const std::unique_ptr<device_cache>& cache) { return cache->api_device == device; });
+    if (it == g_device_caches.end())
+        return;
+
+    destroy_upload_rings(**it);
+    destroy_texture(**it);
+    release_retired_textures(**it, true);
+    if ((*it)->upload_fence.handle != 0)
+        device->destroy_fence((*it)->upload_fence);
+    g_device_caches.erase(it);
+    update_livesplit_visibility(g_show_livesplit);
+    choose_upload_path();
 }
 
 /// <summary>Win32 DLL entry point. Registers this addon with ReShade.</summary>
@@ -423,17 +2690,22 @@ BOOL WINAPI DllMain(_In_ HINSTANCE hinstDLL, _In_ DWORD fdwReason, _In_ LPVOID)
     case DLL_PROCESS_ATTACH:
         if (!reshade::register_addon(hinstDLL))
             return FALSE;
+        g_module_handle = hinstDLL;
+        g_event_recorder_wake = CreateEvent(NULL, FALSE, FALSE, NULL);
         reshade::register_overlay(nullptr, &draw_settings_overlay);
         reshade::register_event<reshade::addon_event::reshade_present>(&on_reshade_present);
         reshade::register_event<reshade::addon_event::init_swapchain>(&on_init_swapchain);
         reshade::register_event<reshade::addon_event::destroy_swapchain>(&on_destroy_swapchain);
+        reshade::register_event<reshade::addon_event::destroy_device>(&on_destroy_device);
         break;
     case DLL_PROCESS_DETACH:
+        reshade::unregister_event<reshade::addon_event::destroy_device>(&on_destroy_device);
         reshade::unregister_event<reshade::addon_event::destroy_swapchain>(&on_destroy_swapchain);
         reshade::unregister_event<reshade::addon_event::init_swapchain>(&on_init_swapchain);
         reshade::unregister_event<reshade::addon_event::reshade_present>(&on_reshade_present);
         reshade::unregister_overlay(nullptr, &draw_settings_overlay);
         reshade::unregister_addon(hinstDLL);
+        CloseHandle(g_event_recorder_wake);
         break;
     }
     return TRUE;
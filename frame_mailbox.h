@@ -0,0 +1,78 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// A lock-free triple buffer that hands frames from exactly one producer thread to exactly one consumer thread.
+/// The producer fills back() and publishes it, the consumer takes the newest published frame and reads it through
+/// front(). Neither side ever waits for the other: the producer always has a slot to write to and the consumer keeps
+/// its current frame until a newer one arrives. Frames published in between two takes are dropped.
+/// </summary>
+/// <typeparam name="T">The frame type. Slots are reused, so allocations made by a frame can be recycled.</typeparam>
+template <typename T>
+class frame_mailbox
+{
+public:
+    static constexpr size_t SLOT_COUNT = 3;
+
+    /// <summary>The slot the producer writes the next frame into.</summary>
+    T& back()
+    {
+        return _slots[_back];
+    }
+
+    /// <summary>Makes the back slot available to the consumer and swaps in a slot to write the next frame into.</summary>
+    void publish()
+    {
+        const uint8_t previous = _middle.exchange(uint8_t(_back | FRESH), std::memory_order_acq_rel);
+        _back = previous & INDEX_MASK;
+    }
+
+    /// <summary>Moves the newest published frame to the front, if one was published since the last take.</summary>
+    /// <returns>true if front() now refers to a new frame.</returns>
+    bool take()
+    {
+        if ((_middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            return false;
+        const uint8_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /// <summary>The frame the consumer reads from. It stays valid and unchanged until the next successful take().</summary>
+    T& front()
+    {
+        return _slots[_front];
+    }
+
+    /// <summary>
+    /// Index of the back slot. Slots never move, so resources that are kept per slot can be looked up with this and
+    /// are owned by the producer just like the slot itself.
+    /// </summary>
+    size_t back_index() const
+    {
+        return _back;
+    }
+
+    /// <summary>Index of the front slot, which is owned by the consumer.</summary>
+    size_t front_index() const
+    {
+        return _front;
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    T _slots[SLOT_COUNT];
+    // The back index is only touched by the producer and the front index only by the consumer. The middle index
+    // carries the FRESH flag when it holds a frame the consumer hasn't taken yet.
+    uint8_t _back = 0;
+    uint8_t _front = 1;
+    std::atomic<uint8_t> _middle { 2 };
+};
+
+#endif //FRAME_MAILBOX_H
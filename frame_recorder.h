@@ -0,0 +1,177 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "frame_recording.h"
+
+/// <summary>
+/// Queues the frames the worker thread publishes and the frames the render thread presents, for a writer thread to
+/// encode and write as a recording (see frame_recording.h). Each queue has exactly one producer and the writer as
+/// its consumer, and neither side ever waits for the other: when a queue is full, the producer drops the entry and
+/// counts it. The few frame slots only last if the writer drains them as soon as they fill up, so the worker thread
+/// wakes it once queued_frames() reaches half of them. Presents go into a fixed array, so the render thread never allocates. The buffers of the frame slots
+/// only grow on the worker thread while images grow. The queues outlive single recordings, so a new recording can
+/// start while a producer is still in the middle of a push for the previous one.
+/// </summary>
+class frame_recorder
+{
+public:
+    static constexpr uint32_t FRAME_SLOTS = 4;
+    static constexpr uint32_t PRESENT_SLOTS = 1024;
+
+    /// <summary>Queues a copy of a frame, unless all slots are still waiting to be written. Called by the worker thread.</summary>
+    /// <param name="pixels">The top-left pixel of the image as top-down BGRX rows.</param>
+    /// <param name="row_pitch">Distance between two rows of the image in bytes.</param>
+    /// <returns>false if the frame was dropped.</returns>
+    bool push_frame(uint64_t generation, uint64_t captured_us, const uint8_t* pixels, size_t row_pitch, uint32_t width, uint32_t height)
+    {
+        const uint64_t head = _frame_head.load(std::memory_order_relaxed);
+        if (head - _frame_tail.load(std::memory_order_acquire) >= FRAME_SLOTS)
+        {
+            _dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        frame_slot& slot = _frames[head % FRAME_SLOTS];
+        const size_t row_size = size_t(width) * 4;
+        if (slot.pixels.size() < row_size * height)
+            slot.pixels.resize(row_size * height);
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(slot.pixels.data() + y * row_size, pixels + y * row_pitch, row_size);
+        slot.generation = generation;
+        slot.captured_us = captured_us;
+        slot.width = width;
+        slot.height = height;
+        _frame_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// <summary>Queues which frame was shown in a presented game frame. Called by the render thread.</summary>
+    /// <param name="present_us">When the overlay was drawn.</param>
+    /// <param name="generation">The generation of the frame that was shown, or 0 if nothing was shown.</param>
+    /// <returns>false if the present was dropped.</returns>
+    bool push_present(uint64_t present_us, uint64_t generation)
+    {
+        const uint64_t head = _present_head.load(std::memory_order_relaxed);
+        if (head - _present_tail.load(std::memory_order_acquire) >= PRESENT_SLOTS)
+        {
+            _dropped_presents.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _presents[head % PRESENT_SLOTS] = { present_us, generation };
+        _present_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// <summary>Starts a recording by writing the file header. Called by the writer thread.</summary>
+    bool begin(FILE* file)
+    {
+        _encoder.reset();
+        _base_dropped_frames = _dropped_frames.load(std::memory_order_relaxed);
+        _base_dropped_presents = _dropped_presents.load(std::memory_order_relaxed);
+        _written_drops = { 0, 0 };
+        _bytes_written.store(0, std::memory_order_relaxed);
+        const recording_format::file_header header = { recording_format::MAGIC, recording_format::VERSION };
+        return write(file, &header, sizeof(header));
+    }
+
+    /// <summary>Encodes and writes everything queued so far. Called by the writer thread.</summary>
+    /// <returns>false if writing failed.</returns>
+    bool drain(FILE* file)
+    {
+        // Frames go first, since the presents that show them can only have been queued after them.
+        const uint64_t frame_head = _frame_head.load(std::memory_order_acquire);
+        for (uint64_t tail = _frame_tail.load(std::memory_order_relaxed); tail != frame_head; tail++)
+        {
+            const frame_slot& slot = _frames[tail % FRAME_SLOTS];
+            _buffer.clear();
+            _encoder.encode(slot.pixels.data(), size_t(slot.width) * 4, slot.width, slot.height, slot.generation, slot.captured_us, _buffer);
+            _frame_tail.store(tail + 1, std::memory_order_release);
+            if (!write(file, _buffer.data(), _buffer.size()))
+                return false;
+        }
+
+        _buffer.clear();
+        const uint64_t present_head = _present_head.load(std::memory_order_acquire);
+        for (uint64_t tail = _present_tail.load(std::memory_order_relaxed); tail != present_head; tail++)
+        {
+            frame_delta_encoder::append(_buffer, recording_format::record_header { recording_format::RECORD_PRESENT, sizeof(recording_format::present_record) });
+            frame_delta_encoder::append(_buffer, _presents[tail % PRESENT_SLOTS]);
+        }
+        _present_tail.store(present_head, std::memory_order_release);
+
+        const recording_format::drops_record drops = {
+            _dropped_frames.load(std::memory_order_relaxed) - _base_dropped_frames,
+            _dropped_presents.load(std::memory_order_relaxed) - _base_dropped_presents
+        };
+        if (drops.frames != _written_drops.frames || drops.presents != _written_drops.presents)
+        {
+            frame_delta_encoder::append(_buffer, recording_format::record_header { recording_format::RECORD_DROPS, sizeof(drops) });
+            frame_delta_encoder::append(_buffer, drops);
+            _written_drops = drops;
+        }
+        return write(file, _buffer.data(), _buffer.size());
+    }
+
+    /// <summary>Number of frames waiting to be written. Called by the worker thread to decide when to wake the writer.</summary>
+    uint32_t queued_frames() const
+    {
+        return uint32_t(_frame_head.load(std::memory_order_relaxed) - _frame_tail.load(std::memory_order_acquire));
+    }
+
+    /// <summary>Frames dropped since the recorder was created.</summary>
+    uint64_t dropped_frames() const
+    {
+        return _dropped_frames.load(std::memory_order_relaxed);
+    }
+
+    /// <summary>Presents dropped since the recorder was created.</summary>
+    uint64_t dropped_presents() const
+    {
+        return _dropped_presents.load(std::memory_order_relaxed);
+    }
+
+    /// <summary>Bytes written since the current recording began.</summary>
+    uint64_t bytes_written() const
+    {
+        return _bytes_written.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct frame_slot
+    {
+        std::vector<uint8_t> pixels;
+        uint64_t generation = 0;
+        uint64_t captured_us = 0;
+        uint32_t width = 0, height = 0;
+    };
+
+    bool write(FILE* file, const void* data, size_t size)
+    {
+        _bytes_written.fetch_add(size, std::memory_order_relaxed);
+        return size == 0 || fwrite(data, size, 1, file) == 1;
+    }
+
+    frame_slot _frames[FRAME_SLOTS];
+    alignas(64) std::atomic<uint64_t> _frame_head = 0;
+    alignas(64) std::atomic<uint64_t> _frame_tail = 0;
+    recording_format::present_record _presents[PRESENT_SLOTS] = {};
+    alignas(64) std::atomic<uint64_t> _present_head = 0;
+    alignas(64) std::atomic<uint64_t> _present_tail = 0;
+    std::atomic<uint64_t> _dropped_frames = 0;
+    std::atomic<uint64_t> _dropped_presents = 0;
+    std::atomic<uint64_t> _bytes_written = 0;
+
+    // Only used by the writer thread.
+    frame_delta_encoder _encoder;
+    std::vector<uint8_t> _buffer;
+    uint64_t _base_dropped_frames = 0;
+    uint64_t _base_dropped_presents = 0;
+    recording_format::drops_record _written_drops = {};
+};
+
+#endif //FRAME_RECORDER_H
@@ -0,0 +1,378 @@
+#ifndef FRAME_RECORDING_H
+#define FRAME_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/// <summary>
+/// The file format of overlay recordings. A recording is a stream of records after a short file header, so it can
+/// be read up to the last complete record even if the game crashed while it was written. All numbers are stored in
+/// little-endian order.
+///
+/// file:     file_header, then records until the end of the file
+/// record:   record_header, then record_header::size bytes of payload
+/// FRAME:    frame_header, a bit per row (LSB first) that tells whether the row changed, then the changed rows
+/// PRESENT:  present_record, once per game frame
+/// DROPS:    drops_record, whenever frames or presents were dropped because the writer fell behind
+///
+/// A changed row is stored as the XOR of its BGRX pixels with the same row of the previous frame, run-length
+/// encoded. A keyframe is stored against an all-zero image, so that reading can start over at any keyframe. The
+/// run-length code is a sequence of 16-bit tokens, each followed by pixels: with the top bit set, the next pixel
+/// repeats (token &amp; 0x7fff) + 1 times, otherwise (token + 1) literal pixels follow. A row's tokens cover
+/// exactly its width.
+/// </summary>
+struct recording_format
+{
+    static constexpr uint32_t MAGIC = 0x4352534c; // "LSRC"
+    static constexpr uint32_t VERSION = 1;
+    /// <summary>Images larger than this in either direction are rejected when reading.</summary>
+    static constexpr uint32_t MAX_DIMENSION = 16384;
+    /// <summary>Records larger than this end the stream when reading, since the file must be damaged.</summary>
+    static constexpr uint32_t MAX_RECORD_SIZE = 1u << 30;
+
+    enum record_type : uint32_t
+    {
+        RECORD_FRAME = 1,
+        RECORD_PRESENT = 2,
+        RECORD_DROPS = 3
+    };
+
+    static constexpr uint32_t FLAG_KEYFRAME = 1;
+
+    struct file_header
+    {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct record_header
+    {
+        uint32_t type;
+        uint32_t size;
+    };
+
+    struct frame_header
+    {
+        /// <summary>The generation of the frame on the worker thread.</summary>
+        uint64_t generation;
+        /// <summary>When the worker thread started to capture the frame, in microseconds.</summary>
+        uint64_t captured_us;
+        uint32_t width, height;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    struct present_record
+    {
+        /// <summary>When the overlay was drawn into the presented game frame, in microseconds.</summary>
+        uint64_t present_us;
+        /// <summary>The generation of the frame that was shown, or 0 if nothing was shown.</summary>
+        uint64_t generation;
+    };
+
+    struct drops_record
+    {
+        /// <summary>Frames dropped since the recording started.</summary>
+        uint64_t frames;
+        /// <summary>Presents dropped since the recording started.</summary>
+        uint64_t presents;
+    };
+
+    static_assert(sizeof(file_header) == 8 && sizeof(record_header) == 8 && sizeof(frame_header) == 32
+        && sizeof(present_record) == 16 && sizeof(drops_record) == 16, "Records must not contain padding.");
+};
+
+/// <summary>
+/// Turns frames into FRAME records: a keyframe for the first frame, after every KEYFRAME_INTERVAL frames and
+/// whenever the size changes, and only the rows that changed in between. It keeps a copy of the last frame it
+/// encoded, so frames that were dropped before reaching it don't break the chain.
+/// </summary>
+class frame_delta_encoder
+{
+public:
+    static constexpr uint32_t KEYFRAME_INTERVAL = 120;
+
+    /// <summary>Makes the next frame a keyframe, for example at the start of a new file.</summary>
+    void reset()
+    {
+        _since_keyframe = KEYFRAME_INTERVAL;
+    }
+
+    /// <summary>Appends a FRAME record for the given image.</summary>
+    /// <param name="pixels">The top-left pixel of the image as top-down BGRX rows.</param>
+    /// <param name="row_pitch">Distance between two rows of the image in bytes.</param>
+    /// <param name="out">Receives the record.</param>
+    void encode(const uint8_t* pixels, size_t row_pitch, uint32_t width, uint32_t height, uint64_t generation, uint64_t captured_us, std::vector<uint8_t>& out)
+    {
+        const bool keyframe = _since_keyframe >= KEYFRAME_INTERVAL || width != _width || height != _height;
+        _since_keyframe = keyframe ? 1 : _since_keyframe + 1;
+        if (keyframe)
+        {
+            _width = width;
+            _height = height;
+            _previous.assign(size_t(width) * height, 0);
+        }
+
+        const size_t record_start = out.size();
+        const recording_format::frame_header header = { generation, captured_us, width, height, keyframe ? recording_format::FLAG_KEYFRAME : 0, 0 };
+        append(out, recording_format::record_header { recording_format::RECORD_FRAME, 0 });
+        append(out, header);
+        const size_t bitmap_start = out.size();
+        out.resize(bitmap_start + (height + 7) / 8, 0);
+
+        _row.resize(width);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint32_t* const previous = _previous.data() + size_t(y) * width;
+            const uint8_t* const row = pixels + y * row_pitch;
+            if (!keyframe && memcmp(previous, row, size_t(width) * 4) == 0)
+                continue;
+            out[bitmap_start + y / 8] |= uint8_t(1 << (y % 8));
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t pixel;
+                memcpy(&pixel, row + size_t(x) * 4, 4);
+                _row[x] = pixel ^ previous[x];
+                previous[x] = pixel;
+            }
+            encode_row(_row.data(), width, out);
+        }
+
+        const uint32_t size = uint32_t(out.size() - record_start - sizeof(recording_format::record_header));
+        memcpy(out.data() + record_start + offsetof(recording_format::record_header, size), &size, sizeof(size));
+    }
+
+    template <typename record_type>
+    static void append(std::vector<uint8_t>& out, const record_type& record)
+    {
+        const size_t offset = out.size();
+        out.resize(offset + sizeof(record));
+        memcpy(out.data() + offset, &record, sizeof(record));
+    }
+
+private:
+    static constexpr uint32_t MAX_TOKEN_PIXELS = 0x8000;
+    /// <summary>Runs shorter than this are cheaper to store as literals.</summary>
+    static constexpr uint32_t MIN_RUN = 3;
+
+    static void encode_row(const uint32_t* row, uint32_t width, std::vector<uint8_t>& out)
+    {
+        uint32_t x = 0;
+        uint32_t literal_start = 0;
+        while (x < width)
+        {
+            uint32_t run = 1;
+            while (x + run < width && run < MAX_TOKEN_PIXELS && row[x + run] == row[x])
+                run++;
+            if (run < MIN_RUN && x - literal_start + run < MAX_TOKEN_PIXELS)
+            {
+                x += run;
+                continue;
+            }
+            if (run < MIN_RUN)
+            {
+                // The pending literals are at their limit.
+                write_literals(row + literal_start, x - literal_start, out);
+                literal_start = x;
+                continue;
+            }
+            write_literals(row + literal_start, x - literal_start, out);
+            const uint16_t token = uint16_t(0x8000 | (run - 1));
+            append(out, token);
+            append(out, row[x]);
+            x += run;
+            literal_start = x;
+        }
+        write_literals(row + literal_start, x - literal_start, out);
+    }
+
+    static void write_literals(const uint32_t* pixels, uint32_t count, std::vector<uint8_t>& out)
+    {
+        if (count == 0)
+            return;
+        append(out, uint16_t(count - 1));
+        const size_t offset = out.size();
+        out.resize(offset + size_t(count) * 4);
+        memcpy(out.data() + offset, pixels, size_t(count) * 4);
+    }
+
+    std::vector<uint32_t> _previous;
+    std::vector<uint32_t> _row;
+    uint32_t _width = 0, _height = 0;
+    uint32_t _since_keyframe = KEYFRAME_INTERVAL;
+};
+
+/// <summary>
+/// Reads a recording record by record and keeps the image that the FRAME records so far add up to. Everything read
+/// from the file is checked, so a damaged or truncated recording ends the stream or skips frames, but is never
+/// trusted with sizes. Delta frames that don't apply to the current image, because their keyframe was damaged, are
+/// skipped until the next keyframe.
+/// </summary>
+class recording_reader
+{
+public:
+    explicit recording_reader(FILE* file) : _file(file)
+    {
+    }
+
+    /// <summary>Checks the file header. Must be called before next().</summary>
+    bool read_header()
+    {
+        recording_format::file_header header;
+        return fread(&header, sizeof(header), 1, _file) == 1 && header.magic == recording_format::MAGIC && header.version == recording_format::VERSION;
+    }
+
+    /// <summary>Reads the next record.</summary>
+    /// <param name="type">Receives the type of the record. The record itself is available from the accessor of the same name.</param>
+    /// <returns>false at the end of the file, including a truncated last record.</returns>
+    bool next(recording_format::record_type& type)
+    {
+        while (true)
+        {
+            recording_format::record_header header;
+            if (fread(&header, sizeof(header), 1, _file) != 1 || header.size > recording_format::MAX_RECORD_SIZE)
+                return false;
+            _payload.resize(header.size);
+            if (header.size != 0 && fread(_payload.data(), header.size, 1, _file) != 1)
+                return false;
+
+            type = recording_format::record_type(header.type);
+            switch (type)
+            {
+            case recording_format::RECORD_FRAME:
+                _frame_valid = decode_frame();
+                return true;
+            case recording_format::RECORD_PRESENT:
+                if (!read_payload(_present))
+                    return false;
+                return true;
+            case recording_format::RECORD_DROPS:
+                if (!read_payload(_drops))
+                    return false;
+                return true;
+            default:
+                // Unknown records are skipped, so that later versions can add some.
+                continue;
+            }
+        }
+    }
+
+    /// <summary>The header of the last FRAME record, as far as it could be read.</summary>
+    const recording_format::frame_header& frame() const
+    {
+        return _frame;
+    }
+
+    /// <summary>Whether the last FRAME record could be applied, so that image() shows it.</summary>
+    bool frame_valid() const
+    {
+        return _frame_valid;
+    }
+
+    const recording_format::present_record& present() const
+    {
+        return _present;
+    }
+
+    const recording_format::drops_record& drops() const
+    {
+        return _drops;
+    }
+
+    /// <summary>The current image as top-down BGRX pixels without padding, frame().width by frame().height.</summary>
+    const std::vector<uint32_t>& image() const
+    {
+        return _image;
+    }
+
+private:
+    template <typename record_type>
+    bool read_payload(record_type& record) const
+    {
+        if (_payload.size() < sizeof(record))
+            return false;
+        memcpy(&record, _payload.data(), sizeof(record));
+        return true;
+    }
+
+    bool decode_frame()
+    {
+        recording_format::frame_header header;
+        if (!read_payload(header) || header.width > recording_format::MAX_DIMENSION || header.height > recording_format::MAX_DIMENSION)
+            return false;
+        _frame = header;
+        const bool keyframe = (header.flags & recording_format::FLAG_KEYFRAME) != 0;
+        if (!keyframe && (!_have_image || header.width != _image_width || header.height != _image_height))
+            return false;
+
+        const uint32_t width = header.width, height = header.height;
+        const size_t bitmap_size = (height + 7) / 8;
+        size_t offset = sizeof(header) + bitmap_size;
+        if (offset > _payload.size())
+            return false;
+        if (keyframe)
+        {
+            _image.assign(size_t(width) * height, 0);
+            _image_width = width;
+            _image_height = height;
+        }
+        // A frame that fails halfway leaves a mix of two frames, so nothing applies until the next keyframe.
+        _have_image = false;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            if ((_payload[sizeof(header) + y / 8] & (1 << (y % 8))) == 0)
+                continue;
+            uint32_t* const row = _image.data() + size_t(y) * width;
+            uint32_t x = 0;
+            while (x < width)
+            {
+                uint16_t token;
+                if (offset + sizeof(token) > _payload.size())
+                    return false;
+                memcpy(&token, _payload.data() + offset, sizeof(token));
+                offset += sizeof(token);
+                const uint32_t count = (token & 0x7fffu) + 1;
+                if (count > width - x)
+                    return false;
+                if (token & 0x8000)
+                {
+                    uint32_t pixel;
+                    if (offset + 4 > _payload.size())
+                        return false;
+                    memcpy(&pixel, _payload.data() + offset, 4);
+                    offset += 4;
+                    for (uint32_t i = 0; i < count; i++)
+                        row[x++] ^= pixel;
+                }
+                else
+                {
+                    if (offset + size_t(count) * 4 > _payload.size())
+                        return false;
+                    for (uint32_t i = 0; i < count; i++, offset += 4)
+                    {
+                        uint32_t pixel;
+                        memcpy(&pixel, _payload.data() + offset, 4);
+                        row[x++] ^= pixel;
+                    }
+                }
+            }
+        }
+        _have_image = true;
+        return true;
+    }
+
+    FILE* const _file;
+    std::vector<uint8_t> _payload;
+    recording_format::frame_header _frame = {};
+    recording_format::present_record _present = {};
+    recording_format::drops_record _drops = {};
+    bool _frame_valid = false;
+    bool _have_image = false;
+    std::vector<uint32_t> _image;
+    uint32_t _image_width = 0, _image_height = 0;
+};
+
+#endif //FRAME_RECORDING_H
@@ -0,0 +1,330 @@
+#ifndef FRAME_UPLOAD_H
+#define FRAME_UPLOAD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <reshade_api_device.hpp>
+#include "background_key.h"
+#include "staging_ring.h"
+#include "tile_diff.h"
+
+/// <summary>
+/// Staging buffer rows and the left edges of the rectangles copied from them are aligned to this many pixels, which
+/// satisfies D3D12's alignment of 256 bytes for row pitches and 512 bytes for buffer offsets.
+/// </summary>
+constexpr uint32_t STAGING_ALIGNMENT_PIXELS = 128;
+
+/// <summary>The image of a frame, as far as uploading it to a texture is concerned.</summary>
+struct frame_image
+{
+    /// <summary>Incremented for every published frame, so the render thread can tell whether it missed one.</summary>
+    uint64_t generation = 0;
+    /// <summary>Size of the image in pixels, or 0 if there is nothing to show.</summary>
+    uint32_t width = 0, height = 0;
+    /// <summary>The image as top-down BGRX rows.</summary>
+    uint8_t* data = nullptr;
+    /// <summary>Distance between two rows of the image in bytes.</summary>
+    size_t row_pitch = 0;
+    /// <summary>The parts of the image that changed since the previous generation.</summary>
+    std::vector<dirty_rect> dirty_rects;
+    /// <summary>How the alpha channel is produced when the image is copied to a texture.</summary>
+    key_params keying = {};
+};
+
+/// <summary>
+/// A texture that the render thread uploads LiveSplit frames to, and the view on it. A texture that only the GPU can
+/// access comes with persistently mapped staging buffers of the same size, which it is copied to from.
+/// </summary>
+struct livesplit_texture
+{
+    reshade::api::resource texture;
+    reshade::api::resource_view view;
+    reshade::api::resource staging_buffers[staging_ring::BUFFER_COUNT];
+    uint8_t* staging_data[staging_ring::BUFFER_COUNT];
+    /// <summary>Pixels between two rows in the staging buffers, or 0 without them.</summary>
+    uint32_t staging_row_length;
+    staging_ring staging;
+    /// <summary>The draw of its device after which a replaced texture is no longer sampled from.</summary>
+    uint64_t retire_draw;
+};
+
+/// <summary>Where a part of a texture goes on screen, in pixels, and the texture coordinates of its corners.</summary>
+struct draw_quad
+{
+    float left, top, right, bottom;
+    float u1, v1, u3, v3;
+};
+
+/// <summary>
+/// The way from a frame to the screen that the render thread of every device takes: creating the textures, keying
+/// frames into them, either through a mapped texture or through staging buffers and copies on the GPU, and placing
+/// the quads they are drawn with. Everything goes through ReShade's device and command queue, so the same code runs
+/// against a stand-in device outside of a game. Failures are returned as messages for the OSD.
+/// </summary>
+class frame_upload
+{
+public:
+    static constexpr reshade::api::format TEXTURE_FORMAT = reshade::api::format::b8g8r8a8_unorm;
+
+    /// <summary>Copies rows of a frame into a mapped region of a texture or buffer, keying the background on the way.</summary>
+    /// <param name="buffer_info">The mapped region.</param>
+    /// <param name="frame">The frame to copy from.</param>
+    /// <param name="rect">The part of the frame that was mapped.</param>
+    /// <returns>The number of bytes copied.</returns>
+    static size_t copy_rows(const reshade::api::subresource_data& buffer_info, const frame_image& frame, const dirty_rect& rect)
+    {
+        const size_t src_pitch = frame.row_pitch;
+        const size_t row_size = size_t(rect.right - rect.left) * 4;
+        const uint8_t* src = frame.data + rect.top * src_pitch + rect.left * 4;
+        uint8_t* dst = (uint8_t*)buffer_info.data;
+        if (frame.keying.enabled())
+        {
+            background_key::apply(dst, buffer_info.row_pitch, src, src_pitch, rect.right - rect.left, rect.bottom - rect.top, frame.keying);
+            return row_size * (rect.bottom - rect.top);
+        }
+        for (uint32_t y = rect.top; y != rect.bottom; y++)
+        {
+            memcpy(dst, src, row_size);
+            src += src_pitch;
+            dst += buffer_info.row_pitch;
+        }
+        return row_size * (rect.bottom - rect.top);
+    }
+
+    /// <summary>Creates a texture that frames can be written to from the host, and a view on it.</summary>
+    /// <param name="device">The device to create the texture on.</param>
+    /// <param name="texture">Receives the texture.</param>
+    /// <param name="texture_view">Receives the view on the texture.</param>
+    /// <returns>nullptr on success. On failure a message, and nothing needs to be destroyed.</returns>
+    static const char* create_mapped_texture(reshade::api::device* device, uint32_t width, uint32_t height,
+        reshade::api::resource& texture, reshade::api::resource_view& texture_view)
+    {
+        using namespace reshade::api;
+        // For Vulkan I'm using cpu_only as a hack, since it enables linear tiling, allowing us to upload linear bitmap data.
+        const memory_heap heap = device->get_api() == device_api::vulkan ? memory_heap::cpu_only : memory_heap::cpu_to_gpu;
+        const resource_desc desc(width, height, 1, 1, TEXTURE_FORMAT, 1, heap, resource_usage::shader_resource_pixel, resource_flags::dynamic);
+        texture_view = {};
+        if (!device->create_resource(desc, nullptr, resource_usage::shader_resource_pixel, &texture))
+        {
+            texture = {};
+            return "Failed to create texture.";
+        }
+        if (!device->create_resource_view(texture, resource_usage::shader_resource, resource_view_desc(TEXTURE_FORMAT), &texture_view))
+        {
+            device->destroy_resource(texture);
+            texture = {};
+            texture_view = {};
+            return "Failed to create resource view of texture.";
+        }
+        return nullptr;
+    }
+
+    /// <summary>
+    /// Creates an optimally tiled texture that only the GPU accesses, a view on it and the staging buffers that frames
+    /// are copied to it from. The staging buffers stay mapped for as long as they exist.
+    /// </summary>
+    /// <param name="device">The device to create the texture on.</param>
+    /// <param name="texture">Receives the texture.</param>
+    /// <returns>nullptr on success. On failure a message, and nothing needs to be destroyed.</returns>
+    static const char* create_staged_texture(reshade::api::device* device, uint32_t width, uint32_t height, livesplit_texture& texture)
+    {
+        using namespace reshade::api;
+        texture = {};
+        const resource_desc texture_desc(width, height, 1, 1, TEXTURE_FORMAT, 1, memory_heap::gpu_only, resource_usage::shader_resource | resource_usage::copy_dest);
+        if (!device->create_resource(texture_desc, nullptr, resource_usage::shader_resource_pixel, &texture.texture))
+        {
+            texture = {};
+            return "Failed to create texture.";
+        }
+        if (!device->create_resource_view(texture.texture, resource_usage::shader_resource, resource_view_desc(TEXTURE_FORMAT), &texture.view))
+        {
+            texture.view = {};
+            destroy_texture(device, texture);
+            return "Failed to create resource view of texture.";
+        }
+
+        texture.staging_row_length = (width + STAGING_ALIGNMENT_PIXELS - 1) / STAGING_ALIGNMENT_PIXELS * STAGING_ALIGNMENT_PIXELS;
+        const resource_desc buffer_desc(uint64_t(texture.staging_row_length) * 4 * height, memory_heap::cpu_to_gpu, resource_usage::copy_source);
+        for (size_t i = 0; i < staging_ring::BUFFER_COUNT; i++)
+        {
+            if (!device->create_resource(buffer_desc, nullptr, resource_usage::cpu_access, &texture.staging_buffers[i]))
+            {
+                texture.staging_buffers[i] = {};
+                destroy_texture(device, texture);
+                return "Failed to create staging buffer.";
+            }
+            void* data;
+            if (!device->map_buffer_region(texture.staging_buffers[i], 0, UINT64_MAX, map_access::write_only, &data))
+            {
+                destroy_texture(device, texture);
+                return "Failed to map staging buffer to host memory.";
+            }
+            texture.staging_data[i] = (uint8_t*)data;
+        }
+        return nullptr;
+    }
+
+    /// <summary>Destroys a texture, the view on it and its staging buffers, as far as they exist.</summary>
+    static void destroy_texture(reshade::api::device* device, livesplit_texture& texture)
+    {
+        for (size_t i = 0; i < staging_ring::BUFFER_COUNT; i++)
+        {
+            if (texture.staging_data[i] != nullptr)
+                device->unmap_buffer_region(texture.staging_buffers[i]);
+            if (texture.staging_buffers[i].handle != 0)
+                device->destroy_resource(texture.staging_buffers[i]);
+        }
+        if (texture.view.handle != 0)
+            device->destroy_resource_view(texture.view);
+        if (texture.texture.handle != 0)
+            device->destroy_resource(texture.texture);
+        texture = {};
+    }
+
+    /// <summary>
+    /// Uploads a frame into a mapped texture. The Direct3D APIs only allow dynamic textures to be mapped with
+    /// write_discard, which loses the previous contents, so they always get the whole image. OpenGL and Vulkan keep the
+    /// texture contents and get only the dirty rectangles, as long as the texture holds the frame right before this one.
+    /// </summary>
+    /// <param name="device">The device that owns the texture.</param>
+    /// <param name="texture">The texture to upload to.</param>
+    /// <param name="frame">The frame to upload.</param>
+    /// <param name="uploaded_generation">Generation of the frame the texture holds, or 0.</param>
+    /// <param name="copied_bytes">Counts the bytes copied.</param>
+    /// <returns>true if the texture is up to date.</returns>
+    static bool upload_mapped(reshade::api::device* device, reshade::api::resource texture, const frame_image& frame,
+        uint64_t uploaded_generation, uint64_t& copied_bytes)
+    {
+        using namespace reshade::api;
+        const dirty_rect full = { 0, 0, frame.width, frame.height };
+        subresource_data buffer_info;
+
+        const device_api api = device->get_api();
+        if (frame.generation == uploaded_generation + 1 && (api == device_api::opengl || api == device_api::vulkan))
+        {
+            bool success = true;
+            for (const dirty_rect& rect : frame.dirty_rects)
+            {
+                const subresource_box box = { (int32_t)rect.left, (int32_t)rect.top, 0, (int32_t)rect.right, (int32_t)rect.bottom, 1 };
+                if (!device->map_texture_region(texture, 0, &box, map_access::write_only, &buffer_info))
+                {
+                    success = false;
+                    break;
+                }
+                copied_bytes += copy_rows(buffer_info, frame, rect);
+                device->unmap_texture_region(texture, 0);
+            }
+            if (success)
+                return true;
+        }
+        else if (frame.generation == uploaded_generation + 1 && frame.dirty_rects.empty())
+        {
+            return true;
+        }
+
+        // Fall back to uploading the whole image.
+        if (!device->map_texture_region(texture, 0, nullptr, map_access::write_discard, &buffer_info))
+            return false;
+        copied_bytes += copy_rows(buffer_info, frame, full);
+        device->unmap_texture_region(texture, 0);
+        return true;
+    }
+
+    /// <summary>
+    /// Uploads a frame into a GPU-only texture by writing it into a staging buffer and recording copies from there on
+    /// the command queue. Unlike a dynamic texture that is mapped with write_discard, the texture keeps its contents,
+    /// so only the dirty rectangles are copied while it holds the frame right before this one. The fence signaled after
+    /// the copies tells when the staging buffer may be written to again.
+    /// </summary>
+    /// <param name="queue">The command queue to copy on.</param>
+    /// <param name="texture">The texture to upload to.</param>
+    /// <param name="upload_fence">The fence to signal after the copies.</param>
+    /// <param name="fence_value">The value upload_fence was last signaled with, which is incremented.</param>
+    /// <param name="frame">The frame to upload.</param>
+    /// <param name="uploaded_generation">Generation of the frame the texture holds, or 0.</param>
+    /// <param name="index">The staging buffer to use, which the GPU is done with.</param>
+    /// <param name="copied_bytes">Counts the bytes copied.</param>
+    /// <returns>true if the texture is up to date.</returns>
+    static bool upload_staged(reshade::api::command_queue* queue, livesplit_texture& texture, reshade::api::fence upload_fence,
+        uint64_t& fence_value, const frame_image& frame, uint64_t uploaded_generation, size_t index, uint64_t& copied_bytes)
+    {
+        using namespace reshade::api;
+        const dirty_rect full = { 0, 0, frame.width, frame.height };
+        const bool partial = frame.generation == uploaded_generation + 1;
+        const dirty_rect* const rects = partial ? frame.dirty_rects.data() : &full;
+        const size_t rect_count = partial ? frame.dirty_rects.size() : 1;
+        if (rect_count == 0)
+            return true;
+
+        const uint32_t row_pitch = texture.staging_row_length * 4;
+        command_list* const commands = queue->get_immediate_command_list();
+        commands->barrier(texture.texture, resource_usage::shader_resource_pixel, resource_usage::copy_dest);
+        for (size_t i = 0; i < rect_count; i++)
+        {
+            // Widen the rectangle to the left, so that it starts at an aligned offset in the staging buffer.
+            dirty_rect rect = rects[i];
+            rect.left = rect.left / STAGING_ALIGNMENT_PIXELS * STAGING_ALIGNMENT_PIXELS;
+            const uint64_t offset = uint64_t(rect.top) * row_pitch + uint64_t(rect.left) * 4;
+            copied_bytes += copy_rows({ texture.staging_data[index] + offset, row_pitch, 0 }, frame, rect);
+            const subresource_box box = { (int32_t)rect.left, (int32_t)rect.top, 0, (int32_t)rect.right, (int32_t)rect.bottom, 1 };
+            commands->copy_buffer_to_texture(texture.staging_buffers[index], offset, texture.staging_row_length, rect.bottom - rect.top, texture.texture, 0, &box);
+        }
+        commands->barrier(texture.texture, resource_usage::copy_dest, resource_usage::shader_resource_pixel);
+        queue->flush_immediate_command_list();
+        // Without a signal nothing tells when the copies are done, so the buffer counts as busy until the next one.
+        const bool signaled = queue->signal(upload_fence, ++fence_value);
+        texture.staging.submit(index, signaled ? fence_value : fence_value + 1);
+        return signaled;
+    }
+
+    /// <summary>Finds the top-left corner on screen for something to draw with the given placement.</summary>
+    /// <param name="display_width">Width of the screen.</param>
+    /// <param name="display_height">Height of the screen.</param>
+    /// <param name="width">Width of what is drawn.</param>
+    /// <param name="height">Height of what is drawn.</param>
+    /// <param name="alignment">Where to draw it, from 0 for left/top to 1 for right/bottom.</param>
+    /// <param name="offsets">How far to keep it away from the borders.</param>
+    /// <param name="x">Receives the left edge.</param>
+    /// <param name="y">Receives the top edge.</param>
+    static void screen_position(float display_width, float display_height, float width, float height,
+        const float alignment[2], const int offsets[2], float& x, float& y)
+    {
+        const float border_x = (std::min)(float(offsets[0]), (display_width - width) / 2);
+        const float border_y = (std::min)(float(offsets[1]), (display_height - height) / 2);
+        x = border_x + alignment[0] * (display_width - 2 * border_x - width);
+        y = border_y + alignment[1] * (display_height - 2 * border_y - height);
+    }
+
+    /// <summary>
+    /// Places a part of a texture on screen, leaving any scaling that wasn't done on the CPU to the GPU. The texture is
+    /// usually larger than the frame, which only covers its top-left corner.
+    /// </summary>
+    /// <param name="display_width">Width of the screen.</param>
+    /// <param name="display_height">Height of the screen.</param>
+    /// <param name="texture_width">Width of the texture.</param>
+    /// <param name="texture_height">Height of the texture.</param>
+    /// <param name="rect">The part of the texture to draw.</param>
+    /// <param name="scale">The factor to scale it by.</param>
+    /// <param name="alignment">Where to draw it, from 0 for left/top to 1 for right/bottom.</param>
+    /// <param name="offsets">How far to keep it away from the borders.</param>
+    static draw_quad place_region(float display_width, float display_height, uint32_t texture_width, uint32_t texture_height,
+        const dirty_rect& rect, float scale, const float alignment[2], const int offsets[2])
+    {
+        const float draw_width = (rect.right - rect.left) * scale;
+        const float draw_height = (rect.bottom - rect.top) * scale;
+        draw_quad quad;
+        screen_position(display_width, display_height, draw_width, draw_height, alignment, offsets, quad.left, quad.top);
+        quad.right = quad.left + draw_width;
+        quad.bottom = quad.top + draw_height;
+        quad.u1 = float(rect.left) / texture_width;
+        quad.v1 = float(rect.top) / texture_height;
+        quad.u3 = float(rect.right) / texture_width;
+        quad.v3 = float(rect.bottom) / texture_height;
+        return quad;
+    }
+};
+
+#endif //FRAME_UPLOAD_H
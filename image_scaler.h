@@ -0,0 +1,352 @@
+#ifndef IMAGE_SCALER_H
+#define IMAGE_SCALER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IMAGE_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+/// <summary>
+/// Shrinks 32-bit images on the CPU, so that less memory needs to be mapped, copied and sampled afterwards. Both
+/// filters are separable: a vertical pass combines the source rows that contribute to a destination row into one row
+/// of 16-bit sums, which is where most of the memory traffic is, and a horizontal pass then reduces that row to the
+/// destination width. With SSE2, the vertical pass handles 16 bytes at a time and the horizontal pass four
+/// destination pixels at a time, gathering the source columns that make up each of them. Only the intermediate rows,
+/// images and column tables are allocated, and only when the sizes grow.
+/// </summary>
+class image_scaler
+{
+public:
+    enum filter
+    {
+        /// <summary>Averages all source pixels covered by a destination pixel. Best for large reductions.</summary>
+        FILTER_BOX,
+        /// <summary>
+        /// Interpolates between the four source pixels nearest to a destination pixel's center. Below half the size,
+        /// the source is first box filtered to twice the destination size, so that no source pixels are skipped.
+        /// </summary>
+        FILTER_BILINEAR
+    };
+
+    /// <summary>
+    /// Scales down to this one are left to the GPU while drawing. Down to half the size its bilinear filter still
+    /// takes every source pixel into account, so shrinking on the CPU first would cost a pass over the whole image on
+    /// every capture for much the same result, while only the changed parts of a full-size image need uploading.
+    /// </summary>
+    static constexpr float MIN_GPU_SCALE = 0.5f;
+    /// <summary>The most source rows that may be averaged into one row, so that the 16-bit sums can't overflow.</summary>
+    static constexpr uint32_t MAX_BOX_ROWS = 256;
+
+    /// <summary>Computes the size of an image side after scaling.</summary>
+    static uint32_t scaled_size(uint32_t size, float scale)
+    {
+        const uint32_t scaled = uint32_t(size * scale + 0.5f);
+        return scaled != 0 ? scaled : 1;
+    }
+
+    /// <summary>Scales an image down. The destination must not be larger than the source in either direction.</summary>
+    /// <param name="src">The top-left source pixel.</param>
+    /// <param name="src_width">Width of the source in pixels.</param>
+    /// <param name="src_height">Height of the source in pixels.</param>
+    /// <param name="src_pitch">Distance between two source rows in bytes.</param>
+    /// <param name="dst">The top-left destination pixel.</param>
+    /// <param name="dst_width">Width of the destination in pixels.</param>
+    /// <param name="dst_height">Height of the destination in pixels.</param>
+    /// <param name="dst_pitch">Distance between two destination rows in bytes.</param>
+    /// <param name="mode">The filter to use.</param>
+    void scale(const uint8_t* src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+        uint8_t* dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch, filter mode)
+    {
+        if (src_width == dst_width && src_height == dst_height)
+        {
+            // Both filters keep an image at its size as it is, so there is nothing to compute.
+            for (uint32_t y = 0; y < dst_height; y++)
+                memcpy(dst + y * dst_pitch, src + y * src_pitch, size_t(dst_width) * 4);
+            return;
+        }
+        if (mode == FILTER_BOX)
+        {
+            scale_box(src, src_width, src_height, src_pitch, dst, dst_width, dst_height, dst_pitch);
+            return;
+        }
+        if (src_width > dst_width * 2 || src_height > dst_height * 2)
+        {
+            const uint32_t width = (std::min)(src_width, dst_width * 2), height = (std::min)(src_height, dst_height * 2);
+            _prefiltered.resize(size_t(width) * 4 * height);
+            scale_box(src, src_width, src_height, src_pitch, _prefiltered.data(), width, height, size_t(width) * 4);
+            src = _prefiltered.data();
+            src_width = width;
+            src_height = height;
+            src_pitch = size_t(width) * 4;
+        }
+        scale_bilinear(src, src_width, src_height, src_pitch, dst, dst_width, dst_height, dst_pitch);
+    }
+
+private:
+    void scale_box(const uint8_t* src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+        uint8_t* dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch)
+    {
+        const uint32_t row_bytes = src_width * 4;
+        // One more column, which the horizontal pass may read but never uses, so that it can always load two.
+        _row.resize(row_bytes + 4);
+        _columns.resize(size_t(dst_width) * 2);
+        bool narrow = true;
+        for (uint32_t x = 0; x < dst_width; x++)
+        {
+            _columns[x * 2] = uint32_t(uint64_t(x) * src_width / dst_width);
+            _columns[x * 2 + 1] = (std::max)(uint32_t(uint64_t(x + 1) * src_width / dst_width), _columns[x * 2] + 1);
+            narrow &= _columns[x * 2 + 1] - _columns[x * 2] <= 2;
+        }
+        for (uint32_t y = 0; y < dst_height; y++)
+        {
+            const uint32_t top = uint32_t(uint64_t(y) * src_height / dst_height);
+            const uint32_t bottom = (std::min)((std::max)(uint32_t(uint64_t(y + 1) * src_height / dst_height), top + 1), top + MAX_BOX_ROWS);
+            widen_row(_row.data(), src + top * src_pitch, row_bytes);
+            for (uint32_t row = top + 1; row < bottom; row++)
+                accumulate_row(_row.data(), src + row * src_pitch, row_bytes);
+            reduce_box(dst + y * dst_pitch, dst_width, bottom - top, narrow);
+        }
+    }
+
+    void scale_bilinear(const uint8_t* src, uint32_t src_width, uint32_t src_height, size_t src_pitch,
+        uint8_t* dst, uint32_t dst_width, uint32_t dst_height, size_t dst_pitch)
+    {
+        const uint32_t row_bytes = src_width * 4;
+        _row.resize(row_bytes);
+        _columns.resize(size_t(dst_width) * 2);
+        // Sample positions in 8-bit fixed point, aligned at pixel centers and clamped to the image.
+        for (uint32_t x = 0; x < dst_width; x++)
+        {
+            const uint32_t position = sample_position(x, src_width, dst_width);
+            _columns[x * 2] = position >> 8;
+            _columns[x * 2 + 1] = position & 0xff;
+        }
+        for (uint32_t y = 0; y < dst_height; y++)
+        {
+            const uint32_t position = sample_position(y, src_height, dst_height);
+            const uint32_t row = position >> 8;
+            const uint32_t next_row = row + 1 < src_height ? row + 1 : row;
+            blend_rows(_row.data(), src + row * src_pitch, src + next_row * src_pitch, position & 0xff, row_bytes);
+            reduce_bilinear(dst + y * dst_pitch, dst_width, src_width);
+        }
+    }
+
+    static uint32_t sample_position(uint32_t index, uint32_t src_size, uint32_t dst_size)
+    {
+        const int64_t twice_position = (int64_t(index) * 2 + 1) * src_size * 256 - int64_t(dst_size) * 256;
+        const int64_t position = twice_position < 0 ? 0 : (twice_position + dst_size) / (int64_t(dst_size) * 2);
+        return uint32_t(position < 0 ? 0 : (std::min)(position, int64_t(src_size - 1) * 256));
+    }
+
+    /// <summary>Starts a row of 16-bit sums with a row of bytes.</summary>
+    static void widen_row(uint16_t* sums, const uint8_t* src, uint32_t bytes)
+    {
+        uint32_t i = 0;
+#ifdef IMAGE_SCALER_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_si128((__m128i*)(sums + i), _mm_unpacklo_epi8(pixels, zero));
+            _mm_storeu_si128((__m128i*)(sums + i + 8), _mm_unpackhi_epi8(pixels, zero));
+        }
+#endif
+        for (; i < bytes; i++)
+            sums[i] = src[i];
+    }
+
+    /// <summary>Adds a row of bytes to a row of 16-bit sums.</summary>
+    static void accumulate_row(uint16_t* sums, const uint8_t* src, uint32_t bytes)
+    {
+        uint32_t i = 0;
+#ifdef IMAGE_SCALER_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i* out = (__m128i*)(sums + i);
+            _mm_storeu_si128(out, _mm_add_epi16(_mm_loadu_si128(out), _mm_unpacklo_epi8(pixels, zero)));
+            _mm_storeu_si128(out + 1, _mm_add_epi16(_mm_loadu_si128(out + 1), _mm_unpackhi_epi8(pixels, zero)));
+        }
+#endif
+        for (; i < bytes; i++)
+            sums[i] = uint16_t(sums[i] + src[i]);
+    }
+
+    /// <summary>Interpolates between two rows of bytes, giving 16-bit results scaled by 256.</summary>
+    static void blend_rows(uint16_t* out, const uint8_t* a, const uint8_t* b, uint32_t weight_b, uint32_t bytes)
+    {
+        const uint32_t weight_a = 256 - weight_b;
+        uint32_t i = 0;
+#ifdef IMAGE_SCALER_SSE2
+        // The products don't fit into signed 16 bits, but wrap around correctly in unsigned arithmetic.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i factor_a = _mm_set1_epi16(short(weight_a));
+        const __m128i factor_b = _mm_set1_epi16(short(weight_b));
+        for (; i + 16 <= bytes; i += 16)
+        {
+            const __m128i pixels_a = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i pixels_b = _mm_loadu_si128((const __m128i*)(b + i));
+            const __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels_a, zero), factor_a), _mm_mullo_epi16(_mm_unpacklo_epi8(pixels_b, zero), factor_b));
+            const __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels_a, zero), factor_a), _mm_mullo_epi16(_mm_unpackhi_epi8(pixels_b, zero), factor_b));
+            _mm_storeu_si128((__m128i*)(out + i), low);
+            _mm_storeu_si128((__m128i*)(out + i + 8), high);
+        }
+#endif
+        for (; i < bytes; i++)
+            out[i] = uint16_t(a[i] * weight_a + b[i] * weight_b);
+    }
+
+#ifdef IMAGE_SCALER_SSE2
+    /// <summary>
+    /// The reciprocal of a count in all lanes, made a little larger so that an average that ends in exactly .5 still
+    /// rounds up, as it does with the scalar code.
+    /// </summary>
+    static __m128 reciprocal(uint32_t count)
+    {
+        return _mm_set1_ps(float(1.0 / count * (1 + 1.0 / (1 << 20))));
+    }
+
+    /// <summary>Divides four 32-bit sums by multiplying them with a reciprocal and rounds to the nearest integer.</summary>
+    static __m128i average(__m128i sums, __m128 factor)
+    {
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sums), factor), _mm_set1_ps(0.5f)));
+    }
+#endif
+
+    /// <summary>Averages the column ranges of the summed row into destination pixels.</summary>
+    /// <param name="narrow">Whether no destination pixel covers more than two columns.</param>
+    void reduce_box(uint8_t* dst, uint32_t dst_width, uint32_t rows, bool narrow) const
+    {
+        uint32_t x = 0;
+#ifdef IMAGE_SCALER_SSE2
+        // Four pixels at a time. The sums are divided by multiplying with the reciprocal of their count in single
+        // precision, which is exact enough for averages of bytes.
+        const __m128i zero = _mm_setzero_si128();
+        if (narrow && rows <= MAX_BOX_ROWS / 2)
+        {
+            // Down to half the size, which is what the add-on mostly does, a pixel covers one or two columns, whose
+            // sums still fit into 16 bits. Both columns are loaded and the second masked out where it isn't covered,
+            // so that there is no loop per pixel.
+            const __m128i second_mask[2] = { zero, _mm_set1_epi32(-1) };
+            const __m128 factors[2] = { reciprocal(rows), reciprocal(rows * 2) };
+            for (; x + 4 <= dst_width; x += 4)
+            {
+                __m128i sums[4];
+                __m128 factor[4];
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    const uint32_t left = _columns[(x + i) * 2], second = _columns[(x + i) * 2 + 1] - left - 1;
+                    const __m128i columns = _mm_loadu_si128((const __m128i*)&_row[left * 4]);
+                    sums[i] = _mm_add_epi16(columns, _mm_and_si128(_mm_srli_si128(columns, 8), second_mask[second]));
+                    factor[i] = factors[second];
+                }
+                const __m128i sums01 = _mm_unpacklo_epi64(sums[0], sums[1]), sums23 = _mm_unpacklo_epi64(sums[2], sums[3]);
+                const __m128i pixels01 = _mm_packs_epi32(average(_mm_unpacklo_epi16(sums01, zero), factor[0]), average(_mm_unpackhi_epi16(sums01, zero), factor[1]));
+                const __m128i pixels23 = _mm_packs_epi32(average(_mm_unpacklo_epi16(sums23, zero), factor[2]), average(_mm_unpackhi_epi16(sums23, zero), factor[3]));
+                _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(pixels01, pixels23));
+            }
+        }
+        // Wider columns are summed in 32 bits. They only come in two widths, so the reciprocal rarely needs to be
+        // recomputed.
+        uint32_t factor_count = 0;
+        __m128 factor = _mm_setzero_ps();
+        for (; x + 4 <= dst_width; x += 4)
+        {
+            __m128i pixels[4];
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                const uint32_t left = _columns[(x + i) * 2], right = _columns[(x + i) * 2 + 1];
+                const uint32_t count = (right - left) * rows;
+                if (count != factor_count)
+                {
+                    factor_count = count;
+                    factor = reciprocal(count);
+                }
+                __m128i sums = zero;
+                for (const uint16_t* column = &_row[left * 4]; column != &_row[0] + right * 4; column += 4)
+                    sums = _mm_add_epi32(sums, _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)column), zero));
+                pixels[i] = average(sums, factor);
+            }
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]), _mm_packs_epi32(pixels[2], pixels[3])));
+        }
+#endif
+        // Divide by multiplying with a 32-bit fixed point reciprocal. Only a count of one would need the full 2^32,
+        // where one less rounds the same.
+        uint32_t reciprocal_count = 0;
+        uint32_t reciprocal = 0;
+        for (; x < dst_width; x++)
+        {
+            const uint32_t left = _columns[x * 2], right = _columns[x * 2 + 1];
+            const uint32_t count = (right - left) * rows;
+            if (count != reciprocal_count)
+            {
+                reciprocal_count = count;
+                reciprocal = uint32_t((std::min)(((uint64_t(1) << 32) + count - 1) / count, uint64_t(UINT32_MAX)));
+            }
+            uint32_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+            for (const uint16_t* sums = &_row[left * 4]; sums != &_row[0] + right * 4; sums += 4)
+            {
+                sum0 += sums[0];
+                sum1 += sums[1];
+                sum2 += sums[2];
+                sum3 += sums[3];
+            }
+            dst[x * 4 + 0] = uint8_t((uint64_t(sum0) * reciprocal + (uint64_t(1) << 31)) >> 32);
+            dst[x * 4 + 1] = uint8_t((uint64_t(sum1) * reciprocal + (uint64_t(1) << 31)) >> 32);
+            dst[x * 4 + 2] = uint8_t((uint64_t(sum2) * reciprocal + (uint64_t(1) << 31)) >> 32);
+            dst[x * 4 + 3] = uint8_t((uint64_t(sum3) * reciprocal + (uint64_t(1) << 31)) >> 32);
+        }
+    }
+
+    /// <summary>Interpolates between neighboring columns of the blended row into destination pixels.</summary>
+    void reduce_bilinear(uint8_t* dst, uint32_t dst_width, uint32_t src_width) const
+    {
+        uint32_t x = 0;
+#ifdef IMAGE_SCALER_SSE2
+        // Two pixels at a time. The 16-bit values times 8-bit weights need 32 bits, so the low and high halves of
+        // the products are interleaved.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi32(32768);
+        for (; x + 2 <= dst_width; x += 2)
+        {
+            const uint32_t column0 = _columns[x * 2], weight0 = _columns[x * 2 + 1];
+            const uint32_t column1 = _columns[x * 2 + 2], weight1 = _columns[x * 2 + 3];
+            const uint32_t next0 = column0 + 1 < src_width ? column0 + 1 : column0;
+            const uint32_t next1 = column1 + 1 < src_width ? column1 + 1 : column1;
+            const __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&_row[column0 * 4]), _mm_loadl_epi64((const __m128i*)&_row[column1 * 4]));
+            const __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&_row[next0 * 4]), _mm_loadl_epi64((const __m128i*)&_row[next1 * 4]));
+            const __m128i factor_a = _mm_unpacklo_epi64(_mm_set1_epi16(short(256 - weight0)), _mm_set1_epi16(short(256 - weight1)));
+            const __m128i factor_b = _mm_unpacklo_epi64(_mm_set1_epi16(short(weight0)), _mm_set1_epi16(short(weight1)));
+            const __m128i low_a = _mm_mullo_epi16(a, factor_a), high_a = _mm_mulhi_epu16(a, factor_a);
+            const __m128i low_b = _mm_mullo_epi16(b, factor_b), high_b = _mm_mulhi_epu16(b, factor_b);
+            const __m128i pixel0 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low_a, high_a), _mm_unpacklo_epi16(low_b, high_b)), half), 16);
+            const __m128i pixel1 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low_a, high_a), _mm_unpackhi_epi16(low_b, high_b)), half), 16);
+            _mm_storel_epi64((__m128i*)(dst + x * 4), _mm_packus_epi16(_mm_packs_epi32(pixel0, pixel1), zero));
+        }
+#endif
+        for (; x < dst_width; x++)
+        {
+            const uint32_t column = _columns[x * 2], weight_b = _columns[x * 2 + 1];
+            const uint32_t next_column = column + 1 < src_width ? column + 1 : column;
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                const uint32_t value = _row[column * 4 + channel] * (256 - weight_b) + _row[next_column * 4 + channel] * weight_b;
+                dst[x * 4 + channel] = uint8_t((value + 32768) >> 16);
+            }
+        }
+    }
+
+    std::vector<uint16_t> _row;
+    /// <summary>The box filtered source of a bilinear reduction below half the size.</summary>
+    std::vector<uint8_t> _prefiltered;
+    std::vector<uint32_t> _columns;
+};
+
+#endif //IMAGE_SCALER_H
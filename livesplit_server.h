@@ -0,0 +1,302 @@
+#ifndef LIVESPLIT_SERVER_H
+#define LIVESPLIT_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+/// <summary>The state of LiveSplit's timer, as reported by the LiveSplit Server component.</summary>
+struct timer_state
+{
+    enum phase_type
+    {
+        PHASE_NOT_RUNNING,
+        PHASE_RUNNING,
+        PHASE_ENDED,
+        PHASE_PAUSED
+    };
+
+    phase_type phase = PHASE_NOT_RUNNING;
+    /// <summary>The timer's value at received_us, in microseconds. It is negative during a start offset.</summary>
+    int64_t time_us = 0;
+    /// <summary>Index of the current split, or -1 while the timer isn't running.</summary>
+    int split_index = -1;
+    std::string split_name;
+    /// <summary>When the timer had the value time_us, on the caller's clock.</summary>
+    uint64_t received_us = 0;
+
+    /// <summary>Extrapolates the timer's value to the given time. It only advances while the timer is running.</summary>
+    int64_t time_at(uint64_t now_us) const
+    {
+        return phase == PHASE_RUNNING && now_us > received_us ? time_us + int64_t(now_us - received_us) : time_us;
+    }
+
+    /// <summary>
+    /// Checks whether another state describes the same timer, so that it doesn't need to be handed on. Running
+    /// timers match as long as extrapolating this one to the other's time is off by no more than the tolerance.
+    /// </summary>
+    bool matches(const timer_state& other, int64_t tolerance_us) const
+    {
+        if (phase != other.phase || split_index != other.split_index || split_name != other.split_name)
+            return false;
+        const int64_t drift = time_at(other.received_us) - other.time_us;
+        return drift <= tolerance_us && drift >= -tolerance_us;
+    }
+
+    /// <summary>Formats a timer value the way LiveSplit shows it by default: 1:02:03.45, 2:03.45 or 3.45.</summary>
+    static void format_time(int64_t time_us, char* text, size_t size)
+    {
+        const char* sign = time_us < 0 ? "-" : "";
+        const uint64_t centiseconds = uint64_t(time_us < 0 ? -time_us : time_us) / 10000;
+        const unsigned hours = unsigned(centiseconds / 360000);
+        const unsigned minutes = unsigned(centiseconds / 6000 % 60);
+        const unsigned seconds = unsigned(centiseconds / 100 % 60);
+        const unsigned fraction = unsigned(centiseconds % 100);
+        if (hours != 0)
+            snprintf(text, size, "%s%u:%02u:%02u.%02u", sign, hours, minutes, seconds, fraction);
+        else if (minutes != 0)
+            snprintf(text, size, "%s%u:%02u.%02u", sign, minutes, seconds, fraction);
+        else
+            snprintf(text, size, "%s%u.%02u", sign, seconds, fraction);
+    }
+};
+
+/// <summary>
+/// Queries the timer state from the LiveSplit Server component over a TCP connection to localhost. The server
+/// answers each command on a line of its own, so all commands of a poll are sent at once and then the answers are
+/// read in order, which costs a single round trip. The moment the timer was read is estimated as the middle of that
+/// round trip. A missing server is only tried again after RECONNECT_INTERVAL_US, and a server that stops answering
+/// is dropped after TIMEOUT_MS, so polling never holds up the caller for long.
+/// </summary>
+class livesplit_server_client
+{
+public:
+    static constexpr uint16_t DEFAULT_PORT = 16834;
+    /// <summary>How long to wait for an answer before giving up on the connection.</summary>
+    static constexpr uint32_t TIMEOUT_MS = 250;
+    /// <summary>Minimum time between two connection attempts.</summary>
+    static constexpr uint64_t RECONNECT_INTERVAL_US = 2000000;
+
+    explicit livesplit_server_client(uint16_t port = DEFAULT_PORT) : _port(port)
+    {
+#ifdef _WIN32
+        WSADATA data;
+        _started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#endif
+    }
+
+    ~livesplit_server_client()
+    {
+        disconnect();
+#ifdef _WIN32
+        if (_started)
+            WSACleanup();
+#endif
+    }
+
+    livesplit_server_client(const livesplit_server_client&) = delete;
+    livesplit_server_client& operator=(const livesplit_server_client&) = delete;
+
+    bool connected() const
+    {
+        return _socket != INVALID_SOCKET_HANDLE;
+    }
+
+    void disconnect()
+    {
+        if (_socket != INVALID_SOCKET_HANDLE)
+        {
+#ifdef _WIN32
+            closesocket(_socket);
+#else
+            close(_socket);
+#endif
+            _socket = INVALID_SOCKET_HANDLE;
+        }
+        _received.clear();
+    }
+
+    /// <summary>Queries the timer state, connecting first if necessary.</summary>
+    /// <param name="clock_us">Reads the clock that received_us is measured on, in microseconds.</param>
+    /// <param name="state">Receives the timer state. Left alone on failure.</param>
+    /// <returns>false if the server can't be reached or doesn't answer properly.</returns>
+    bool poll(uint64_t (*clock_us)(), timer_state& state)
+    {
+        if (!connected() && !connect(clock_us()))
+            return false;
+
+        static const char COMMANDS[] = "getcurrenttimerphase\r\ngetcurrenttime\r\ngetsplitindex\r\ngetcurrentsplitname\r\n";
+        const uint64_t sent_us = clock_us();
+        if (send(_socket, COMMANDS, int(sizeof(COMMANDS) - 1), SEND_FLAGS) != int(sizeof(COMMANDS) - 1))
+        {
+            disconnect();
+            return false;
+        }
+
+        std::string phase, time, split_index;
+        timer_state result;
+        if (!read_line(phase) || !read_line(time) || !read_line(split_index) || !read_line(result.split_name)
+            || !parse_phase(phase.c_str(), result.phase))
+        {
+            disconnect();
+            return false;
+        }
+        result.received_us = sent_us + (clock_us() - sent_us) / 2;
+        // The time is "-" while there is none, which counts as 0.
+        if (!parse_time(time.c_str(), result.time_us))
+            result.time_us = 0;
+        result.split_index = atoi(split_index.c_str());
+        if (result.split_index < 0 || result.split_name == "-")
+            result.split_name.clear();
+        state = std::move(result);
+        return true;
+    }
+
+    /// <summary>Parses one of the phase names LiveSplit uses: NotRunning, Running, Ended or Paused.</summary>
+    static bool parse_phase(const char* text, timer_state::phase_type& phase)
+    {
+        static const char* const NAMES[] = { "NotRunning", "Running", "Ended", "Paused" };
+        for (int i = 0; i < 4; i++)
+        {
+            if (strcmp(text, NAMES[i]) == 0)
+            {
+                phase = timer_state::phase_type(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Parses a time span like "-1:02:03.4500000", "2:03.45" or "3.45" into microseconds. Up to two colons separate
+    /// hours, minutes and seconds, and fractions of a second may have any number of digits.
+    /// </summary>
+    static bool parse_time(const char* text, int64_t& time_us)
+    {
+        const bool negative = *text == '-';
+        if (negative)
+            text++;
+        int64_t seconds = 0;
+        int fields = 0;
+        while (true)
+        {
+            if (*text < '0' || *text > '9')
+                return false;
+            int64_t field = 0;
+            while (*text >= '0' && *text <= '9')
+                field = field * 10 + (*text++ - '0');
+            seconds = seconds * 60 + field;
+            if (*text != ':' || ++fields > 2)
+                break;
+            text++;
+        }
+        int64_t fraction_us = 0;
+        if (*text == '.')
+        {
+            int64_t digit_us = 100000;
+            for (text++; *text >= '0' && *text <= '9'; text++, digit_us /= 10)
+                fraction_us += (*text - '0') * digit_us;
+        }
+        if (*text != '\0')
+            return false;
+        time_us = seconds * 1000000 + fraction_us;
+        if (negative)
+            time_us = -time_us;
+        return true;
+    }
+
+private:
+#ifdef _WIN32
+    typedef SOCKET socket_handle;
+    static constexpr socket_handle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+    typedef int socket_handle;
+    static constexpr socket_handle INVALID_SOCKET_HANDLE = -1;
+#endif
+#ifdef MSG_NOSIGNAL
+    // A server that went away must not kill the process with SIGPIPE.
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;
+#endif
+
+    bool connect(uint64_t now_us)
+    {
+        if (_last_attempt_us != 0 && now_us - _last_attempt_us < RECONNECT_INTERVAL_US)
+            return false;
+        _last_attempt_us = now_us;
+
+        _socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (_socket == INVALID_SOCKET_HANDLE)
+            return false;
+
+        // The commands are small and answered right away, so don't let Nagle's algorithm hold them back.
+        const int no_delay = 1;
+        setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+#ifdef _WIN32
+        const DWORD timeout = TIMEOUT_MS;
+#else
+        const timeval timeout = { TIMEOUT_MS / 1000, TIMEOUT_MS % 1000 * 1000 };
+#endif
+        setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(_socket, (const sockaddr*)&address, sizeof(address)) != 0)
+        {
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    /// <summary>Reads the next line of an answer, without its line break.</summary>
+    bool read_line(std::string& line)
+    {
+        size_t end;
+        while ((end = _received.find('\n')) == std::string::npos)
+        {
+            // Guard against a peer that isn't LiveSplit and never sends a line break.
+            if (_received.size() > MAX_LINE_LENGTH)
+                return false;
+            char buffer[512];
+            const int length = recv(_socket, buffer, int(sizeof(buffer)), 0);
+            if (length <= 0)
+                return false;
+            _received.append(buffer, size_t(length));
+        }
+        line.assign(_received, 0, end != 0 && _received[end - 1] == '\r' ? end - 1 : end);
+        _received.erase(0, end + 1);
+        return true;
+    }
+
+    static constexpr size_t MAX_LINE_LENGTH = 4096;
+
+    uint16_t _port;
+    socket_handle _socket = INVALID_SOCKET_HANDLE;
+    std::string _received;
+    uint64_t _last_attempt_us = 0;
+#ifdef _WIN32
+    bool _started = false;
+#endif
+};
+
+#endif //LIVESPLIT_SERVER_H
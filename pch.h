@@ -8,9 +8,31 @@
 #include <imgui.h>
 #include <reshade.hpp>
 #include <psapi.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "version.h"
+#include "background_key.h"
+#include "capture_phase_predictor.h"
+#include "capture_scheduler.h"
+#include "frame_mailbox.h"
+#include "frame_recorder.h"
+#include "frame_upload.h"
+#include "image_scaler.h"
+#include "livesplit_server.h"
+#include "resource_pool.h"
+#include "shared_frame_ring.h"
+#include "stage_histogram.h"
+#include "staging_ring.h"
+#include "synthetic_frame_source.h"
+#include "tile_diff.h"
+#include "window_discovery.h"
+#include "worker_lifecycle.h"
 
 using namespace reshade::api;
 
@@ -0,0 +1,217 @@
+#ifndef RESOURCE_POOL_H
+#define RESOURCE_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>Rounds sizes up to a small set of classes, four per doubling, so that small changes stay in one class.</summary>
+struct size_class
+{
+    static constexpr uint64_t MIN_SIZE = 64;
+
+    static uint64_t round_up(uint64_t size)
+    {
+        if (size <= MIN_SIZE)
+            return MIN_SIZE;
+        uint64_t power = MIN_SIZE;
+        while (power * 2 < size)
+            power *= 2;
+        const uint64_t step = power / 4;
+        return (size + step - 1) / step * step;
+    }
+};
+
+/// <summary>Creates and destroys the resources a resource_pool hands out.</summary>
+template <typename resource_type>
+class resource_factory
+{
+public:
+    virtual ~resource_factory() {}
+
+    /// <summary>Creates a resource of the given size. Returns false on failure.</summary>
+    virtual bool create(uint32_t width, uint32_t height, resource_type& resource) = 0;
+    virtual void destroy(resource_type& resource) = 0;
+};
+
+/// <summary>
+/// Keeps the one resource that holds the current image, sized by size classes, so that an image that grows or
+/// shrinks a little keeps its resource and only uses a smaller part of it. A larger resource is created as soon as
+/// the image doesn't fit, but a smaller one only after the image stayed in a smaller class for SHRINK_DELAY_US, so
+/// that a resize storm or a layout that keeps changing its height doesn't recreate anything. Resources that are
+/// replaced can be kept as spares and are reused when the image returns to their size, until they expire.
+/// </summary>
+template <typename resource_type>
+class resource_pool
+{
+public:
+    /// <summary>How long the image must fit a smaller class before the resource shrinks, and how long spares are kept.</summary>
+    static constexpr uint64_t SHRINK_DELAY_US = 5000000;
+
+    /// <param name="factory">Creates and destroys the resources.</param>
+    /// <param name="max_spares">How many replaced resources to keep for reuse. Resources that can't be reused,
+    /// because something else still holds on to them after they were replaced, need 0.</param>
+    resource_pool(resource_factory<resource_type>& factory, size_t max_spares) : _factory(factory), _max_spares(max_spares)
+    {
+    }
+
+    ~resource_pool()
+    {
+        clear();
+    }
+
+    resource_pool(const resource_pool&) = delete;
+    resource_pool& operator=(const resource_pool&) = delete;
+
+    /// <summary>Gets a resource that an image of the given size fits into, creating one if necessary.</summary>
+    /// <param name="width">Width of the image.</param>
+    /// <param name="height">Height of the image.</param>
+    /// <param name="now_us">The current time in microseconds.</param>
+    /// <returns>The current resource or nullptr if it couldn't be created.</returns>
+    resource_type* acquire(uint32_t width, uint32_t height, uint64_t now_us)
+    {
+        const uint32_t class_width = uint32_t(size_class::round_up(width));
+        const uint32_t class_height = uint32_t(size_class::round_up(height));
+        if (_has_current && width <= _width && height <= _height)
+        {
+            if (class_width >= _width && class_height >= _height)
+            {
+                _shrink_since_us = 0;
+            }
+            else if (_shrink_since_us == 0)
+            {
+                _shrink_since_us = now_us;
+                _shrink_width = class_width;
+                _shrink_height = class_height;
+            }
+            else
+            {
+                // Shrink to the largest size seen while waiting.
+                _shrink_width = (std::max)(_shrink_width, class_width);
+                _shrink_height = (std::max)(_shrink_height, class_height);
+                if (now_us - _shrink_since_us >= SHRINK_DELAY_US)
+                    replace(_shrink_width, _shrink_height, now_us);
+            }
+        }
+        else if (_failed_width != class_width || _failed_height != class_height)
+        {
+            replace(class_width, class_height, now_us);
+        }
+        expire_spares(now_us);
+        return _has_current ? &_current : nullptr;
+    }
+
+    /// <summary>Destroys the current resource and all spares.</summary>
+    void clear()
+    {
+        if (_has_current)
+            _factory.destroy(_current);
+        _has_current = false;
+        for (spare& entry : _spares)
+            _factory.destroy(entry.resource);
+        _spares.clear();
+        _shrink_since_us = 0;
+        _failed_width = 0;
+        _failed_height = 0;
+    }
+
+    /// <summary>Width of the current resource, which may be larger than the image in it.</summary>
+    uint32_t width() const
+    {
+        return _has_current ? _width : 0;
+    }
+
+    /// <summary>Height of the current resource, which may be larger than the image in it.</summary>
+    uint32_t height() const
+    {
+        return _has_current ? _height : 0;
+    }
+
+    /// <summary>Number of resources created so far.</summary>
+    uint64_t creations() const
+    {
+        return _creations;
+    }
+
+    /// <summary>Number of times a spare was reused instead of creating a resource.</summary>
+    uint64_t reuses() const
+    {
+        return _reuses;
+    }
+
+private:
+    struct spare
+    {
+        resource_type resource;
+        uint32_t width, height;
+        uint64_t released_us;
+    };
+
+    void replace(uint32_t width, uint32_t height, uint64_t now_us)
+    {
+        _shrink_since_us = 0;
+        if (_has_current)
+        {
+            _has_current = false;
+            if (_max_spares == 0)
+            {
+                _factory.destroy(_current);
+            }
+            else
+            {
+                if (_spares.size() == _max_spares)
+                {
+                    _factory.destroy(_spares.front().resource);
+                    _spares.erase(_spares.begin());
+                }
+                _spares.push_back({ _current, _width, _height, now_us });
+            }
+        }
+
+        for (size_t i = 0; i < _spares.size(); i++)
+        {
+            if (_spares[i].width == width && _spares[i].height == height)
+            {
+                _current = _spares[i].resource;
+                _spares.erase(_spares.begin() + i);
+                _has_current = true;
+                _reuses++;
+                break;
+            }
+        }
+        if (!_has_current)
+        {
+            // A size that failed isn't tried again until the image moves to another size class.
+            _has_current = _factory.create(width, height, _current);
+            _creations += _has_current;
+            _failed_width = _has_current ? 0 : width;
+            _failed_height = _has_current ? 0 : height;
+        }
+        _width = width;
+        _height = height;
+    }
+
+    void expire_spares(uint64_t now_us)
+    {
+        while (!_spares.empty() && now_us - _spares.front().released_us >= SHRINK_DELAY_US)
+        {
+            _factory.destroy(_spares.front().resource);
+            _spares.erase(_spares.begin());
+        }
+    }
+
+    resource_factory<resource_type>& _factory;
+    const size_t _max_spares;
+    resource_type _current = {};
+    bool _has_current = false;
+    uint32_t _width = 0, _height = 0;
+    uint64_t _shrink_since_us = 0;
+    uint32_t _shrink_width = 0, _shrink_height = 0;
+    uint32_t _failed_width = 0, _failed_height = 0;
+    std::vector<spare> _spares;
+    uint64_t _creations = 0;
+    uint64_t _reuses = 0;
+};
+
+#endif //RESOURCE_POOL_H
@@ -0,0 +1,332 @@
+#ifndef SHARED_FRAME_RING_H
+#define SHARED_FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// A ring of 32-bit images in named shared memory, through which another process can hand frames to the add-on
+/// without going through GDI. Each slot is guarded by a sequence counter that is odd while the slot is written
+/// (a seqlock): the reader copies the newest slot and only accepts the copy if the counter was even and unchanged
+/// around it. Neither side ever waits for the other or makes a system call once the memory is mapped, so a stalled
+/// reader can't hold up the publisher and vice versa. With three slots, a copy is only torn if the publisher
+/// finishes two more frames while it is being made, in which case the reader simply tries the newest slot again.
+/// </summary>
+class shared_frame_ring
+{
+public:
+    static constexpr uint32_t MAGIC = 0x4c53464d; // "LSFM"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t SLOT_COUNT = 3;
+    /// <summary>The widest and tallest frame a ring may be made for, which keeps the size computations from overflowing.</summary>
+    static constexpr uint32_t MAX_DIMENSION = 16384;
+    /// <summary>How often read() tries again after the publisher overwrote the slot it was copying.</summary>
+    static constexpr uint32_t MAX_READ_ATTEMPTS = 4;
+#ifdef _WIN32
+    static constexpr const char* DEFAULT_NAME = "Local\\livesplit_overlay_frames";
+#else
+    static constexpr const char* DEFAULT_NAME = "/livesplit_overlay_frames";
+#endif
+
+    /// <summary>What a reader learns about the frame it copied.</summary>
+    struct frame_info
+    {
+        uint32_t width, height;
+        /// <summary>Counts the frames published so far, 1 for the first.</summary>
+        uint64_t sequence;
+        /// <summary>When the frame was published, on the publisher's monotonic clock in microseconds.</summary>
+        uint64_t timestamp_us;
+    };
+
+    shared_frame_ring() = default;
+    shared_frame_ring(const shared_frame_ring&) = delete;
+    shared_frame_ring& operator=(const shared_frame_ring&) = delete;
+
+    ~shared_frame_ring()
+    {
+        close();
+    }
+
+    bool is_open() const
+    {
+        return _header != nullptr;
+    }
+
+    /// <summary>Creates the shared memory as the publisher, or opens it again if it exists with the same layout.</summary>
+    /// <param name="name">Name of the shared memory.</param>
+    /// <param name="max_width">The widest frame that will be published.</param>
+    /// <param name="max_height">The tallest frame that will be published.</param>
+    bool create(const char* name, uint32_t max_width, uint32_t max_height)
+    {
+        close();
+        if (!fits_in_memory(max_width, max_height))
+            return false;
+        const uint64_t slot_size = slot_size_for(max_width, max_height);
+        const size_t size = size_t(HEADER_SIZE + slot_size * SLOT_COUNT);
+#ifdef _WIN32
+        _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), name);
+        if (_mapping == NULL)
+            return false;
+        _memory = MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+#else
+        const int file = shm_open(name, O_RDWR | O_CREAT, 0600);
+        if (file < 0)
+            return false;
+        if (ftruncate(file, off_t(size)) == 0)
+            _memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        ::close(file);
+        if (_memory == MAP_FAILED)
+            _memory = nullptr;
+#endif
+        _size = size;
+        if (_memory == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        // Fresh memory is all zeros. Memory left by an earlier publisher keeps its sequence counters, so that a
+        // reader that is still attached doesn't mistake a new frame for one it has already seen.
+        _header = (ring_header*)_memory;
+        _writable = true;
+        _slot_size = slot_size;
+        if (_header->magic != MAGIC || _header->version != VERSION || _header->slot_size != slot_size)
+        {
+            memset(_memory, 0, HEADER_SIZE);
+            for (uint32_t i = 0; i < SLOT_COUNT; i++)
+                get_slot(i)->sequence.store(0, std::memory_order_relaxed);
+            _header->version = VERSION;
+            _header->slot_count = SLOT_COUNT;
+            _header->max_width = max_width;
+            _header->max_height = max_height;
+            _header->slot_size = slot_size;
+            std::atomic_thread_fence(std::memory_order_release);
+            _header->magic = MAGIC;
+        }
+        _max_width = _header->max_width;
+        _max_height = _header->max_height;
+        _slot_size = _header->slot_size;
+        return true;
+    }
+
+    /// <summary>Opens the shared memory as a reader. Fails if no publisher created it yet or the layout is unknown.</summary>
+    bool open(const char* name)
+    {
+        close();
+#ifdef _WIN32
+        _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+        if (_mapping == NULL)
+            return false;
+        _memory = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (_memory != nullptr && VirtualQuery(_memory, &info, sizeof(info)) != 0)
+            _size = info.RegionSize;
+#else
+        const int file = shm_open(name, O_RDONLY, 0);
+        if (file < 0)
+            return false;
+        struct stat status;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+        {
+            _size = size_t(status.st_size);
+            _memory = mmap(nullptr, _size, PROT_READ, MAP_SHARED, file, 0);
+            if (_memory == MAP_FAILED)
+                _memory = nullptr;
+        }
+        ::close(file);
+#endif
+        _header = (ring_header*)_memory;
+        if (_memory == nullptr || _size < HEADER_SIZE || _header->magic != MAGIC)
+        {
+            close();
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_header->version != VERSION || _header->slot_count != SLOT_COUNT
+            || !fits_in_memory(_header->max_width, _header->max_height)
+            || _header->slot_size != slot_size_for(_header->max_width, _header->max_height)
+            || HEADER_SIZE + _header->slot_size * SLOT_COUNT > _size)
+        {
+            close();
+            return false;
+        }
+        // The layout is only read once, so that a publisher can't make the reader step outside the mapping later.
+        _max_width = _header->max_width;
+        _max_height = _header->max_height;
+        _slot_size = _header->slot_size;
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (_memory != nullptr)
+            UnmapViewOfFile(_memory);
+        if (_mapping != NULL)
+            CloseHandle(_mapping);
+        _mapping = NULL;
+#else
+        if (_memory != nullptr)
+            munmap(_memory, _size);
+#endif
+        _memory = nullptr;
+        _header = nullptr;
+        _size = 0;
+        _writable = false;
+    }
+
+    /// <summary>
+    /// Checks whether a publisher created the shared memory anew with a different layout since it was opened. The
+    /// reader keeps using the layout it opened with, so it needs to open the memory again to see the new frames.
+    /// </summary>
+    bool layout_changed() const
+    {
+        return _header->magic != MAGIC || _header->version != VERSION || _header->max_width != _max_width
+            || _header->max_height != _max_height || _header->slot_size != _slot_size;
+    }
+
+    /// <summary>The number of frames published so far. Reading it is enough to find out whether read() has anything new.</summary>
+    uint64_t published() const
+    {
+        return _header->published.load(std::memory_order_acquire);
+    }
+
+    /// <summary>Publishes a frame into the slot after the newest one. Only one process may publish.</summary>
+    /// <param name="pixels">The top-left pixel of the image as top-down BGRX rows.</param>
+    /// <param name="width">Width of the image, at most the maximum width given to create().</param>
+    /// <param name="height">Height of the image, at most the maximum height given to create().</param>
+    /// <param name="row_pitch">Distance between two rows of the image in bytes.</param>
+    /// <param name="timestamp_us">When the image was made, on a monotonic clock in microseconds.</param>
+    bool publish(const uint8_t* pixels, uint32_t width, uint32_t height, size_t row_pitch, uint64_t timestamp_us)
+    {
+        if (!_writable || width > _max_width || height > _max_height)
+            return false;
+
+        const uint64_t sequence = _header->published.load(std::memory_order_relaxed) + 1;
+        slot_header* slot = get_slot(uint32_t(sequence % SLOT_COUNT));
+        // Mark the slot as being written before touching its contents.
+        const uint64_t lock = slot->sequence.load(std::memory_order_relaxed) | 1;
+        slot->sequence.store(lock, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->width = width;
+        slot->height = height;
+        slot->frame = sequence;
+        slot->timestamp_us = timestamp_us;
+        uint8_t* dst = (uint8_t*)(slot + 1);
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(dst + size_t(y) * width * 4, pixels + y * row_pitch, size_t(width) * 4);
+
+        slot->sequence.store(lock + 1, std::memory_order_release);
+        _header->published.store(sequence, std::memory_order_release);
+        return true;
+    }
+
+    /// <summary>
+    /// Copies the newest complete frame. The caller decides where it goes, once the size is known, through a
+    /// function like uint8_t* get_storage(uint32_t width, uint32_t height, size_t&amp; row_pitch). The storage may
+    /// be written to more than once if the publisher overwrites the slot during the copy.
+    /// </summary>
+    /// <param name="get_storage">Provides the storage for a frame of the given size and its row pitch.</param>
+    /// <param name="info">Receives the size and sequence of the copied frame.</param>
+    /// <returns>false if nothing was published yet or every attempt was overwritten during the copy.</returns>
+    template <typename storage_function>
+    bool read(storage_function get_storage, frame_info& info) const
+    {
+        for (uint32_t attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++)
+        {
+            const uint64_t newest = _header->published.load(std::memory_order_acquire);
+            if (newest == 0)
+                return false;
+            const slot_header* slot = get_slot(uint32_t(newest % SLOT_COUNT));
+            const uint64_t before = slot->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            // The contents are only trusted after the sequence check below, but must be sane enough to copy.
+            const uint32_t width = slot->width, height = slot->height;
+            info = { width, height, slot->frame, slot->timestamp_us };
+            if (width > _max_width || height > _max_height)
+                continue;
+            size_t row_pitch;
+            uint8_t* dst = get_storage(width, height, row_pitch);
+            const uint8_t* src = (const uint8_t*)(slot + 1);
+            for (uint32_t y = 0; y < height; y++)
+                memcpy(dst + y * row_pitch, src + size_t(y) * width * 4, size_t(width) * 4);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct ring_header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t max_width, max_height;
+        uint64_t slot_size;
+        std::atomic<uint64_t> published;
+    };
+
+    /// <summary>Precedes the pixels of each slot, which are stored as top-down rows without padding.</summary>
+    struct alignas(64) slot_header
+    {
+        /// <summary>Odd while the slot is being written, incremented by two for every frame written to it.</summary>
+        std::atomic<uint64_t> sequence;
+        uint32_t width, height;
+        uint64_t frame;
+        uint64_t timestamp_us;
+    };
+
+    static constexpr uint64_t HEADER_SIZE = 64;
+    static_assert(sizeof(ring_header) <= HEADER_SIZE, "The ring header must fit in front of the first slot.");
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+        "The sequence counters must be plain lock-free 64-bit values to be shared between processes.");
+
+    /// <summary>Checks the maximum frame size before slot_size_for() and the size of the whole ring are computed.</summary>
+    static bool fits_in_memory(uint32_t max_width, uint32_t max_height)
+    {
+        return max_width <= MAX_DIMENSION && max_height <= MAX_DIMENSION
+            && (SIZE_MAX - HEADER_SIZE) / SLOT_COUNT >= slot_size_for(max_width, max_height);
+    }
+
+    static uint64_t slot_size_for(uint32_t max_width, uint32_t max_height)
+    {
+        return (sizeof(slot_header) + uint64_t(max_width) * max_height * 4 + 63) / 64 * 64;
+    }
+
+    slot_header* get_slot(uint32_t index) const
+    {
+        return (slot_header*)((uint8_t*)_memory + HEADER_SIZE + _slot_size * index);
+    }
+
+#ifdef _WIN32
+    HANDLE _mapping = NULL;
+#endif
+    void* _memory = nullptr;
+    size_t _size = 0;
+    ring_header* _header = nullptr;
+    uint32_t _max_width = 0, _max_height = 0;
+    uint64_t _slot_size = 0;
+    bool _writable = false;
+};
+
+#endif //SHARED_FRAME_RING_H
@@ -0,0 +1,109 @@
+#ifndef STAGE_HISTOGRAM_H
+#define STAGE_HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+/// <summary>
+/// Collects how long a stage of the capture pipeline takes, for percentiles over a rolling window. Samples go into
+/// log-linear buckets with eight steps per power of two, which bounds the error of a percentile to 12.5% while the
+/// whole histogram fits in a fixed array. Recording is lock-free and never allocates, so it can stay on in the hot
+/// path of any thread. Summaries must be taken by a single thread.
+/// </summary>
+class stage_histogram
+{
+public:
+    static constexpr uint32_t BUCKET_COUNT = 256;
+
+    /// <summary>Percentiles of the samples recorded in one window.</summary>
+    struct summary
+    {
+        uint32_t count;
+        uint64_t p50_ns, p99_ns, max_ns;
+    };
+
+    /// <summary>Records one sample.</summary>
+    /// <param name="duration_ns">How long the stage took in nanoseconds.</param>
+    void record(uint64_t duration_ns)
+    {
+        _counts[bucket_of(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = _max_ns.load(std::memory_order_relaxed);
+        while (duration_ns > max && !_max_ns.compare_exchange_weak(max, duration_ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// <summary>Summarizes the samples recorded since the previous call and starts a new window.</summary>
+    summary roll()
+    {
+        uint32_t window[BUCKET_COUNT];
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            // The counters only ever grow, so the window is the difference to the previous snapshot.
+            const uint32_t count = _counts[i].load(std::memory_order_relaxed);
+            window[i] = count - _snapshot[i];
+            _snapshot[i] = count;
+            total += window[i];
+        }
+
+        summary result = { total, 0, 0, _max_ns.exchange(0, std::memory_order_relaxed) };
+        if (total == 0)
+            return result;
+        result.p50_ns = percentile(window, total, 50);
+        result.p99_ns = percentile(window, total, 99);
+        // A bucket's upper bound can exceed the largest sample in it.
+        if (result.max_ns != 0)
+        {
+            result.p50_ns = (std::min)(result.p50_ns, result.max_ns);
+            result.p99_ns = (std::min)(result.p99_ns, result.max_ns);
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint32_t SUB_BUCKET_BITS = 3;
+    static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    /// <summary>Values below SUB_BUCKETS get a bucket each, after that every power of two is split into SUB_BUCKETS.</summary>
+    static uint32_t bucket_of(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return uint32_t(value);
+        uint32_t exponent = 63;
+        while ((value >> exponent) == 0)
+            exponent--;
+        const uint32_t bucket = (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + uint32_t(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+        return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+    }
+
+    /// <summary>The largest value that falls into a bucket.</summary>
+    static uint64_t upper_bound_of(uint32_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        const uint32_t exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        const uint64_t mantissa = bucket % SUB_BUCKETS + SUB_BUCKETS;
+        return ((mantissa + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+    }
+
+    static uint64_t percentile(const uint32_t* window, uint32_t total, uint32_t percent)
+    {
+        const uint64_t rank = (uint64_t(total) * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            seen += window[i];
+            if (seen >= rank)
+                return upper_bound_of(i);
+        }
+        return upper_bound_of(BUCKET_COUNT - 1);
+    }
+
+    std::atomic<uint32_t> _counts[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> _max_ns { 0 };
+    uint32_t _snapshot[BUCKET_COUNT] = {};
+};
+
+#endif //STAGE_HISTOGRAM_H
@@ -0,0 +1,69 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Keeps track of a ring of staging buffers that the GPU copies into a texture. Each buffer remembers the fence
+/// value that is signaled after the last copy that reads from it, and is only handed to the host again once the GPU
+/// completed that value, so a buffer that is still in flight is never overwritten. When every buffer is in flight,
+/// the host skips the upload instead of waiting, and the texture keeps showing the previous frame.
+/// </summary>
+class staging_ring
+{
+public:
+    static constexpr size_t BUFFER_COUNT = 3;
+    static constexpr size_t NONE = SIZE_MAX;
+
+    /// <summary>Finds a buffer the host may write to, trying the least recently used one first.</summary>
+    /// <param name="completed_value">The fence value the GPU has completed.</param>
+    /// <returns>The index of the buffer or NONE if all of them are still in flight.</returns>
+    size_t acquire(uint64_t completed_value)
+    {
+        for (size_t i = 0; i < BUFFER_COUNT; i++)
+        {
+            const size_t index = (_next + i) % BUFFER_COUNT;
+            if (_in_flight_until[index] <= completed_value)
+                return index;
+        }
+        _stalls++;
+        return NONE;
+    }
+
+    /// <summary>Records that copies from a buffer were submitted, followed by a signal of the given fence value.</summary>
+    /// <param name="index">The buffer returned by acquire().</param>
+    /// <param name="fence_value">The fence value signaled after the copies. It must be larger than any before.</param>
+    void submit(size_t index, uint64_t fence_value)
+    {
+        _in_flight_until[index] = fence_value;
+        _last_value = fence_value;
+        _next = (index + 1) % BUFFER_COUNT;
+    }
+
+    /// <summary>Checks whether the GPU is done with all buffers, so they may be destroyed.</summary>
+    bool idle(uint64_t completed_value) const
+    {
+        return _last_value <= completed_value;
+    }
+
+    /// <summary>The fence value that the last copy from any of the buffers is followed by, or 0.</summary>
+    uint64_t last_value() const
+    {
+        return _last_value;
+    }
+
+    /// <summary>Number of times acquire() found all buffers in flight.</summary>
+    uint64_t stalls() const
+    {
+        return _stalls;
+    }
+
+private:
+    uint64_t _in_flight_until[BUFFER_COUNT] = {};
+    uint64_t _last_value = 0;
+    size_t _next = 0;
+    uint64_t _stalls = 0;
+};
+
+#endif //STAGING_RING_H
@@ -0,0 +1,158 @@
+#ifndef SYNTHETIC_FRAME_SOURCE_H
+#define SYNTHETIC_FRAME_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Paints images that behave like a LiveSplit window, so the capture pipeline can be exercised and measured without
+/// LiveSplit running: a timer that ticks every centisecond, a split highlight that moves down the list and a layout
+/// that periodically grows by a row, like a subsplit group that expands. Everything is derived from the time passed
+/// in by the caller, so the same times always produce the same images.
+/// </summary>
+class synthetic_frame_source
+{
+public:
+    /// <summary>How long each split stays highlighted.</summary>
+    static constexpr uint64_t SPLIT_DURATION_US = 5000000;
+    /// <summary>The layout is one row taller during the last third of each period.</summary>
+    static constexpr uint64_t RESIZE_PERIOD_US = 30000000;
+    static constexpr uint32_t ROW_HEIGHT = 24;
+    static constexpr uint32_t TIMER_HEIGHT = 100;
+
+    /// <param name="width">Width of the layout before scaling.</param>
+    /// <param name="split_count">Number of splits listed above the timer, 0 for a lone timer.</param>
+    /// <param name="scale">Integer scale factor, like a layout made for a high DPI display.</param>
+    void configure(uint32_t width, uint32_t split_count, uint32_t scale)
+    {
+        _scale = scale != 0 ? scale : 1;
+        _width = width * _scale;
+        _split_count = split_count;
+    }
+
+    uint32_t width() const
+    {
+        return _width;
+    }
+
+    /// <summary>The height of the image at the given time.</summary>
+    uint32_t height(uint64_t now_us) const
+    {
+        return (row_count(now_us) * ROW_HEIGHT + TIMER_HEIGHT) * _scale;
+    }
+
+    /// <summary>Paints the image as top-down BGRX rows.</summary>
+    /// <param name="now_us">The time to show, in microseconds.</param>
+    /// <param name="height">The result of height() for the same time.</param>
+    /// <param name="pixels">The top-left pixel of a buffer with room for width() x height pixels.</param>
+    /// <param name="row_pitch">Distance between two rows in bytes.</param>
+    void render(uint64_t now_us, uint32_t height, uint8_t* pixels, size_t row_pitch) const
+    {
+        const uint32_t s = _scale;
+        const uint32_t rows = (height / s - TIMER_HEIGHT) / ROW_HEIGHT;
+        const uint32_t current_split = rows != 0 ? uint32_t(now_us / SPLIT_DURATION_US % rows) : 0;
+        canvas target = { pixels, row_pitch, _width, height };
+
+        // The splits, each with a name and a time of varying length.
+        for (uint32_t row = 0; row < rows; row++)
+        {
+            const uint32_t top = row * ROW_HEIGHT * s;
+            const uint32_t background = row == current_split ? HIGHLIGHT_COLOR : row % 2 ? ALTERNATE_COLOR : BACKGROUND_COLOR;
+            target.fill(0, top, _width, top + ROW_HEIGHT * s, background);
+            target.fill(8 * s, top + 8 * s, (8 + 60 + row * 37 % 90) * s, top + 16 * s, TEXT_COLOR);
+            if (row < current_split)
+                target.fill(_width - 68 * s, top + 8 * s, _width - 8 * s, top + 16 * s, TEXT_COLOR);
+        }
+
+        // The timer shows minutes, seconds and centiseconds, right-aligned like LiveSplit's.
+        const uint32_t timer_top = rows * ROW_HEIGHT * s;
+        target.fill(0, timer_top, _width, height, BACKGROUND_COLOR);
+        const uint64_t centiseconds = now_us / 10000 % 360000;
+        const char text[] = {
+            char('0' + centiseconds / 6000 % 10), ':',
+            char('0' + centiseconds / 1000 % 6), char('0' + centiseconds / 100 % 10), '.',
+            char('0' + centiseconds / 10 % 10), char('0' + centiseconds % 10)
+        };
+        uint32_t right = _width > 8 * s ? _width - 8 * s : 0;
+        const uint32_t digit_top = timer_top + (TIMER_HEIGHT - DIGIT_HEIGHT) / 2 * s;
+        for (size_t i = sizeof(text); i-- != 0;)
+        {
+            const uint32_t advance = (text[i] >= '0' && text[i] <= '9' ? DIGIT_WIDTH + 4 : SEGMENT + 4) * s;
+            const uint32_t left = right > advance ? right - advance : 0;
+            draw_char(target, text[i], left, digit_top);
+            right = left;
+        }
+    }
+
+private:
+    static constexpr uint32_t BACKGROUND_COLOR = 0x0f0f0f;
+    static constexpr uint32_t ALTERNATE_COLOR = 0x1a1a1a;
+    static constexpr uint32_t HIGHLIGHT_COLOR = 0x1e4fa0;
+    static constexpr uint32_t TEXT_COLOR = 0xd0d0d0;
+    static constexpr uint32_t TIMER_COLOR = 0x22cc44;
+    static constexpr uint32_t DIGIT_WIDTH = 24;
+    static constexpr uint32_t DIGIT_HEIGHT = 48;
+    static constexpr uint32_t SEGMENT = 6;
+
+    /// <summary>A pixel buffer that clips everything painted onto it.</summary>
+    struct canvas
+    {
+        uint8_t* pixels;
+        size_t row_pitch;
+        uint32_t width, height;
+
+        void fill(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t color) const
+        {
+            right = right < width ? right : width;
+            bottom = bottom < height ? bottom : height;
+            for (uint32_t y = top; y < bottom; y++)
+            {
+                uint32_t* row = (uint32_t*)(pixels + y * row_pitch);
+                for (uint32_t x = left; x < right; x++)
+                    row[x] = color;
+            }
+        }
+    };
+
+    uint32_t row_count(uint64_t now_us) const
+    {
+        if (_split_count == 0)
+            return 0;
+        return _split_count + (now_us % RESIZE_PERIOD_US >= RESIZE_PERIOD_US / 3 * 2 ? 1 : 0);
+    }
+
+    /// <summary>Paints a digit as a seven-segment display, or a colon or dot as small squares.</summary>
+    void draw_char(const canvas& target, char c, uint32_t left, uint32_t top) const
+    {
+        // Segments from bit 0 to 6: top, top right, bottom right, bottom, bottom left, top left, middle.
+        static const uint8_t DIGIT_SEGMENTS[10] = { 0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f };
+        const uint32_t s = _scale;
+        const uint32_t t = SEGMENT * s, w = DIGIT_WIDTH * s, h = DIGIT_HEIGHT * s, m = (DIGIT_HEIGHT - SEGMENT) / 2 * s;
+        if (c == ':')
+        {
+            target.fill(left, top + h / 3 - t / 2, left + t, top + h / 3 + t / 2, TIMER_COLOR);
+            target.fill(left, top + h * 2 / 3 - t / 2, left + t, top + h * 2 / 3 + t / 2, TIMER_COLOR);
+            return;
+        }
+        if (c == '.')
+        {
+            target.fill(left, top + h - t, left + t, top + h, TIMER_COLOR);
+            return;
+        }
+
+        const uint8_t segments = DIGIT_SEGMENTS[c - '0'];
+        if (segments & 0x01) target.fill(left, top, left + w, top + t, TIMER_COLOR);
+        if (segments & 0x02) target.fill(left + w - t, top, left + w, top + m + t, TIMER_COLOR);
+        if (segments & 0x04) target.fill(left + w - t, top + m, left + w, top + h, TIMER_COLOR);
+        if (segments & 0x08) target.fill(left, top + h - t, left + w, top + h, TIMER_COLOR);
+        if (segments & 0x10) target.fill(left, top + m, left + t, top + h, TIMER_COLOR);
+        if (segments & 0x20) target.fill(left, top, left + t, top + m + t, TIMER_COLOR);
+        if (segments & 0x40) target.fill(left, top + m, left + w, top + m + t, TIMER_COLOR);
+    }
+
+    uint32_t _width = 300;
+    uint32_t _split_count = 0;
+    uint32_t _scale = 1;
+};
+
+#endif //SYNTHETIC_FRAME_SOURCE_H
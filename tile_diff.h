@@ -0,0 +1,169 @@
+#ifndef TILE_DIFF_H
+#define TILE_DIFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// <summary>A rectangle of pixels, with exclusive right and bottom edges.</summary>
+struct dirty_rect
+{
+    uint32_t left, top, right, bottom;
+};
+
+/// <summary>
+/// Finds the parts of a 32-bit image that changed between consecutive captures. The image is split into tiles and
+/// each tile is hashed, so only the hashes of the previous capture need to be kept around. Changes accumulate until
+/// the consumer calls clear_dirty(), so a capture that was never uploaded doesn't lose its changes.
+/// </summary>
+class tile_diff
+{
+public:
+    static const uint32_t TILE_WIDTH = 64;
+    static const uint32_t TILE_HEIGHT = 16;
+
+    /// <summary>Forgets all tile hashes, so that the next capture is reported as entirely dirty.</summary>
+    void invalidate()
+    {
+        _width = 0;
+        _height = 0;
+    }
+
+    /// <summary>Hashes a new capture and marks every tile that differs from the previous capture as dirty.</summary>
+    /// <param name="pixels">The top-left pixel of the capture.</param>
+    /// <param name="width">Width of the capture in pixels.</param>
+    /// <param name="height">Height of the capture in pixels.</param>
+    /// <param name="row_pitch">Distance between two rows in bytes.</param>
+    /// <returns>true if any tile changed in this capture.</returns>
+    bool update(const void* pixels, uint32_t width, uint32_t height, size_t row_pitch)
+    {
+        const uint32_t columns = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+        const uint32_t rows = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        const bool resized = width != _width || height != _height;
+        if (resized)
+        {
+            _width = width;
+            _height = height;
+            _columns = columns;
+            _hashes.assign(size_t(columns) * rows, 0);
+            _dirty.assign(size_t(columns) * rows, 1);
+        }
+
+        bool changed = resized;
+        for (uint32_t row = 0; row < rows; row++)
+        {
+            const uint32_t top = row * TILE_HEIGHT;
+            const uint32_t bottom = top + TILE_HEIGHT < height ? top + TILE_HEIGHT : height;
+            for (uint32_t column = 0; column < columns; column++)
+            {
+                const uint32_t left = column * TILE_WIDTH;
+                const uint32_t right = left + TILE_WIDTH < width ? left + TILE_WIDTH : width;
+                const uint64_t hash = hash_tile((const char*)pixels + left * 4, (right - left) * 4, bottom - top, row_pitch);
+                const size_t index = size_t(row) * columns + column;
+                if (hash != _hashes[index] || resized)
+                {
+                    _hashes[index] = hash;
+                    _dirty[index] = 1;
+                    changed = true;
+                }
+            }
+            pixels = (const char*)pixels + row_pitch * (bottom - top);
+        }
+        return changed;
+    }
+
+    /// <summary>Checks whether any tile changed since the last call to clear_dirty().</summary>
+    bool is_dirty() const
+    {
+        for (uint8_t dirty : _dirty)
+            if (dirty)
+                return true;
+        return false;
+    }
+
+    /// <summary>Acknowledges that all changes so far have been uploaded.</summary>
+    void clear_dirty()
+    {
+        _dirty.assign(_dirty.size(), 0);
+    }
+
+    /// <summary>
+    /// Collects the changed regions of the image. Each row of tiles is reduced to the span between its leftmost and
+    /// rightmost dirty tile and vertically adjacent rows are merged, which keeps the number of rectangles small for
+    /// the typical case of a few ticking timer digits.
+    /// </summary>
+    /// <param name="rects">Receives the dirty rectangles. Previous contents are discarded.</param>
+    void collect_dirty_rects(std::vector<dirty_rect>& rects) const
+    {
+        rects.clear();
+        const uint32_t rows = _columns ? uint32_t(_dirty.size() / _columns) : 0;
+        for (uint32_t row = 0; row < rows; row++)
+        {
+            uint32_t first = UINT32_MAX, last = 0;
+            for (uint32_t column = 0; column < _columns; column++)
+            {
+                if (_dirty[size_t(row) * _columns + column])
+                {
+                    if (first == UINT32_MAX)
+                        first = column;
+                    last = column;
+                }
+            }
+            if (first == UINT32_MAX)
+                continue;
+
+            dirty_rect rect = {
+                first * TILE_WIDTH,
+                row * TILE_HEIGHT,
+                (last + 1) * TILE_WIDTH < _width ? (last + 1) * TILE_WIDTH : _width,
+                (row + 1) * TILE_HEIGHT < _height ? (row + 1) * TILE_HEIGHT : _height
+            };
+            if (!rects.empty() && rects.back().bottom == rect.top)
+            {
+                dirty_rect& previous = rects.back();
+                previous.left = previous.left < rect.left ? previous.left : rect.left;
+                previous.right = previous.right > rect.right ? previous.right : rect.right;
+                previous.bottom = rect.bottom;
+            }
+            else
+            {
+                rects.push_back(rect);
+            }
+        }
+    }
+
+private:
+    /// <summary>Hashes one tile with four independent multiply-xor lanes, so the multiplications can overlap.</summary>
+    static uint64_t hash_tile(const char* data, uint32_t row_bytes, uint32_t rows, size_t row_pitch)
+    {
+        const uint64_t PRIME = 0x100000001b3ull;
+        uint64_t lanes[4] = { 0xcbf29ce484222325ull, 0x84222325cbf29ce4ull, 0x9ce484222325cbf2ull, 0x2325cbf29ce48422ull };
+        for (uint32_t y = 0; y < rows; y++, data += row_pitch)
+        {
+            uint32_t x = 0;
+            for (; x + 32 <= row_bytes; x += 32)
+            {
+                uint64_t words[4];
+                memcpy(words, data + x, sizeof(words));
+                lanes[0] = (lanes[0] ^ words[0]) * PRIME;
+                lanes[1] = (lanes[1] ^ words[1]) * PRIME;
+                lanes[2] = (lanes[2] ^ words[2]) * PRIME;
+                lanes[3] = (lanes[3] ^ words[3]) * PRIME;
+            }
+            for (; x + 4 <= row_bytes; x += 4)
+            {
+                uint32_t word;
+                memcpy(&word, data + x, sizeof(word));
+                lanes[0] = (lanes[0] ^ word) * PRIME;
+            }
+        }
+        return lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+    }
+
+    uint32_t _width = 0, _height = 0, _columns = 0;
+    std::vector<uint64_t> _hashes;
+    std::vector<uint8_t> _dirty;
+};
+
+#endif //TILE_DIFF_H
@@ -0,0 +1,203 @@
+// Checks that the vectorized background keying kernels give exactly the same bytes as the scalar reference, for all
+// row lengths around the vector widths, random and near-background pixels and every kind of key settings, and
+// measures how fast each of them keys a LiveSplit image. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. background_key_test.cpp -o background_key_test
+//   ./background_key_test
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../background_key.h"
+#include "../synthetic_frame_source.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+typedef void (*row_function)(uint8_t* dst, const uint8_t* src, uint32_t width, const key_params& params);
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static bool has_avx2()
+{
+#if defined(BACKGROUND_KEY_X86) && !defined(_MSC_VER)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/// <summary>The kernels the CPU can run, the scalar reference first.</summary>
+struct kernel
+{
+    const char* name;
+    row_function function;
+};
+
+static std::vector<kernel> available_kernels()
+{
+    std::vector<kernel> kernels = { { "scalar", &background_key::apply_row_scalar } };
+#ifdef BACKGROUND_KEY_X86
+    kernels.push_back({ "sse2", &background_key::apply_row_sse2 });
+    if (has_avx2())
+        kernels.push_back({ "avx2", &background_key::apply_row_avx2 });
+#endif
+    return kernels;
+}
+
+/// <summary>
+/// Fills a row with pixels around the background color, so that every channel lands inside, on the edge of and
+/// outside of the tolerance, mixed with random pixels and random bytes in the alpha channel that must be ignored.
+/// </summary>
+static void fill_row(std::vector<uint8_t>& row, const key_params& params, std::mt19937& random)
+{
+    for (size_t i = 0; i < row.size(); i += 4)
+    {
+        const uint32_t choice = random() % 4;
+        for (uint32_t channel = 0; channel < 3; channel++)
+        {
+            const int base = int((params.color >> (channel * 8)) & 0xff);
+            const int offsets[] = { 0, int(params.tolerance), -int(params.tolerance), int(params.tolerance) + 1, -int(params.tolerance) - 1 };
+            const int value = choice == 0 ? int(random() & 0xff) : base + offsets[random() % 5];
+            row[i + channel] = uint8_t(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+        row[i + 3] = uint8_t(random());
+    }
+}
+
+static void test_kernels_match_scalar()
+{
+    const std::vector<kernel> kernels = available_kernels();
+    printf("kernels:");
+    for (const kernel& k : kernels)
+        printf(" %s", k.name);
+    printf("\n");
+
+    const key_params settings[] = {
+        { 0x0f0f0f, 8, 255, true },
+        { 0x0f0f0f, 0, 255, true },
+        { 0x00ff00, 40, 200, true },
+        { 0xfafafa, 10, 128, true },
+        { 0x050505, 10, 128, true },
+        { 0x808080, 255, 255, true },
+        { 0x0f0f0f, 8, 180, false },
+        { 0x0f0f0f, 8, 0, true },
+    };
+    std::mt19937 random(1234);
+    bool matches = true, in_place_matches = true;
+    for (const key_params& params : settings)
+    {
+        for (uint32_t width = 0; width <= 40; width++)
+        {
+            std::vector<uint8_t> src(size_t(width) * 4), expected(src.size());
+            fill_row(src, params, random);
+            background_key::apply_row_scalar(expected.data(), src.data(), width, params);
+            for (const kernel& k : kernels)
+            {
+                std::vector<uint8_t> dst(src.size(), 0xcc), in_place = src;
+                k.function(dst.data(), src.data(), width, params);
+                k.function(in_place.data(), in_place.data(), width, params);
+                matches &= dst == expected;
+                in_place_matches &= in_place == expected;
+            }
+        }
+    }
+    check(matches, "every kernel gives the same bytes as the scalar reference");
+    check(in_place_matches, "every kernel may key a row in place");
+}
+
+static void test_reference()
+{
+    const key_params params = { 0x102030, 4, 200, true };
+    const uint8_t src[] = { 0x30, 0x20, 0x10, 0x99, 0x34, 0x1c, 0x14, 0x00, 0x35, 0x20, 0x10, 0xff, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t dst[sizeof(src)];
+    background_key::apply_row_scalar(dst, src, 4, params);
+    check(dst[3] == 0 && dst[7] == 0, "pixels within tolerance of the background become transparent");
+    check(dst[11] == 200 && dst[15] == 200, "all other pixels get the configured opacity");
+    check(memcmp(dst, "\x30\x20\x10", 3) == 0 && dst[8] == 0x35, "the color channels are kept as they are");
+}
+
+static void test_apply_with_pitch()
+{
+    const key_params params = { 0x0f0f0f, 8, 230, true };
+    const uint32_t width = 37, rows = 5;
+    const size_t src_pitch = width * 4 + 12, dst_pitch = width * 4 + 20;
+    std::mt19937 random(99);
+    std::vector<uint8_t> src(src_pitch * rows), dst(dst_pitch * rows, 0xcc), row(width * 4);
+    for (uint8_t& byte : src)
+        byte = uint8_t(random());
+    background_key::apply(dst.data(), dst_pitch, src.data(), src_pitch, width, rows, params);
+    bool matches = true, padding_kept = true;
+    for (uint32_t y = 0; y < rows; y++)
+    {
+        background_key::apply_row_scalar(row.data(), src.data() + y * src_pitch, width, params);
+        matches &= memcmp(row.data(), dst.data() + y * dst_pitch, row.size()) == 0;
+        for (size_t x = width * 4; x < dst_pitch; x++)
+            padding_kept &= dst[y * dst_pitch + x] == 0xcc;
+    }
+    check(matches, "apply() keys every row with its pitch");
+    check(padding_kept, "apply() leaves the destination padding alone");
+}
+
+static void test_pack()
+{
+    const key_params params = { 0xabcdef, 17, 201, true };
+    const key_params unpacked = key_params::unpack(params.pack());
+    check(unpacked.color == params.color && unpacked.tolerance == params.tolerance && unpacked.alpha == params.alpha
+        && unpacked.keyed == params.keyed, "key settings survive packing");
+    check(!key_params({ 0, 0, 255, false }).enabled() && key_params({ 0, 0, 254, false }).enabled(), "only opaque unkeyed images are copied as they are");
+}
+
+/// <summary>Keys a synthetic LiveSplit image over and over with each kernel and with a plain copy for comparison.</summary>
+static void measure_kernels(const char* name, uint32_t width, uint32_t split_count, uint32_t scale, uint32_t count)
+{
+    synthetic_frame_source source;
+    source.configure(width, split_count, scale);
+    const uint32_t height = source.height(0);
+    const size_t row_pitch = size_t(source.width()) * 4;
+    std::vector<uint8_t> src(row_pitch * height), dst(src.size());
+    source.render(0, height, src.data(), row_pitch);
+    const key_params params = { 0x0f0f0f, 8, 230, true };
+    const double megabytes = double(src.size()) * count / 1048576.0;
+
+    printf("%-12s %4ux%-4u", name, source.width(), height);
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+        memcpy(dst.data(), src.data(), src.size());
+    printf("  memcpy %7.0f MiB/s", megabytes / std::chrono::duration<double>(benchmark_clock::now() - start).count());
+    for (const kernel& k : available_kernels())
+    {
+        start = benchmark_clock::now();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            for (uint32_t y = 0; y < height; y++)
+                k.function(dst.data() + y * row_pitch, src.data() + y * row_pitch, source.width(), params);
+        }
+        printf("  %s %7.0f MiB/s", k.name, megabytes / std::chrono::duration<double>(benchmark_clock::now() - start).count());
+    }
+    printf("\n");
+}
+
+int main()
+{
+    test_kernels_match_scalar();
+    test_reference();
+    test_apply_with_pitch();
+    test_pack();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_kernels("timer", 300, 0, 1, 4000);
+    measure_kernels("splits", 300, 15, 1, 1000);
+    measure_kernels("splits, 4K", 300, 15, 2, 250);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+// Replays traces of frame times and capture durations through capture_phase_predictor, the way the render thread and
+// the worker thread feed it, and checks how well it places late captures: how often a capture misses the draw it was
+// meant for and how old the image is that each draw shows, compared with capturing right away. The traces cover a
+// steady game, jittery frame times, hitches, loading screens, a change in frame rate and slow captures, and capturing
+// late must never show older images than capturing right away, neither on average nor at the 99th percentile. It
+// only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. capture_phase_predictor_test.cpp -o capture_phase_predictor_test
+//   ./capture_phase_predictor_test
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../capture_phase_predictor.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>The time between draws and the time each capture started at that draw would take.</summary>
+struct trace
+{
+    const char* name;
+    std::vector<uint64_t> frame_us;
+    std::vector<uint64_t> capture_us;
+};
+
+/// <param name="frame_us">The average time between draws.</param>
+/// <param name="frame_jitter_us">How far each frame time may be off the average.</param>
+/// <param name="capture_us">The average duration of a capture.</param>
+/// <param name="capture_jitter_us">How far each capture may be off the average.</param>
+static trace make_trace(const char* name, uint32_t draws, uint64_t frame_us, uint64_t frame_jitter_us, uint64_t capture_us, uint64_t capture_jitter_us)
+{
+    trace result = { name, {}, {} };
+    std::mt19937 random(draws + uint32_t(frame_us));
+    for (uint32_t i = 0; i < draws; i++)
+    {
+        result.frame_us.push_back(frame_us - frame_jitter_us + random() % (2 * frame_jitter_us + 1));
+        result.capture_us.push_back(capture_us - capture_jitter_us + random() % (2 * capture_jitter_us + 1));
+    }
+    return result;
+}
+
+/// <summary>What happened during a replay, from the first draw after the warm-up on.</summary>
+struct replay_result
+{
+    uint64_t captures = 0, misses = 0;
+    double mean_age_us = 0, p99_age_us = 0;
+};
+
+/// <summary>
+/// Replays a trace. At each draw, the newest published capture is shown, the predictor learns about the draw, and
+/// then, as on present, the finished capture is reported and the next one is started, after the predicted delay when
+/// capturing late. A capture that is still running when the next draw comes keeps the worker busy, so no capture is
+/// started on that draw. A capture misses when any draw comes between waking the worker and publishing.
+/// </summary>
+static replay_result replay(const trace& input, bool late, capture_phase_predictor& predictor, uint32_t warm_up = 120)
+{
+    replay_result result;
+    std::vector<double> ages_us;
+    uint64_t now_us = 1000000;
+    bool pending = false;
+    uint64_t woken_us = 0, start_us = 0, publish_us = 0, shown_start_us = 0;
+    uint32_t draws_while_pending = 0;
+    for (size_t i = 0; i < input.frame_us.size(); i++)
+    {
+        now_us += input.frame_us[i];
+        const bool published = pending && publish_us <= now_us;
+        if (published)
+            shown_start_us = start_us;
+        predictor.on_draw(now_us);
+        if (i >= warm_up && shown_start_us != 0)
+            ages_us.push_back(double(now_us - shown_start_us));
+
+        if (pending && !published)
+        {
+            draws_while_pending++;
+            continue;
+        }
+        if (pending)
+        {
+            predictor.on_capture(publish_us - start_us, draws_while_pending != 0);
+            if (i >= warm_up)
+            {
+                result.captures++;
+                result.misses += draws_while_pending != 0;
+            }
+        }
+        woken_us = now_us;
+        start_us = woken_us + (late ? predictor.start_delay_us(woken_us) : 0);
+        publish_us = start_us + input.capture_us[i];
+        pending = true;
+        draws_while_pending = 0;
+    }
+    std::sort(ages_us.begin(), ages_us.end());
+    for (double age : ages_us)
+        result.mean_age_us += age / ages_us.size();
+    result.p99_age_us = ages_us.empty() ? 0 : ages_us[size_t(0.99 * (ages_us.size() - 1))];
+    return result;
+}
+
+/// <summary>
+/// Replays a trace with late captures and with captures right away, prints both, checks that capturing late never
+/// shows older images than capturing right away, and returns the late one.
+/// </summary>
+static replay_result compare(const trace& input)
+{
+    capture_phase_predictor late_predictor, immediate_predictor;
+    const replay_result late = replay(input, true, late_predictor);
+    const replay_result immediate = replay(input, false, immediate_predictor);
+    printf("%-30s late: %5.1f%% missed, age %6.0f us mean %6.0f us p99 | right away: %5.1f%% missed, age %6.0f us mean %6.0f us p99\n",
+        input.name, late.misses * 100.0 / std::max<uint64_t>(late.captures, 1), late.mean_age_us, late.p99_age_us,
+        immediate.misses * 100.0 / std::max<uint64_t>(immediate.captures, 1), immediate.mean_age_us, immediate.p99_age_us);
+    check(late.mean_age_us <= immediate.mean_age_us && late.p99_age_us <= immediate.p99_age_us,
+        "capturing late never shows older images than capturing right away");
+    return late;
+}
+
+static void test_waits_for_samples()
+{
+    capture_phase_predictor predictor;
+    for (uint32_t i = 0; i < capture_phase_predictor::MIN_SAMPLES; i++)
+        predictor.on_draw(1000000 + i * 16667);
+    for (uint32_t i = 0; i + 1 < capture_phase_predictor::MIN_SAMPLES; i++)
+        predictor.on_capture(2000, false);
+    check(predictor.start_delay_us(1200000) == 0, "captures start right away until enough captures were seen");
+    predictor.on_capture(2000, false);
+    for (uint32_t i = 0; i < 2; i++)
+        predictor.on_draw(1000000 + (capture_phase_predictor::MIN_SAMPLES + i) * 16667);
+    check(predictor.start_delay_us(1000000 + (capture_phase_predictor::MIN_SAMPLES + 1) * 16667) != 0, "captures start late once enough was seen");
+    predictor.reset();
+    check(predictor.start_delay_us(1200000) == 0 && predictor.frame_us() == 0 && predictor.next_draw_us() == 0, "reset() forgets everything");
+}
+
+static void test_frame_estimate()
+{
+    capture_phase_predictor predictor;
+    uint64_t now_us = 1000000;
+    for (uint32_t i = 0; i < 40; i++)
+        predictor.on_draw(now_us += 16667);
+    check(predictor.frame_us() == 16667 && predictor.next_draw_us() == now_us + 16667, "steady draws give the frame time");
+    predictor.on_draw(now_us += 50000);
+    check(predictor.frame_us() == 16667, "a single hitch doesn't change the frame time");
+    predictor.on_draw(now_us += capture_phase_predictor::MAX_FRAME_US + 1);
+    predictor.on_draw(now_us += 16667);
+    check(predictor.frame_us() == 16667, "a pause like a loading screen isn't taken as a frame time");
+    for (uint32_t i = 0; i < capture_phase_predictor::FRAME_SAMPLES; i++)
+        predictor.on_draw(now_us += 6944);
+    check(predictor.frame_us() == 6944, "a new frame rate takes over within the frame samples");
+}
+
+static void test_margin()
+{
+    capture_phase_predictor predictor;
+    check(predictor.margin_us() == capture_phase_predictor::MIN_MARGIN_US, "the margin starts at its minimum");
+    predictor.on_capture(2000, true);
+    check(predictor.margin_us() == 2 * capture_phase_predictor::MIN_MARGIN_US && predictor.misses() == 1, "a miss doubles the margin");
+    for (uint32_t i = 0; i < 10; i++)
+        predictor.on_capture(2000, true);
+    check(predictor.margin_us() == capture_phase_predictor::MAX_MARGIN_US, "the margin doesn't grow past its maximum");
+    const uint64_t before = predictor.margin_us();
+    for (uint32_t i = 0; i + 1 < capture_phase_predictor::SHRINK_AFTER_HITS; i++)
+        predictor.on_capture(2000, false);
+    check(predictor.margin_us() == before, "the margin holds until a run of hits");
+    predictor.on_capture(2000, false);
+    check(predictor.margin_us() == before - before / 4, "a run of hits shrinks the margin by a quarter");
+    for (uint32_t i = 0; i < 100 * capture_phase_predictor::SHRINK_AFTER_HITS; i++)
+        predictor.on_capture(2000, false);
+    check(predictor.margin_us() == capture_phase_predictor::MIN_MARGIN_US, "the margin doesn't shrink below its minimum");
+}
+
+/// <summary>Feeds a steady 60 Hz game and captures of the given duration and returns the delay at the next present.</summary>
+static uint64_t steady_delay_us(capture_phase_predictor& predictor, uint64_t capture_us, uint32_t misses)
+{
+    uint64_t now_us = 1000000;
+    for (uint32_t i = 0; i < capture_phase_predictor::CAPTURE_SAMPLES; i++)
+    {
+        predictor.on_draw(now_us += 16667);
+        predictor.on_capture(capture_us, i + misses >= capture_phase_predictor::CAPTURE_SAMPLES);
+    }
+    return predictor.start_delay_us(now_us);
+}
+
+static void test_falls_back_to_right_away()
+{
+    capture_phase_predictor predictor;
+    check(steady_delay_us(predictor, 2000, 0) == 16667 - 2000 - capture_phase_predictor::MIN_MARGIN_US, "a short capture starts just before the next draw");
+    predictor.reset();
+    check(steady_delay_us(predictor, 13000, 0) == 0, "a capture that takes up most of a frame starts right away");
+    predictor.reset();
+    check(steady_delay_us(predictor, 2000, capture_phase_predictor::MAX_RECENT_MISSES) != 0, "a single recent miss still starts late");
+    predictor.reset();
+    check(steady_delay_us(predictor, 2000, capture_phase_predictor::MAX_RECENT_MISSES + 1) == 0 && predictor.recent_misses() == 2,
+        "several recent misses start captures right away");
+    for (uint32_t i = 0; i < capture_phase_predictor::CAPTURE_SAMPLES; i++)
+        predictor.on_capture(2000, false);
+    check(predictor.recent_misses() == 0 && predictor.start_delay_us(predictor.next_draw_us() - 16667) != 0,
+        "late captures resume once the misses are old enough");
+}
+
+static void test_capture_estimate()
+{
+    capture_phase_predictor predictor;
+    for (uint64_t i = 1; i <= capture_phase_predictor::CAPTURE_SAMPLES; i++)
+        predictor.on_capture(i * 100, false);
+    check(predictor.capture_us() == 1800, "the capture time is the 90th percentile of the recent captures");
+    for (uint32_t i = 0; i < capture_phase_predictor::CAPTURE_SAMPLES; i++)
+        predictor.on_capture(500, false);
+    check(predictor.capture_us() == 500, "old captures are forgotten");
+}
+
+static void test_traces()
+{
+    const replay_result steady = compare(make_trace("60 Hz, steady", 3600, 16667, 100, 2000, 200));
+    check(steady.misses * 100 <= steady.captures * 2, "late captures rarely miss on a steady game");
+    check(steady.mean_age_us < 8000, "late captures make the image a lot younger on a steady game");
+
+    const replay_result jitter = compare(make_trace("60 Hz, 2 ms jitter", 3600, 16667, 2000, 2000, 500));
+    check(jitter.misses * 100 <= jitter.captures, "late captures seldom miss on a jittery game");
+    compare(make_trace("60 Hz, 5 ms jitter", 3600, 16667, 5000, 2000, 500));
+
+    const replay_result fast = compare(make_trace("144 Hz", 8640, 6944, 200, 2000, 300));
+    check(fast.misses * 100 <= fast.captures * 5, "late captures rarely miss at 144 Hz");
+
+    // Captures that take most of a frame leave no room to start late, so they start right away.
+    compare(make_trace("60 Hz, captures of 11 ms", 3600, 16667, 300, 11000, 1000));
+    const replay_result slow = compare(make_trace("60 Hz, captures of 15 ms", 3600, 16667, 100, 15000, 1500));
+    check(slow.misses == 0, "slow captures start right away and don't miss");
+
+    trace hitches = make_trace("60 Hz with hitches and loads", 3600, 16667, 300, 2000, 200);
+    for (size_t i = 200; i < hitches.frame_us.size(); i += 300)
+        hitches.frame_us[i] = i % 900 == 200 ? 500000 : 60000;
+    const replay_result hitched = compare(hitches);
+    check(hitched.misses * 100 <= hitched.captures, "hitches and loads don't throw the predictor off");
+
+    // A capture that suddenly takes much longer can't be predicted and misses, but only that one.
+    trace spikes = make_trace("60 Hz, a 12 ms capture in 250", 3600, 16667, 300, 2000, 200);
+    uint64_t spike_count = 0;
+    for (size_t i = 150; i < spikes.capture_us.size(); i += 250, spike_count++)
+        spikes.capture_us[i] = 12000;
+    const replay_result spiked = compare(spikes);
+    check(spiked.misses <= spike_count, "only the captures that suddenly take longer miss");
+
+    trace change = make_trace("60 Hz, then 144 Hz", 1800, 16667, 100, 2000, 200);
+    const trace faster = make_trace("", 4320, 6944, 100, 2000, 200);
+    change.frame_us.insert(change.frame_us.end(), faster.frame_us.begin(), faster.frame_us.end());
+    change.capture_us.insert(change.capture_us.end(), faster.capture_us.begin(), faster.capture_us.end());
+    const replay_result changed = compare(change);
+    check(changed.misses * 100 <= changed.captures * 5, "a change in frame rate only causes a few misses");
+
+    capture_phase_predictor first, second;
+    const replay_result a = replay(spikes, true, first), b = replay(spikes, true, second);
+    check(a.misses == b.misses && a.mean_age_us == b.mean_age_us && first.margin_us() == second.margin_us(),
+        "the same trace always gives the same result");
+}
+
+int main()
+{
+    test_waits_for_samples();
+    test_frame_estimate();
+    test_margin();
+    test_falls_back_to_right_away();
+    test_capture_estimate();
+    test_traces();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
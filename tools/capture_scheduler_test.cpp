@@ -0,0 +1,224 @@
+// Drives capture_scheduler with a scripted clock: fixed capture rates against games presenting at other rates,
+// calibrating "Match LiveSplit" from the median of the observed change intervals, dropping that estimate after the
+// recalibration interval, and backing off while LiveSplit doesn't change, up to the cap. Since the scheduler reads no
+// clock itself, every run gives the same result. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. capture_scheduler_test.cpp -o capture_scheduler_test
+//   ./capture_scheduler_test
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "../capture_scheduler.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>What happened while presenting frames against a scheduler.</summary>
+struct run_result
+{
+    uint64_t captures = 0;
+    uint64_t changes_seen = 0;
+    /// <summary>The longest time from a change in LiveSplit's image to the capture that saw it.</summary>
+    uint64_t max_delay_us = 0;
+};
+
+/// <summary>
+/// Presents frames at the given interval from start_us to end_us and captures whenever the scheduler says so, the
+/// way on_reshade_present does. A capture finishes on the next present and has changed if LiveSplit repainted with a
+/// different image since the previous capture, which happens at the given times.
+/// </summary>
+static run_result present(capture_scheduler& scheduler, uint64_t start_us, uint64_t end_us, uint64_t frame_us, const std::vector<uint64_t>& changes_us)
+{
+    run_result result;
+    bool pending = false;
+    uint64_t last_capture_us = start_us;
+    size_t next_change = 0;
+    while (next_change < changes_us.size() && changes_us[next_change] <= start_us)
+        next_change++;
+    for (uint64_t now_us = start_us; now_us < end_us; now_us += frame_us)
+    {
+        if (pending)
+        {
+            pending = false;
+            bool changed = false;
+            while (next_change < changes_us.size() && changes_us[next_change] <= last_capture_us)
+            {
+                result.max_delay_us = (std::max)(result.max_delay_us, last_capture_us - changes_us[next_change]);
+                changed = true;
+                next_change++;
+            }
+            result.changes_seen += changed;
+            scheduler.on_capture_finished(now_us, changed);
+        }
+        if (scheduler.is_due(now_us))
+        {
+            scheduler.on_capture_started(now_us);
+            last_capture_us = now_us;
+            pending = true;
+            result.captures++;
+        }
+    }
+    return result;
+}
+
+/// <summary>Times at which LiveSplit repaints with a different image, every interval from start_us to end_us.</summary>
+static std::vector<uint64_t> repaints(uint64_t start_us, uint64_t end_us, uint64_t interval_us)
+{
+    std::vector<uint64_t> times;
+    for (uint64_t time_us = start_us; time_us < end_us; time_us += interval_us)
+        times.push_back(time_us);
+    return times;
+}
+
+static void test_every_frame()
+{
+    capture_scheduler scheduler;
+    const run_result result = present(scheduler, 1000000, 2000000, 6944, {});
+    check(result.captures == 145 && scheduler.interval_us() == 0, "every frame is captured by default");
+}
+
+static void test_fixed_rates()
+{
+    capture_scheduler scheduler;
+    scheduler.configure(60, false);
+    check(scheduler.interval_us() == 16666, "60 Hz captures every 16.7 ms");
+    run_result result = present(scheduler, 1000000, 11000000, 6944, {});
+    check(result.captures >= 599 && result.captures <= 601, "60 Hz on a game at 144 Hz doesn't drift over 10 seconds");
+
+    scheduler.configure(30, false);
+    result = present(scheduler, 20000000, 30000000, 16667, {});
+    check(result.captures >= 299 && result.captures <= 301, "30 Hz on a game at 60 Hz captures every other frame");
+
+    scheduler.configure(120, false);
+    result = present(scheduler, 40000000, 50000000, 16667, {});
+    check(result.captures == 600, "a rate faster than the game captures every frame");
+
+    // Falling far behind restarts the schedule instead of catching up with a burst of captures.
+    scheduler.configure(60, false);
+    scheduler.on_capture_started(60000000);
+    scheduler.on_capture_started(60500000);
+    check(!scheduler.is_due(60500000 + 16665) && scheduler.is_due(60500000 + 16666), "a late capture restarts the schedule from its own time");
+}
+
+static void test_calibration()
+{
+    capture_scheduler scheduler;
+    scheduler.configure(capture_scheduler::RATE_MATCH_LIVESPLIT, false);
+    check(scheduler.interval_us() == 0 && scheduler.estimate_us() == 0, "LiveSplit's interval is measured by capturing every frame");
+
+    // Intervals with outliers on both sides, like a hitch and a double repaint; the median ignores them.
+    const uint64_t intervals_us[capture_scheduler::CALIBRATION_SAMPLES] =
+        { 33000, 34000, 250000, 33500, 1000, 33300, 33400, 33200, 2000, 33100, 900000, 33600, 33700, 32900, 33800 };
+    uint64_t now_us = 1000000;
+    scheduler.on_capture_finished(now_us, true);
+    scheduler.on_capture_finished(now_us + 500, false);
+    for (uint32_t i = 0; i < capture_scheduler::CALIBRATION_SAMPLES; i++)
+    {
+        check(scheduler.estimate_us() == 0, "no estimate before all intervals were observed");
+        now_us += intervals_us[i];
+        scheduler.on_capture_finished(now_us, true);
+    }
+    check(scheduler.estimate_us() == 33400 && scheduler.interval_us() == 33400, "the estimate is the median of the observed intervals");
+
+    const uint64_t estimated_us = now_us;
+    scheduler.on_capture_finished(estimated_us + capture_scheduler::RECALIBRATION_US - 1, true);
+    check(scheduler.estimate_us() == 33400, "the estimate is kept until the recalibration interval passed");
+    scheduler.on_capture_finished(estimated_us + capture_scheduler::RECALIBRATION_US, true);
+    check(scheduler.estimate_us() == 0 && scheduler.interval_us() == 0, "after the recalibration interval it is measured again");
+    scheduler.configure(capture_scheduler::RATE_MATCH_LIVESPLIT, false);
+    check(scheduler.estimate_us() == 0, "configure() forgets the estimate");
+}
+
+static void test_match_livesplit()
+{
+    // LiveSplit repaints at 30 Hz for a while, then at 20 Hz, and the game presents at 144 Hz.
+    capture_scheduler scheduler;
+    scheduler.configure(capture_scheduler::RATE_MATCH_LIVESPLIT, false);
+    std::vector<uint64_t> changes = repaints(1000000, 15000000, 33333);
+    const std::vector<uint64_t> slower = repaints(15000000, 40000000, 50000);
+    changes.insert(changes.end(), slower.begin(), slower.end());
+
+    present(scheduler, 1000000, 3000000, 6944, changes);
+    check(scheduler.estimate_us() >= 33333 - 6944 && scheduler.estimate_us() <= 33333 + 6944, "LiveSplit repainting at 30 Hz is measured at 30 Hz");
+    const run_result matched = present(scheduler, 3000000, 11000000, 6944, changes);
+    printf("match LiveSplit at 30 Hz: estimate %llu us, %llu captures in 8 s, %llu changes seen, at most %llu us late\n",
+        (unsigned long long)scheduler.estimate_us(), (unsigned long long)matched.captures, (unsigned long long)matched.changes_seen,
+        (unsigned long long)matched.max_delay_us);
+    check(matched.captures < 8 * 40, "the calibrated rate captures far less often than the game presents");
+
+    // The 10 s recalibration picks up the new rate within a few seconds after LiveSplit slowed down.
+    present(scheduler, 11000000, 30000000, 6944, changes);
+    check(scheduler.estimate_us() >= 50000 - 6944 && scheduler.estimate_us() <= 50000 + 6944, "a recalibration picks up a new repaint rate");
+}
+
+static void test_backoff()
+{
+    capture_scheduler scheduler;
+    scheduler.configure(60, true);
+    for (uint32_t i = 0; i < capture_scheduler::BACKOFF_THRESHOLD; i++)
+        scheduler.on_capture_finished(i, false);
+    check(scheduler.interval_us() == 16666, "a few identical captures don't back off yet");
+    scheduler.on_capture_finished(100, false);
+    check(scheduler.interval_us() == 2 * 16666, "every further identical capture doubles the interval");
+    scheduler.on_capture_finished(200, false);
+    check(scheduler.interval_us() == 4 * 16666, "and doubles it again");
+    for (uint32_t i = 0; i < 100; i++)
+        scheduler.on_capture_finished(300 + i, false);
+    check(scheduler.interval_us() == capture_scheduler::MAX_BACKOFF_US, "backing off stops at the cap");
+    scheduler.on_capture_finished(1000, true);
+    check(scheduler.interval_us() == 16666, "a change returns to the configured rate at once");
+
+    scheduler.configure(capture_scheduler::RATE_EVERY_FRAME, true);
+    for (uint32_t i = 0; i <= capture_scheduler::BACKOFF_THRESHOLD; i++)
+        scheduler.on_capture_finished(i, false);
+    check(scheduler.interval_us() == 2000, "capturing every frame backs off from a millisecond");
+    scheduler.configure(2, true);
+    for (uint32_t i = 0; i < 100; i++)
+        scheduler.on_capture_finished(i, false);
+    check(scheduler.interval_us() == 500000, "a rate slower than the cap isn't backed off");
+    scheduler.configure(60, false);
+    for (uint32_t i = 0; i < 100; i++)
+        scheduler.on_capture_finished(i, false);
+    check(scheduler.interval_us() == 16666, "without adaptive mode nothing backs off");
+
+    // A static LiveSplit for 10 s, then a change: the back off costs at most one capped interval of delay.
+    scheduler.configure(capture_scheduler::RATE_EVERY_FRAME, true);
+    const run_result idle = present(scheduler, 1000000, 11000000, 6944, { 10600000 });
+    printf("adaptive on a static LiveSplit: %llu captures in 10 s instead of 1440, a change seen %llu us late\n",
+        (unsigned long long)idle.captures, (unsigned long long)idle.max_delay_us);
+    check(idle.captures < 100, "a static LiveSplit is captured a few times a second at most");
+    check(idle.changes_seen == 1 && idle.max_delay_us <= capture_scheduler::MAX_BACKOFF_US + 6944, "a change after backing off is seen within the cap");
+}
+
+static void test_deterministic()
+{
+    const std::vector<uint64_t> changes = repaints(1000000, 20000000, 41000);
+    capture_scheduler first, second;
+    first.configure(capture_scheduler::RATE_MATCH_LIVESPLIT, true);
+    second.configure(capture_scheduler::RATE_MATCH_LIVESPLIT, true);
+    const run_result a = present(first, 1000000, 20000000, 6944, changes);
+    const run_result b = present(second, 1000000, 20000000, 6944, changes);
+    check(a.captures == b.captures && a.max_delay_us == b.max_delay_us && first.estimate_us() == second.estimate_us(),
+        "the same sequence of calls always gives the same schedule");
+}
+
+int main()
+{
+    test_every_frame();
+    test_fixed_rates();
+    test_calibration();
+    test_match_livesplit();
+    test_backoff();
+    test_deterministic();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
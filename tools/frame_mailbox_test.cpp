@@ -0,0 +1,190 @@
+// Checks frame_mailbox on its own and under a producer and a consumer thread that hammer it, then measures what
+// publishing and taking cost and how long a published frame waits for a consumer that polls. It only needs a C++17
+// compiler and threads, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -pthread -I.. frame_mailbox_test.cpp -o frame_mailbox_test
+//   ./frame_mailbox_test
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../frame_mailbox.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static uint64_t now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(benchmark_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>A frame whose payload is filled with its generation, so that a torn frame shows.</summary>
+struct test_frame
+{
+    uint64_t generation = 0;
+    uint64_t published_ns = 0;
+    std::vector<uint64_t> payload;
+};
+
+static void test_single_thread()
+{
+    frame_mailbox<test_frame> mailbox;
+    check(!mailbox.take(), "nothing can be taken before a publish");
+    check(mailbox.back_index() != mailbox.front_index(), "producer and consumer start on different slots");
+
+    mailbox.back().generation = 1;
+    mailbox.publish();
+    check(mailbox.take() && mailbox.front().generation == 1, "a published frame can be taken");
+    check(!mailbox.take() && mailbox.front().generation == 1, "a frame is only taken once and stays in front");
+
+    mailbox.back().generation = 2;
+    mailbox.publish();
+    mailbox.back().generation = 3;
+    mailbox.publish();
+    check(mailbox.take() && mailbox.front().generation == 3, "the newest frame wins, older ones are dropped");
+
+    for (int i = 0; i < 10; i++)
+    {
+        check(mailbox.back_index() != mailbox.front_index(), "the back slot is never the front slot");
+        mailbox.back().generation = 4 + i;
+        mailbox.publish();
+        if (i % 3 == 0)
+            mailbox.take();
+    }
+}
+
+/// <summary>
+/// Lets a producer publish as fast as it can while a consumer takes as fast as it can, and checks that every frame
+/// the consumer sees is complete and newer than the one before.
+/// </summary>
+static void test_stress(double duration_s)
+{
+    frame_mailbox<test_frame> mailbox;
+    std::atomic<bool> stop(false);
+    std::thread producer([&]()
+    {
+        for (uint64_t generation = 1; !stop.load(std::memory_order_relaxed); generation++)
+        {
+            test_frame& frame = mailbox.back();
+            frame.payload.resize(64 + generation % 64);
+            std::fill(frame.payload.begin(), frame.payload.end(), generation);
+            frame.generation = generation;
+            mailbox.publish();
+            // Give a consumer on the same core a chance to run in the middle of the producer's work.
+            if (generation % 256 == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    uint64_t takes = 0, torn = 0, out_of_order = 0, previous = 0;
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    while (std::chrono::duration<double>(benchmark_clock::now() - start).count() < duration_s)
+    {
+        if (!mailbox.take())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const test_frame& frame = mailbox.front();
+        takes++;
+        if (frame.payload.size() != 64 + frame.generation % 64
+            || std::any_of(frame.payload.begin(), frame.payload.end(), [&](uint64_t value) { return value != frame.generation; }))
+            torn++;
+        if (frame.generation <= previous)
+            out_of_order++;
+        previous = frame.generation;
+    }
+    stop = true;
+    producer.join();
+
+    printf("stress: %llu frames published, %llu taken, %llu torn, %llu out of order\n", (unsigned long long)previous,
+        (unsigned long long)takes, (unsigned long long)torn, (unsigned long long)out_of_order);
+    check(takes > 0, "the consumer got frames under load");
+    check(torn == 0, "the consumer never sees a frame the producer is writing");
+    check(out_of_order == 0, "the consumer never sees an older frame after a newer one");
+}
+
+/// <summary>Measures publish() and take() on one thread, which is their cost without contention.</summary>
+static void measure_operations(uint32_t count)
+{
+    frame_mailbox<test_frame> mailbox;
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        mailbox.back().generation = i;
+        mailbox.publish();
+        mailbox.take();
+    }
+    const double seconds = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+    printf("publish and take on one thread: %.1f ns per pair\n", seconds * 1e9 / count);
+}
+
+/// <summary>
+/// Publishes at the given rate and lets the consumer poll at the given interval, like a render thread that takes on
+/// every present, and reports how long frames waited until they were taken.
+/// </summary>
+static void measure_latency(uint32_t frames_per_second, uint32_t poll_interval_us, double duration_s)
+{
+    frame_mailbox<test_frame> mailbox;
+    std::atomic<bool> stop(false);
+    std::thread producer([&]()
+    {
+        const auto interval = std::chrono::nanoseconds(1000000000 / frames_per_second);
+        benchmark_clock::time_point next = benchmark_clock::now();
+        for (uint64_t generation = 1; !stop.load(std::memory_order_relaxed); generation++)
+        {
+            std::this_thread::sleep_until(next);
+            next += interval;
+            mailbox.back().generation = generation;
+            mailbox.back().published_ns = now_ns();
+            mailbox.publish();
+        }
+    });
+
+    std::vector<double> latencies_us;
+    uint64_t previous = 0, dropped = 0;
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    while (std::chrono::duration<double>(benchmark_clock::now() - start).count() < duration_s)
+    {
+        if (poll_interval_us != 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(poll_interval_us));
+        if (!mailbox.take())
+            continue;
+        latencies_us.push_back((now_ns() - mailbox.front().published_ns) / 1000.0);
+        dropped += mailbox.front().generation - previous - 1;
+        previous = mailbox.front().generation;
+    }
+    stop = true;
+    producer.join();
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    const auto percentile = [&](double p) { return latencies_us.empty() ? 0 : latencies_us[size_t(p * (latencies_us.size() - 1))]; };
+    printf("%5u frames/s, polled every %5u us: %6zu taken, %5llu dropped, latency p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+        frames_per_second, poll_interval_us, latencies_us.size(), (unsigned long long)dropped, percentile(0.5), percentile(0.99), percentile(1));
+}
+
+int main()
+{
+    test_single_thread();
+    test_stress(2);
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_operations(10000000);
+    measure_latency(60, 0, 1);
+    measure_latency(60, 6944, 1);
+    measure_latency(1000, 1000, 1);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// Checks image_scaler against straightforward floating point versions of its filters, at the scales the add-on offers
+// and below, and measures how fast it shrinks LiveSplit images and how much smaller their uploads get. It only needs a
+// C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. image_scaler_benchmark.cpp -o image_scaler_benchmark
+//   ./image_scaler_benchmark
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../image_scaler.h"
+#include "../synthetic_frame_source.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>A tightly packed BGRX image.</summary>
+struct test_image
+{
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> pixels;
+
+    test_image(uint32_t width, uint32_t height) : width(width), height(height), pixels(size_t(width) * 4 * height)
+    {
+    }
+
+    size_t pitch() const
+    {
+        return size_t(width) * 4;
+    }
+
+    uint8_t at(uint32_t x, uint32_t y, uint32_t channel) const
+    {
+        return pixels[y * pitch() + x * 4 + channel];
+    }
+};
+
+static test_image noise_image(uint32_t width, uint32_t height)
+{
+    test_image image(width, height);
+    std::mt19937 random(42);
+    for (uint8_t& byte : image.pixels)
+        byte = uint8_t(random());
+    return image;
+}
+
+static test_image livesplit_image(uint32_t width, uint32_t split_count, uint32_t scale)
+{
+    synthetic_frame_source source;
+    source.configure(width, split_count, scale);
+    test_image image(source.width(), source.height(0));
+    source.render(12345678, image.height, image.pixels.data(), image.pitch());
+    return image;
+}
+
+/// <summary>Averages the same source rectangles that the box filter assigns to each destination pixel.</summary>
+static test_image box_reference(const test_image& src, uint32_t width, uint32_t height)
+{
+    test_image dst(width, height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint32_t top = uint32_t(uint64_t(y) * src.height / height);
+        const uint32_t bottom = std::min(std::max(uint32_t(uint64_t(y + 1) * src.height / height), top + 1), top + image_scaler::MAX_BOX_ROWS);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const uint32_t left = uint32_t(uint64_t(x) * src.width / width);
+            const uint32_t right = std::max(uint32_t(uint64_t(x + 1) * src.width / width), left + 1);
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                double sum = 0;
+                for (uint32_t row = top; row < bottom; row++)
+                    for (uint32_t column = left; column < right; column++)
+                        sum += src.at(column, row, channel);
+                dst.pixels[y * dst.pitch() + x * 4 + channel] = uint8_t(std::floor(sum / ((right - left) * (bottom - top)) + 0.5));
+            }
+        }
+    }
+    return dst;
+}
+
+/// <summary>
+/// Interpolates at the pixel centers of the destination, with the positions rounded to the 1/256 of a pixel that the
+/// scaler works with, and below half the size from the box reference at twice the destination size.
+/// </summary>
+static test_image bilinear_reference(const test_image& original, uint32_t width, uint32_t height)
+{
+    const test_image src = original.width > width * 2 || original.height > height * 2
+        ? box_reference(original, std::min(original.width, width * 2), std::min(original.height, height * 2)) : original;
+    const auto position = [](uint32_t index, uint32_t src_size, uint32_t dst_size)
+    {
+        const double center = (index + 0.5) * src_size / dst_size - 0.5;
+        return std::min(std::max(std::floor(center * 256 + 0.5) / 256, 0.0), double(src_size - 1));
+    };
+    test_image dst(width, height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const double sy = position(y, src.height, height);
+        const uint32_t row = uint32_t(sy), next_row = std::min(row + 1, src.height - 1);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const double sx = position(x, src.width, width);
+            const uint32_t column = uint32_t(sx), next_column = std::min(column + 1, src.width - 1);
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                const double top = src.at(column, row, channel) * (1 - (sx - column)) + src.at(next_column, row, channel) * (sx - column);
+                const double bottom = src.at(column, next_row, channel) * (1 - (sx - column)) + src.at(next_column, next_row, channel) * (sx - column);
+                dst.pixels[y * dst.pitch() + x * 4 + channel] = uint8_t(std::floor(top * (1 - (sy - row)) + bottom * (sy - row) + 0.5));
+            }
+        }
+    }
+    return dst;
+}
+
+static int max_difference(const test_image& a, const test_image& b)
+{
+    int difference = 0;
+    for (size_t i = 0; i < a.pixels.size(); i++)
+        difference = std::max(difference, std::abs(int(a.pixels[i]) - int(b.pixels[i])));
+    return difference;
+}
+
+static test_image scale_image(image_scaler& scaler, const test_image& src, float scale, image_scaler::filter mode)
+{
+    test_image dst(image_scaler::scaled_size(src.width, scale), image_scaler::scaled_size(src.height, scale));
+    scaler.scale(src.pixels.data(), src.width, src.height, src.pitch(), dst.pixels.data(), dst.width, dst.height, dst.pitch(), mode);
+    return dst;
+}
+
+static void test_against_reference(const char* name, const test_image& src)
+{
+    image_scaler scaler;
+    for (float scale : { 1.0f, 0.75f, 0.5f, 0.4f, 0.25f })
+    {
+        const test_image box = scale_image(scaler, src, scale, image_scaler::FILTER_BOX);
+        const test_image bilinear = scale_image(scaler, src, scale, image_scaler::FILTER_BILINEAR);
+        const int box_difference = max_difference(box, box_reference(src, box.width, box.height));
+        const int bilinear_difference = max_difference(bilinear, bilinear_reference(src, bilinear.width, bilinear.height));
+        printf("%-8s %4ux%-4u at %.2f: box off by at most %d, bilinear by at most %d\n", name, src.width, src.height, scale,
+            box_difference, bilinear_difference);
+        check(box_difference <= 1, "the box filter is within 1 of the reference");
+        check(bilinear_difference <= 1, "the bilinear filter is within 1 of the reference");
+        if (scale == 1)
+            check(box.pixels == src.pixels && bilinear.pixels == src.pixels, "both filters keep an image at its size as it is");
+    }
+}
+
+static void test_odd_sizes()
+{
+    image_scaler scaler;
+    const test_image src = noise_image(37, 23);
+    bool within = true;
+    for (uint32_t height = 1; height <= src.height; height += 3)
+    {
+        for (uint32_t width = 1; width <= src.width; width += 2)
+        {
+            test_image box(width, height), bilinear(width, height);
+            scaler.scale(src.pixels.data(), src.width, src.height, src.pitch(), box.pixels.data(), width, height, box.pitch(), image_scaler::FILTER_BOX);
+            scaler.scale(src.pixels.data(), src.width, src.height, src.pitch(), bilinear.pixels.data(), width, height, bilinear.pitch(), image_scaler::FILTER_BILINEAR);
+            within &= max_difference(box, box_reference(src, width, height)) <= 1;
+            within &= max_difference(bilinear, bilinear_reference(src, width, height)) <= 1;
+        }
+    }
+    check(within, "every destination size matches the reference, including a single row or column");
+}
+
+/// <summary>
+/// Scales a LiveSplit image over and over and reports the source throughput, the time per frame and how many bytes
+/// a full upload of the result takes, which is what scaling on the CPU saves at most.
+/// </summary>
+static void measure_scaler(const char* name, const test_image& src, uint32_t count)
+{
+    image_scaler scaler;
+    for (image_scaler::filter mode : { image_scaler::FILTER_BOX, image_scaler::FILTER_BILINEAR })
+    {
+        for (float scale : { 1.0f, 0.75f, 0.5f, 0.4f, 0.25f })
+        {
+            test_image dst(image_scaler::scaled_size(src.width, scale), image_scaler::scaled_size(src.height, scale));
+            const benchmark_clock::time_point start = benchmark_clock::now();
+            for (uint32_t i = 0; i < count; i++)
+                scaler.scale(src.pixels.data(), src.width, src.height, src.pitch(), dst.pixels.data(), dst.width, dst.height, dst.pitch(), mode);
+            const double seconds = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+            printf("%-12s %4ux%-4u %-8s at %.2f: %6.0f MiB/s  %7.1f us/frame  %7.1f KiB to upload (%s)\n", name, src.width, src.height,
+                mode == image_scaler::FILTER_BOX ? "box" : "bilinear", scale, src.pixels.size() * double(count) / 1048576.0 / seconds,
+                seconds * 1000000 / count, dst.pixels.size() / 1024.0, scale < image_scaler::MIN_GPU_SCALE ? "scaled on the CPU" : "left to the GPU");
+        }
+    }
+}
+
+int main()
+{
+    test_against_reference("noise", noise_image(301, 157));
+    test_against_reference("splits", livesplit_image(300, 15, 2));
+    test_odd_sizes();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_scaler("splits", livesplit_image(300, 15, 1), 1000);
+    measure_scaler("splits, 4K", livesplit_image(300, 15, 2), 250);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+// Checks livesplit_server_client against a stand-in for the LiveSplit Server component on localhost, which answers
+// the four commands the client sends, and can also answer byte by byte, stay silent, hang up or send something that
+// isn't LiveSplit's answer. Then it measures how long a poll takes. It needs a C++17 compiler, threads and POSIX
+// sockets, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -pthread -I.. livesplit_server_test.cpp -o livesplit_server_test
+//   ./livesplit_server_test
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../livesplit_server.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static uint64_t real_clock_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(benchmark_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>A clock that only moves when the test says so, offset so that 0 never comes up as a time.</summary>
+static uint64_t g_fake_now_us = 1000000;
+
+static uint64_t fake_clock_us()
+{
+    return g_fake_now_us;
+}
+
+/// <summary>Answers the commands of livesplit_server_client the way LiveSplit's server component does.</summary>
+class stand_in_server
+{
+public:
+    enum behavior
+    {
+        ANSWER,
+        /// <summary>Sends each answer one byte at a time, so that lines arrive in pieces.</summary>
+        ANSWER_IN_PIECES,
+        STAY_SILENT,
+        /// <summary>Closes the connection when a command arrives.</summary>
+        HANG_UP,
+        /// <summary>Answers with a timer phase that LiveSplit doesn't have.</summary>
+        ANSWER_GARBAGE
+    };
+
+    stand_in_server()
+    {
+        _listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(_listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(_listener, 4) != 0
+            || getsockname(_listener, (sockaddr*)&address, &length) != 0)
+        {
+            printf("Can't listen on localhost.\n");
+            exit(1);
+        }
+        port = ntohs(address.sin_port);
+        _thread = std::thread([this]() { run(); });
+    }
+
+    ~stand_in_server()
+    {
+        _stop = true;
+        shutdown(_listener, SHUT_RDWR);
+        close(_listener);
+        _thread.join();
+    }
+
+    uint16_t port = 0;
+    std::atomic<uint32_t> connections{ 0 };
+
+    void set_behavior(behavior value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _behavior = value;
+    }
+
+    void set_answers(const char* new_phase, const char* new_time, const char* new_split_index, const char* new_split_name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _phase = new_phase;
+        _time = new_time;
+        _split_index = new_split_index;
+        _split_name = new_split_name;
+    }
+
+private:
+    int _listener = -1;
+    std::thread _thread;
+    std::atomic<bool> _stop{ false };
+    std::mutex _mutex;
+    behavior _behavior = ANSWER;
+    /// <summary>The answers to the four commands.</summary>
+    std::string _phase = "Running", _time = "1:02.3400000", _split_index = "2", _split_name = "Forest";
+
+    void run()
+    {
+        while (!_stop)
+        {
+            const int client = accept(_listener, nullptr, nullptr);
+            if (client < 0)
+                break;
+            connections++;
+            // Wake up now and then to notice when the test is over.
+            const timeval timeout = { 0, 100000 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+            // Each answer goes out on its own, which Nagle's algorithm would hold back until the client acknowledges.
+            const int no_delay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+            serve(client);
+            close(client);
+        }
+    }
+
+    void serve(int client)
+    {
+        std::string received;
+        while (!_stop)
+        {
+            char buffer[512];
+            const ssize_t length = recv(client, buffer, sizeof(buffer), 0);
+            if (length == 0)
+                return;
+            if (length < 0)
+                continue;
+            received.append(buffer, size_t(length));
+            size_t end;
+            while ((end = received.find('\n')) != std::string::npos)
+            {
+                const std::string command = received.substr(0, end != 0 && received[end - 1] == '\r' ? end - 1 : end);
+                received.erase(0, end + 1);
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_behavior == HANG_UP)
+                    return;
+                if (_behavior == STAY_SILENT)
+                    continue;
+                std::string answer = command == "getcurrenttimerphase" ? (_behavior == ANSWER_GARBAGE ? "Sleeping" : _phase)
+                    : command == "getcurrenttime" ? _time : command == "getsplitindex" ? _split_index
+                    : command == "getcurrentsplitname" ? _split_name : "";
+                answer += "\r\n";
+                if (_behavior == ANSWER_IN_PIECES)
+                {
+                    for (char c : answer)
+                        send(client, &c, 1, MSG_NOSIGNAL);
+                }
+                else
+                {
+                    send(client, answer.data(), answer.size(), MSG_NOSIGNAL);
+                }
+            }
+        }
+    }
+};
+
+static void test_parse_phase()
+{
+    timer_state::phase_type phase = timer_state::PHASE_RUNNING;
+    check(livesplit_server_client::parse_phase("NotRunning", phase) && phase == timer_state::PHASE_NOT_RUNNING, "NotRunning is parsed");
+    check(livesplit_server_client::parse_phase("Paused", phase) && phase == timer_state::PHASE_PAUSED, "Paused is parsed");
+    check(livesplit_server_client::parse_phase("Ended", phase) && phase == timer_state::PHASE_ENDED, "Ended is parsed");
+    check(!livesplit_server_client::parse_phase("running", phase) && !livesplit_server_client::parse_phase("", phase),
+        "unknown phases are rejected");
+}
+
+static void test_parse_time()
+{
+    const struct
+    {
+        const char* text;
+        bool valid;
+        int64_t time_us;
+    } cases[] = {
+        { "3.45", true, 3450000 },
+        { "2:03.45", true, 123450000 },
+        { "1:02:03.4500000", true, 3723450000 },
+        { "-1:02:03.4500000", true, -3723450000 },
+        { "-0:05.0000000", true, -5000000 },
+        { "00:00:00", true, 0 },
+        { "0.1234567", true, 123456 },
+        { "12.", true, 12000000 },
+        { "1:2:3:4", false, 0 },
+        { "-", false, 0 },
+        { "", false, 0 },
+        { "1:", false, 0 },
+        { "1.5s", false, 0 },
+        { ".5", false, 0 },
+    };
+    for (const auto& test : cases)
+    {
+        int64_t time_us = -1;
+        const bool valid = livesplit_server_client::parse_time(test.text, time_us);
+        if (valid != test.valid || (valid && time_us != test.time_us))
+        {
+            printf("FAILED: parse_time(\"%s\") gives %d, %lld\n", test.text, int(valid), (long long)time_us);
+            g_failures++;
+        }
+    }
+}
+
+static void test_timer_state()
+{
+    char text[32];
+    timer_state::format_time(3723450000, text, sizeof(text));
+    check(strcmp(text, "1:02:03.45") == 0, "hours are formatted with minutes and seconds");
+    timer_state::format_time(-5009999, text, sizeof(text));
+    check(strcmp(text, "-5.00") == 0, "negative times keep their sign and truncate to centiseconds");
+
+    timer_state running;
+    running.phase = timer_state::PHASE_RUNNING;
+    running.time_us = 1000000;
+    running.received_us = 500;
+    timer_state later = running;
+    later.time_us = 1200000;
+    later.received_us = 200500;
+    check(running.time_at(100500) == 1100000, "a running timer is extrapolated");
+    check(running.matches(later, 1000), "a running timer matches itself later on");
+    later.time_us += 5000;
+    check(!running.matches(later, 1000), "a timer that jumped doesn't match");
+    timer_state paused = running;
+    paused.phase = timer_state::PHASE_PAUSED;
+    check(paused.time_at(100500) == 1000000, "a paused timer stands still");
+}
+
+static void test_poll()
+{
+    stand_in_server server;
+    livesplit_server_client client(server.port);
+    timer_state state;
+    const uint64_t before_us = real_clock_us();
+    check(client.poll(&real_clock_us, state) && client.connected(), "the client connects and polls");
+    check(state.phase == timer_state::PHASE_RUNNING && state.time_us == 62340000 && state.split_index == 2 && state.split_name == "Forest",
+        "the answers end up in the timer state");
+    check(state.received_us >= before_us && state.received_us <= real_clock_us(), "the time of the answer lies within the poll");
+
+    server.set_answers("NotRunning", "-", "-1", "-");
+    check(client.poll(&real_clock_us, state), "a timer that doesn't run is polled");
+    check(state.phase == timer_state::PHASE_NOT_RUNNING && state.time_us == 0 && state.split_index == -1 && state.split_name.empty(),
+        "missing times and split names count as none");
+
+    server.set_answers("Paused", "-0:03.5000000", "0", "Intro");
+    server.set_behavior(stand_in_server::ANSWER_IN_PIECES);
+    check(client.poll(&real_clock_us, state) && state.time_us == -3500000 && state.split_name == "Intro", "answers that arrive in pieces are put together");
+    check(server.connections == 1, "polls share one connection");
+}
+
+static void test_bad_servers()
+{
+    stand_in_server server;
+    livesplit_server_client client(server.port);
+    timer_state state;
+    state.split_name = "untouched";
+
+    server.set_behavior(stand_in_server::ANSWER_GARBAGE);
+    check(!client.poll(&fake_clock_us, state) && !client.connected(), "a peer that isn't LiveSplit is dropped");
+    check(state.split_name == "untouched", "a failed poll leaves the timer state alone");
+
+    server.set_behavior(stand_in_server::ANSWER);
+    check(!client.poll(&fake_clock_us, state), "a dropped server isn't tried again right away");
+    g_fake_now_us += livesplit_server_client::RECONNECT_INTERVAL_US;
+    check(client.poll(&fake_clock_us, state) && server.connections == 2, "a dropped server is tried again after the interval");
+
+    server.set_behavior(stand_in_server::HANG_UP);
+    check(!client.poll(&fake_clock_us, state) && !client.connected(), "a server that hangs up is dropped");
+
+    server.set_behavior(stand_in_server::STAY_SILENT);
+    g_fake_now_us += livesplit_server_client::RECONNECT_INTERVAL_US;
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    check(!client.poll(&fake_clock_us, state) && !client.connected(), "a server that doesn't answer is dropped");
+    const double waited_ms = std::chrono::duration<double, std::milli>(benchmark_clock::now() - start).count();
+    check(waited_ms < livesplit_server_client::TIMEOUT_MS * 2, "a server that doesn't answer holds up a poll for the timeout at most");
+}
+
+static void test_no_server()
+{
+    uint16_t port;
+    {
+        stand_in_server server;
+        port = server.port;
+    }
+    livesplit_server_client client(port);
+    timer_state state;
+    g_fake_now_us += livesplit_server_client::RECONNECT_INTERVAL_US;
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    check(!client.poll(&fake_clock_us, state) && !client.connected(), "a missing server fails the poll");
+    check(std::chrono::duration<double, std::milli>(benchmark_clock::now() - start).count() < 50, "a missing server fails right away");
+}
+
+/// <summary>Polls the stand-in server over and over and reports how long a round trip takes.</summary>
+static void measure_polls(uint32_t count)
+{
+    stand_in_server server;
+    livesplit_server_client client(server.port);
+    timer_state state;
+    std::vector<double> durations_us;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const benchmark_clock::time_point start = benchmark_clock::now();
+        if (!client.poll(&real_clock_us, state))
+        {
+            printf("FAILED: a poll during the benchmark\n");
+            g_failures++;
+            return;
+        }
+        durations_us.push_back(std::chrono::duration<double, std::micro>(benchmark_clock::now() - start).count());
+    }
+    std::sort(durations_us.begin(), durations_us.end());
+    const auto percentile = [&](double p) { return durations_us[size_t(p * (durations_us.size() - 1))]; };
+    printf("%u polls over localhost: p50 %6.1f us  p99 %6.1f us  max %7.1f us\n", count, percentile(0.5), percentile(0.99), percentile(1));
+}
+
+int main()
+{
+    test_parse_phase();
+    test_parse_time();
+    test_timer_state();
+    test_poll();
+    test_bad_servers();
+    test_no_server();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_polls(2000);
+    return g_failures == 0 ? 0 : 1;
+}
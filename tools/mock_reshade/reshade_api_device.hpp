@@ -0,0 +1,202 @@
+// Declares the part of ReShade's API that frame_upload.h uses, the way ReShade's own reshade_api_device.hpp does, so
+// that the tools can run the add-on's upload path against a stand-in device without ReShade or Windows. Only the
+// names, parameters and semantics matter here; the enum values are made up. Build with -Imock_reshade to use it.
+
+#pragma once
+
+#include <cstdint>
+
+namespace reshade::api
+{
+    enum class device_api
+    {
+        d3d9 = 0x9000,
+        d3d10 = 0xa000,
+        d3d11 = 0xb000,
+        d3d12 = 0xc000,
+        opengl = 0x10000,
+        vulkan = 0x20000
+    };
+
+    enum class format : uint32_t
+    {
+        unknown = 0,
+        b8g8r8a8_unorm = 87
+    };
+
+    enum class memory_heap : uint32_t
+    {
+        unknown,
+        gpu_only,
+        cpu_to_gpu,
+        gpu_to_cpu,
+        cpu_only
+    };
+
+    enum class resource_usage : uint32_t
+    {
+        undefined = 0,
+        shader_resource_pixel = 0x80,
+        shader_resource_non_pixel = 0x40,
+        shader_resource = 0xc0,
+        copy_dest = 0x400,
+        copy_source = 0x800,
+        cpu_access = 0x10000
+    };
+
+    constexpr resource_usage operator|(resource_usage lhs, resource_usage rhs)
+    {
+        return resource_usage(uint32_t(lhs) | uint32_t(rhs));
+    }
+
+    enum class resource_flags : uint32_t
+    {
+        none = 0,
+        dynamic = 0x8
+    };
+
+    enum class resource_type : uint32_t
+    {
+        unknown,
+        buffer,
+        texture_2d
+    };
+
+    enum class map_access
+    {
+        read_only,
+        write_only,
+        read_write,
+        write_discard
+    };
+
+    enum class fence_flags : uint32_t
+    {
+        none = 0
+    };
+
+    struct resource_desc
+    {
+        resource_desc(uint64_t size, memory_heap heap, resource_usage usage, resource_flags flags = resource_flags::none) :
+            type(resource_type::buffer), heap(heap), usage(usage), flags(flags)
+        {
+            buffer.size = size;
+        }
+
+        resource_desc(uint32_t width, uint32_t height, uint16_t layers, uint16_t levels, format format, uint16_t samples,
+            memory_heap heap, resource_usage usage, resource_flags flags = resource_flags::none) :
+            type(resource_type::texture_2d), heap(heap), usage(usage), flags(flags)
+        {
+            texture.width = width;
+            texture.height = height;
+            texture.depth_or_layers = layers;
+            texture.levels = levels;
+            texture.format = format;
+            texture.samples = samples;
+        }
+
+        resource_type type;
+        union
+        {
+            struct
+            {
+                uint64_t size;
+            } buffer;
+            struct
+            {
+                uint32_t width;
+                uint32_t height;
+                uint16_t depth_or_layers;
+                uint16_t levels;
+                reshade::api::format format;
+                uint16_t samples;
+            } texture;
+        };
+        memory_heap heap;
+        resource_usage usage;
+        resource_flags flags;
+    };
+
+    struct resource_view_desc
+    {
+        resource_view_desc(reshade::api::format format) : format(format)
+        {
+        }
+
+        reshade::api::format format;
+    };
+
+    struct resource
+    {
+        uint64_t handle;
+    };
+
+    struct resource_view
+    {
+        uint64_t handle;
+    };
+
+    struct fence
+    {
+        uint64_t handle;
+    };
+
+    struct subresource_data
+    {
+        void* data;
+        uint32_t row_pitch;
+        uint32_t slice_pitch;
+    };
+
+    struct subresource_box
+    {
+        int32_t left, top, front;
+        int32_t right, bottom, back;
+    };
+
+    struct device
+    {
+        virtual device_api get_api() const = 0;
+
+        virtual bool create_resource(const resource_desc& desc, const subresource_data* initial_data, resource_usage initial_state, resource* out_handle, void** shared_handle = nullptr) = 0;
+        virtual void destroy_resource(resource handle) = 0;
+        virtual bool create_resource_view(resource resource, resource_usage usage_type, const resource_view_desc& desc, resource_view* out_handle) = 0;
+        virtual void destroy_resource_view(resource_view handle) = 0;
+
+        virtual bool map_buffer_region(resource resource, uint64_t offset, uint64_t size, map_access access, void** out_data) = 0;
+        virtual void unmap_buffer_region(resource resource) = 0;
+        virtual bool map_texture_region(resource resource, uint32_t subresource, const subresource_box* box, map_access access, subresource_data* out_data) = 0;
+        virtual void unmap_texture_region(resource resource, uint32_t subresource) = 0;
+
+        virtual bool create_fence(uint64_t initial_value, fence_flags flags, fence* out_handle, void** shared_handle = nullptr) = 0;
+        virtual void destroy_fence(fence handle) = 0;
+        virtual uint64_t get_completed_fence_value(fence fence) const = 0;
+
+    protected:
+        ~device() = default;
+    };
+
+    struct command_list
+    {
+        virtual void barrier(uint32_t count, const resource* resources, const resource_usage* old_states, const resource_usage* new_states) = 0;
+        void barrier(resource resource, resource_usage old_state, resource_usage new_state)
+        {
+            barrier(1, &resource, &old_state, &new_state);
+        }
+
+        virtual void copy_buffer_to_texture(resource source, uint64_t source_offset, uint32_t row_length, uint32_t slice_height, resource dest, uint32_t dest_subresource, const subresource_box* dest_box = nullptr) = 0;
+
+    protected:
+        ~command_list() = default;
+    };
+
+    struct command_queue
+    {
+        virtual void flush_immediate_command_list() const = 0;
+        virtual command_list* get_immediate_command_list() = 0;
+        virtual bool signal(fence fence, uint64_t value) = 0;
+
+    protected:
+        ~command_queue() = default;
+    };
+}
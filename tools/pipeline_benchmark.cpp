@@ -0,0 +1,731 @@
+// Runs synthetic LiveSplit layouts through the whole path a frame takes, without a game or a GPU: rendering in place
+// of the capture, change detection, scaling, the mailbox between the worker and the render thread, the texture pool
+// that follows LiveSplit's resizes, the add-on's own upload code from frame_upload.h with background keying, and the
+// quads the texture is drawn with. The GPU is a mock of ReShade's device and command queue that carries out
+// copies, mapped writes, signals and draws a few frames after they were submitted. Every draw is checked against
+// the keyed frame it should show, and the mock reports what the add-on's upload code must never do: copying to a
+// texture in the wrong state, mapping part of a Direct3D texture, leaving commands unflushed or using a resource
+// after destroying it. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. -Imock_reshade pipeline_benchmark.cpp -o pipeline_benchmark
+//   ./pipeline_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "../frame_mailbox.h"
+#include "../frame_upload.h"
+#include "../image_scaler.h"
+#include "../resource_pool.h"
+#include "../synthetic_frame_source.h"
+
+using namespace reshade::api;
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>
+/// Stands in for a GPU behind ReShade's device interface. Resources live in host memory. Mapped textures are written
+/// through a shadow copy that reaches the texture in queue order once unmapped, the way drivers rename dynamic
+/// textures, while staging buffers are read when the GPU gets to the copy, so overwriting one that is still in
+/// flight shows up as a wrong image. Everything queued is only carried out a given number of frames later.
+/// </summary>
+class mock_device : public device
+{
+public:
+    /// <summary>Number of draws that didn't show the image they were meant to.</summary>
+    uint64_t mismatches = 0;
+    /// <summary>Number of calls that a real device would have rejected or misbehaved on.</summary>
+    uint64_t errors = 0;
+    uint64_t draws = 0;
+
+    mock_device(device_api api, uint32_t latency_frames) : _api(api), _latency_frames(latency_frames)
+    {
+    }
+
+    device_api get_api() const override
+    {
+        return _api;
+    }
+
+    bool create_resource(const resource_desc& desc, const subresource_data*, resource_usage initial_state, resource* out_handle, void** = nullptr) override
+    {
+        mock_resource created = { desc, initial_state, {}, {}, 0, false, {} };
+        if (desc.type == resource_type::buffer)
+        {
+            created.memory.assign(size_t(desc.buffer.size), 0);
+        }
+        else
+        {
+            // Give mapped textures padded rows, so that a pitch mixed up with the width shows up.
+            created.row_pitch = (desc.texture.width * 4 + 255) / 256 * 256;
+            created.memory.assign(size_t(created.row_pitch) * desc.texture.height, 0);
+            if (desc.heap != memory_heap::gpu_only)
+                created.shadow = created.memory;
+        }
+        *out_handle = { _next_handle++ };
+        _resources.emplace(out_handle->handle, std::move(created));
+        return true;
+    }
+
+    void destroy_resource(resource handle) override
+    {
+        if (_resources.erase(handle.handle) == 0)
+            error("destroyed a resource that doesn't exist");
+    }
+
+    bool create_resource_view(resource resource, resource_usage, const resource_view_desc&, resource_view* out_handle) override
+    {
+        *out_handle = { _next_handle++ };
+        _views[out_handle->handle] = resource.handle;
+        return true;
+    }
+
+    void destroy_resource_view(resource_view handle) override
+    {
+        if (_views.erase(handle.handle) == 0)
+            error("destroyed a view that doesn't exist");
+    }
+
+    bool map_buffer_region(resource resource, uint64_t offset, uint64_t, map_access, void** out_data) override
+    {
+        mock_resource* const buffer = find(resource.handle);
+        if (buffer == nullptr || buffer->desc.type != resource_type::buffer || buffer->mapped)
+        {
+            error("mapped something that isn't an unmapped buffer");
+            return false;
+        }
+        buffer->mapped = true;
+        *out_data = buffer->memory.data() + offset;
+        return true;
+    }
+
+    void unmap_buffer_region(resource resource) override
+    {
+        mock_resource* const buffer = find(resource.handle);
+        if (buffer == nullptr || !buffer->mapped)
+            error("unmapped a buffer that isn't mapped");
+        else
+            buffer->mapped = false;
+    }
+
+    bool map_texture_region(resource resource, uint32_t, const subresource_box* box, map_access access, subresource_data* out_data) override
+    {
+        mock_resource* const texture = find(resource.handle);
+        if (texture == nullptr || texture->desc.type != resource_type::texture_2d || texture->shadow.empty() || texture->mapped)
+        {
+            error("mapped something that isn't an unmapped host-visible texture");
+            return false;
+        }
+        const bool direct3d = _api == device_api::d3d9 || _api == device_api::d3d10 || _api == device_api::d3d11 || _api == device_api::d3d12;
+        if (direct3d && (box != nullptr || access != map_access::write_discard))
+        {
+            error("Direct3D only maps whole dynamic textures with write_discard");
+            return false;
+        }
+        texture->box = box != nullptr ? *box : subresource_box { 0, 0, 0, int32_t(texture->desc.texture.width), int32_t(texture->desc.texture.height), 1 };
+        // The previous contents are gone, which garbage makes sure of.
+        if (access == map_access::write_discard)
+            std::fill(texture->shadow.begin(), texture->shadow.end(), uint8_t(0xcd));
+        texture->mapped = true;
+        *out_data = { texture->shadow.data() + texture->box.top * texture->row_pitch + texture->box.left * 4, texture->row_pitch, 0 };
+        return true;
+    }
+
+    void unmap_texture_region(resource resource, uint32_t) override
+    {
+        mock_resource* const texture = find(resource.handle);
+        if (texture == nullptr || !texture->mapped)
+        {
+            error("unmapped a texture that isn't mapped");
+            return;
+        }
+        texture->mapped = false;
+        command update = { command::UPDATE, _frame, resource.handle };
+        update.box = texture->box;
+        const size_t row_size = size_t(update.box.right - update.box.left) * 4;
+        for (int32_t y = update.box.top; y < update.box.bottom; y++)
+        {
+            const uint8_t* const row = texture->shadow.data() + y * texture->row_pitch + update.box.left * 4;
+            update.data.insert(update.data.end(), row, row + row_size);
+        }
+        _queue.push_back(std::move(update));
+    }
+
+    bool create_fence(uint64_t initial_value, fence_flags, fence* out_handle, void** = nullptr) override
+    {
+        *out_handle = { _next_handle++ };
+        _fences[out_handle->handle] = initial_value;
+        return true;
+    }
+
+    void destroy_fence(fence handle) override
+    {
+        _fences.erase(handle.handle);
+    }
+
+    uint64_t get_completed_fence_value(fence fence) const override
+    {
+        const auto it = _fences.find(fence.handle);
+        return it != _fences.end() ? it->second : 0;
+    }
+
+    /// <summary>Queues a draw of the part of a texture that a quad covers, which should show the given image.</summary>
+    /// <param name="expected">The keyed frame as tightly packed rows, or nothing to only draw it.</param>
+    void draw(resource_view view, const draw_quad& quad, float display_width, float display_height, uint32_t width, uint32_t height,
+        std::shared_ptr<const std::vector<uint8_t>> expected)
+    {
+        if (quad.left < 0 || quad.top < 0 || quad.right > display_width || quad.bottom > display_height)
+            error("drew a quad that doesn't fit on screen");
+        command draw = { command::DRAW, _frame, view.handle };
+        draw.quad = quad;
+        draw.width = width;
+        draw.height = height;
+        draw.expected = std::move(expected);
+        _queue.push_back(std::move(draw));
+    }
+
+    /// <summary>Lets the GPU carry out everything that was submitted long enough ago.</summary>
+    void end_frame()
+    {
+        _frame++;
+        if (_frame >= _latency_frames)
+            execute(_frame - _latency_frames);
+    }
+
+    /// <summary>Waits for the GPU to be done with everything.</summary>
+    void finish()
+    {
+        execute(UINT64_MAX);
+    }
+
+    /// <summary>The number of frames the host has submitted so far.</summary>
+    uint64_t frame() const
+    {
+        return _frame;
+    }
+
+    /// <summary>The last frame the GPU is done with, so that resources retired before it may be destroyed.</summary>
+    uint64_t completed_frame() const
+    {
+        return _completed_frame;
+    }
+
+    size_t live_resources() const
+    {
+        return _resources.size() + _views.size();
+    }
+
+private:
+    friend class mock_command_queue;
+
+    struct mock_resource
+    {
+        resource_desc desc;
+        resource_usage state;
+        /// <summary>What the GPU sees.</summary>
+        std::vector<uint8_t> memory;
+        /// <summary>What the host writes to a mapped texture.</summary>
+        std::vector<uint8_t> shadow;
+        uint32_t row_pitch;
+        bool mapped;
+        subresource_box box;
+    };
+
+    struct command
+    {
+        enum type_t { COPY, UPDATE, SIGNAL, DRAW };
+
+        command(type_t type, uint64_t frame, uint64_t target) : type(type), frame(frame), target(target)
+        {
+        }
+
+        type_t type;
+        uint64_t frame;
+        /// <summary>The texture to copy to or update, the view to draw or the fence to signal.</summary>
+        uint64_t target;
+        uint64_t source = 0;
+        uint64_t offset = 0;
+        uint32_t row_length = 0;
+        subresource_box box = {};
+        /// <summary>The rows of an update, or nothing.</summary>
+        std::vector<uint8_t> data;
+        uint64_t value = 0;
+        draw_quad quad = {};
+        uint32_t width = 0, height = 0;
+        std::shared_ptr<const std::vector<uint8_t>> expected;
+    };
+
+    const device_api _api;
+    const uint32_t _latency_frames;
+    uint64_t _frame = 0;
+    uint64_t _completed_frame = 0;
+    uint64_t _next_handle = 1;
+    std::map<uint64_t, mock_resource> _resources;
+    std::map<uint64_t, uint64_t> _views;
+    std::map<uint64_t, uint64_t> _fences;
+    std::deque<command> _queue;
+
+    mock_resource* find(uint64_t handle)
+    {
+        const auto it = _resources.find(handle);
+        return it != _resources.end() ? &it->second : nullptr;
+    }
+
+    void error(const char* what)
+    {
+        if (errors++ == 0)
+            printf("mock device: %s\n", what);
+    }
+
+    void execute(uint64_t last_frame)
+    {
+        while (!_queue.empty() && _queue.front().frame <= last_frame)
+        {
+            if (!execute(_queue.front()))
+                mismatches++;
+            _queue.pop_front();
+        }
+        _completed_frame = (std::min)(last_frame, _frame);
+    }
+
+    /// <returns>false if a draw didn't show the expected image.</returns>
+    bool execute(const command& next)
+    {
+        if (next.type == command::SIGNAL)
+        {
+            _fences[next.target] = next.value;
+            return true;
+        }
+        const auto view = _views.find(next.target);
+        mock_resource* const texture = find(next.type == command::DRAW ? (view != _views.end() ? view->second : 0) : next.target);
+        if (texture == nullptr)
+        {
+            error("the GPU used a resource after it was destroyed");
+            return true;
+        }
+
+        if (next.type == command::UPDATE)
+        {
+            const size_t row_size = size_t(next.box.right - next.box.left) * 4;
+            for (int32_t y = next.box.top; y < next.box.bottom; y++)
+                memcpy(texture->memory.data() + y * texture->row_pitch + next.box.left * 4, next.data.data() + (y - next.box.top) * row_size, row_size);
+        }
+        else if (next.type == command::COPY)
+        {
+            const mock_resource* const buffer = find(next.source);
+            if (buffer == nullptr)
+            {
+                error("the GPU copied from a buffer after it was destroyed");
+                return true;
+            }
+            const size_t row_size = size_t(next.box.right - next.box.left) * 4, buffer_pitch = size_t(next.row_length) * 4;
+            for (int32_t y = 0; y < next.box.bottom - next.box.top; y++)
+            {
+                memcpy(texture->memory.data() + (next.box.top + y) * texture->row_pitch + next.box.left * 4,
+                    buffer->memory.data() + next.offset + y * buffer_pitch, row_size);
+            }
+        }
+        else
+        {
+            draws++;
+            // The quad's texture coordinates must cover exactly the frame in the texture's top-left corner.
+            const uint32_t right = uint32_t(next.quad.u3 * texture->desc.texture.width + 0.5f);
+            const uint32_t bottom = uint32_t(next.quad.v3 * texture->desc.texture.height + 0.5f);
+            if (next.quad.u1 != 0 || next.quad.v1 != 0 || right != next.width || bottom != next.height)
+                return false;
+            if (next.expected == nullptr)
+                return true;
+            const size_t row_size = size_t(next.width) * 4;
+            for (uint32_t y = 0; y < next.height; y++)
+            {
+                if (memcmp(next.expected->data() + y * row_size, texture->memory.data() + y * texture->row_pitch, row_size) != 0)
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+/// <summary>
+/// Stands in for the command queue of the mock device and its immediate command list. Commands only reach the GPU
+/// once the command list is flushed, and the states that barriers move a texture between are checked.
+/// </summary>
+class mock_command_queue : public command_queue, public command_list
+{
+public:
+    explicit mock_command_queue(mock_device& device) : _device(device)
+    {
+    }
+
+    void flush_immediate_command_list() const override
+    {
+        for (mock_device::command& recorded : _recorded)
+        {
+            recorded.frame = _device._frame;
+            _device._queue.push_back(std::move(recorded));
+        }
+        _recorded.clear();
+    }
+
+    command_list* get_immediate_command_list() override
+    {
+        return this;
+    }
+
+    bool signal(fence fence, uint64_t value) override
+    {
+        if (!_recorded.empty())
+            _device.error("signaled with commands that weren't flushed");
+        mock_device::command signal = { mock_device::command::SIGNAL, _device._frame, fence.handle };
+        signal.value = value;
+        _device._queue.push_back(std::move(signal));
+        return true;
+    }
+
+    void barrier(uint32_t count, const resource* resources, const resource_usage* old_states, const resource_usage* new_states) override
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            mock_device::mock_resource* const texture = _device.find(resources[i].handle);
+            if (texture == nullptr || texture->state != old_states[i])
+                _device.error("a barrier started from the wrong state");
+            else
+                texture->state = new_states[i];
+        }
+    }
+
+    void copy_buffer_to_texture(resource source, uint64_t source_offset, uint32_t row_length, uint32_t, resource dest, uint32_t, const subresource_box* dest_box) override
+    {
+        const mock_device::mock_resource* const texture = _device.find(dest.handle);
+        if (texture == nullptr || texture->state != resource_usage::copy_dest || dest_box == nullptr)
+        {
+            _device.error("copied to a texture that isn't in the copy_dest state");
+            return;
+        }
+        mock_device::command copy = { mock_device::command::COPY, 0, dest.handle };
+        copy.source = source.handle;
+        copy.offset = source_offset;
+        copy.row_length = row_length;
+        copy.box = *dest_box;
+        _recorded.push_back(std::move(copy));
+    }
+
+    bool idle() const
+    {
+        return _recorded.empty();
+    }
+
+private:
+    mock_device& _device;
+    mutable std::vector<mock_device::command> _recorded;
+};
+
+/// <summary>
+/// Creates the textures of the benchmark's texture pool with the add-on's own code. A replaced texture is destroyed
+/// once the GPU caught up with the frame it was replaced in.
+/// </summary>
+class mock_texture_factory : public resource_factory<livesplit_texture>
+{
+public:
+    uint64_t creations = 0;
+
+    mock_texture_factory(mock_device& device, bool staged) : _device(device), _staged(staged)
+    {
+    }
+
+    bool create(uint32_t width, uint32_t height, livesplit_texture& texture) override
+    {
+        creations++;
+        texture = {};
+        return (_staged ? frame_upload::create_staged_texture(&_device, width, height, texture)
+            : frame_upload::create_mapped_texture(&_device, width, height, texture.texture, texture.view)) == nullptr;
+    }
+
+    void destroy(livesplit_texture& texture) override
+    {
+        texture.retire_draw = _device.frame();
+        _retired.push_back(texture);
+    }
+
+    void release_retired()
+    {
+        for (auto it = _retired.begin(); it != _retired.end();)
+        {
+            if (it->retire_draw <= _device.completed_frame())
+            {
+                frame_upload::destroy_texture(&_device, *it);
+                it = _retired.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+private:
+    mock_device& _device;
+    const bool _staged;
+    std::vector<livesplit_texture> _retired;
+};
+
+/// <summary>What the worker thread hands to the render thread.</summary>
+struct pipeline_frame : frame_image
+{
+    std::vector<uint8_t> pixels;
+    float draw_scale = 1;
+    benchmark_clock::time_point captured;
+    /// <summary>The keyed image that a draw of the frame must show, if it is checked.</summary>
+    std::shared_ptr<const std::vector<uint8_t>> expected;
+};
+
+/// <summary>A layout and the path its frames take to the screen.</summary>
+struct pipeline_config
+{
+    uint32_t width, split_count, source_scale;
+    /// <summary>The scale setting, which is left to the GPU down to image_scaler::MIN_GPU_SCALE.</summary>
+    float scale;
+    device_api api;
+    uint32_t gpu_latency_frames;
+};
+
+struct pipeline_result
+{
+    uint32_t width, height;
+    double seconds;
+    uint64_t copied_bytes;
+    uint64_t stalls;
+    uint64_t textures_created;
+    uint64_t draws;
+    uint64_t mismatches;
+    uint64_t errors;
+    bool released;
+    /// <summary>Host time of each uploaded frame from the start of its capture to the submitted upload.</summary>
+    std::vector<double> latencies_us;
+};
+
+/// <summary>
+/// Sends a synthetic layout through the pipeline from start_us on, as fast as the host allows. Each iteration is one
+/// pass of the worker thread followed by one draw of the render thread, after which the GPU moves on by a frame. Like
+/// in the add-on, a frame that finds all staging buffers in flight is tried again on the next draw, and the texture
+/// keeps showing the previous one in the meantime.
+/// </summary>
+static pipeline_result run_pipeline(const pipeline_config& config, uint64_t start_us, uint64_t step_us, uint32_t count, bool verify)
+{
+    synthetic_frame_source source;
+    source.configure(config.width, config.split_count, config.source_scale);
+    // Like the add-on, only scales below MIN_GPU_SCALE are done on the CPU, the others are left to the draw.
+    const float cpu_scale = config.scale < image_scaler::MIN_GPU_SCALE ? config.scale : 1;
+    const key_params keying = { 0x0f0f0f, 8, 230, true };
+    const float display_width = 3840, display_height = 2160;
+    const float alignment[2] = { 1, 0 };
+    const int offsets[2] = { 16, 16 };
+
+    std::vector<uint8_t> capture;
+    image_scaler scaler;
+    tile_diff diff;
+    frame_mailbox<pipeline_frame> mailbox;
+    uint64_t generation = 0;
+
+    const bool staged = config.api == device_api::d3d12;
+    mock_device device(config.api, config.gpu_latency_frames);
+    mock_command_queue queue(device);
+    fence upload_fence = {};
+    device.create_fence(0, fence_flags::none, &upload_fence);
+    uint64_t fence_value = 0;
+    mock_texture_factory factory(device, staged);
+    resource_pool<livesplit_texture> texture_pool(factory, 2);
+    livesplit_texture* texture = nullptr;
+    uint64_t frame_generation = 0, uploaded_generation = 0;
+    uint32_t uploaded_width = 0, uploaded_height = 0;
+    float uploaded_scale = 1;
+    std::shared_ptr<const std::vector<uint8_t>> uploaded_image;
+
+    pipeline_result result = {};
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint64_t now_us = start_us + uint64_t(i) * step_us;
+
+        // The worker thread captures, scales and looks for changes, then hands the frame over.
+        pipeline_frame& back = mailbox.back();
+        back.captured = benchmark_clock::now();
+        const uint32_t capture_width = source.width(), capture_height = source.height(now_us);
+        back.width = image_scaler::scaled_size(capture_width, cpu_scale);
+        back.height = image_scaler::scaled_size(capture_height, cpu_scale);
+        back.row_pitch = size_t(back.width) * 4;
+        back.pixels.resize(back.row_pitch * back.height);
+        back.data = back.pixels.data();
+        back.keying = keying;
+        back.draw_scale = config.scale / cpu_scale;
+        if (cpu_scale < 1)
+        {
+            capture.resize(size_t(capture_width) * 4 * capture_height);
+            source.render(now_us, capture_height, capture.data(), size_t(capture_width) * 4);
+            scaler.scale(capture.data(), capture_width, capture_height, size_t(capture_width) * 4,
+                back.data, back.width, back.height, back.row_pitch, image_scaler::FILTER_BOX);
+        }
+        else
+        {
+            source.render(now_us, capture_height, back.data, back.row_pitch);
+        }
+        if (diff.update(back.data, back.width, back.height, back.row_pitch))
+        {
+            diff.collect_dirty_rects(back.dirty_rects);
+            diff.clear_dirty();
+            back.generation = ++generation;
+            if (verify)
+            {
+                std::shared_ptr<std::vector<uint8_t>> expected = std::make_shared<std::vector<uint8_t>>(back.pixels.size());
+                for (uint32_t y = 0; y < back.height; y++)
+                    background_key::apply_row_scalar(expected->data() + y * back.row_pitch, back.data + y * back.row_pitch, back.width, keying);
+                back.expected = std::move(expected);
+            }
+            mailbox.publish();
+        }
+
+        // The render thread takes the newest frame and uploads it once, the way update_texture() does.
+        mailbox.take();
+        const pipeline_frame& frame = mailbox.front();
+        if (frame.generation != frame_generation && frame.width != 0)
+        {
+            frame_generation = frame.generation;
+            const uint64_t previous = texture != nullptr ? texture->texture.handle : 0;
+            texture = texture_pool.acquire(frame.width, frame.height, now_us);
+            if (texture == nullptr || texture->texture.handle != previous)
+                uploaded_generation = 0;
+            if (texture != nullptr)
+            {
+                bool success = false;
+                if (staged)
+                {
+                    const size_t index = texture->staging.acquire(device.get_completed_fence_value(upload_fence));
+                    if (index == staging_ring::NONE)
+                    {
+                        result.stalls++;
+                        frame_generation = 0;
+                    }
+                    else
+                    {
+                        success = frame_upload::upload_staged(&queue, *texture, upload_fence, fence_value, frame, uploaded_generation, index, result.copied_bytes);
+                    }
+                }
+                else
+                {
+                    success = frame_upload::upload_mapped(&device, texture->texture, frame, uploaded_generation, result.copied_bytes);
+                }
+                if (success)
+                {
+                    uploaded_generation = frame.generation;
+                    uploaded_width = frame.width;
+                    uploaded_height = frame.height;
+                    uploaded_scale = frame.draw_scale;
+                    uploaded_image = frame.expected;
+                    result.latencies_us.push_back(std::chrono::duration<double, std::micro>(benchmark_clock::now() - frame.captured).count());
+                }
+            }
+        }
+
+        // Draw the texture on every frame, also when nothing new was uploaded.
+        if (texture != nullptr && uploaded_generation != 0)
+        {
+            const draw_quad quad = frame_upload::place_region(display_width, display_height, texture_pool.width(), texture_pool.height(),
+                { 0, 0, uploaded_width, uploaded_height }, uploaded_scale, alignment, offsets);
+            device.draw(texture->view, quad, display_width, display_height, uploaded_width, uploaded_height, uploaded_image);
+        }
+        device.end_frame();
+        factory.release_retired();
+    }
+    result.seconds = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+    texture_pool.clear();
+    device.finish();
+    factory.release_retired();
+    device.destroy_fence(upload_fence);
+    result.width = mailbox.front().width;
+    result.height = mailbox.front().height;
+    result.textures_created = factory.creations;
+    result.draws = device.draws;
+    result.mismatches = device.mismatches;
+    result.errors = device.errors;
+    result.released = device.live_resources() == 0 && queue.idle();
+    return result;
+}
+
+static const char* api_name(device_api api)
+{
+    return api == device_api::d3d11 ? "D3D11" : api == device_api::d3d12 ? "D3D12" : api == device_api::opengl ? "OpenGL" : "Vulkan";
+}
+
+/// <summary>
+/// Checks every draw against the keyed frame, for each way of uploading and with GPUs of different latencies, while
+/// the layout grows by a row at 20 s and shrinks back at 30 s, which the texture pool follows 5 s later.
+/// </summary>
+static void test_uploads()
+{
+    for (device_api api : { device_api::d3d11, device_api::opengl, device_api::vulkan, device_api::d3d12 })
+    {
+        for (uint32_t latency : { 1u, 2u, 4u })
+        {
+            // Both layouts need a larger texture for the extra row: 11 splits are 364 pixels high and 388 with it, and
+            // 12 splits at twice the size scaled to 0.4 are 310 and 330.
+            const pipeline_result splits = run_pipeline({ 300, 11, 1, 1, api, latency }, 18000000, 100000, 300, true);
+            const pipeline_result scaled = run_pipeline({ 300, 12, 2, 0.4f, api, latency }, 18000000, 100000, 300, true);
+            check(splits.mismatches == 0 && scaled.mismatches == 0 && splits.draws > 250, "every draw shows the keyed frame the texture was meant to hold");
+            check(splits.errors == 0 && scaled.errors == 0, "the upload code only makes calls that the device accepts");
+            check(splits.released && scaled.released, "every texture, view and staging buffer is destroyed in the end");
+            check(splits.textures_created == 3 && scaled.textures_created == 3, "the texture grows with the layout and shrinks after a delay");
+            if (api == device_api::d3d12)
+                check((latency < staging_ring::BUFFER_COUNT) == (splits.stalls == 0), "uploads only wait when the GPU is more frames behind than there are buffers");
+        }
+    }
+}
+
+static void measure_pipeline(const char* name, const pipeline_config& config)
+{
+    // 15 s that include the layout growing by a row and shrinking back.
+    const uint32_t count = 900;
+    pipeline_result result = run_pipeline(config, 19000000, 16667, count, false);
+    std::sort(result.latencies_us.begin(), result.latencies_us.end());
+    const auto percentile = [&](double p) { return result.latencies_us.empty() ? 0 : result.latencies_us[size_t(p * (result.latencies_us.size() - 1))]; };
+    printf("%-18s %4ux%-4u %-6s GPU %u frames behind: %7.0f frames/s  %6.1f KiB/frame  latency p50 %7.1f us  p99 %7.1f us  %4llu stalls  %llu textures\n",
+        name, result.width, result.height, api_name(config.api), config.gpu_latency_frames, count / result.seconds, result.copied_bytes / 1024.0 / count,
+        percentile(0.5), percentile(0.99), (unsigned long long)result.stalls, (unsigned long long)result.textures_created);
+}
+
+int main()
+{
+    test_uploads();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    const struct
+    {
+        device_api api;
+        uint32_t latency;
+    } paths[] = { { device_api::d3d11, 2 }, { device_api::vulkan, 2 }, { device_api::d3d12, 1 }, { device_api::d3d12, 4 } };
+    for (const auto& path : paths)
+    {
+        measure_pipeline("timer", { 300, 0, 1, 1, path.api, path.latency });
+        measure_pipeline("splits", { 300, 15, 1, 1, path.api, path.latency });
+        measure_pipeline("splits, 4K", { 300, 15, 2, 1, path.api, path.latency });
+        measure_pipeline("splits, 4K at 0.75", { 300, 15, 2, 0.75f, path.api, path.latency });
+        measure_pipeline("splits, 4K at 0.5", { 300, 15, 2, 0.5f, path.api, path.latency });
+        measure_pipeline("splits, 4K at 0.4", { 300, 15, 2, 0.4f, path.api, path.latency });
+    }
+    return g_failures == 0 ? 0 : 1;
+}
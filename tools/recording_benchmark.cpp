@@ -0,0 +1,187 @@
+// Measures the recorder on synthetic LiveSplit images: how fast frames are encoded and decoded, how small they get,
+// whether decoding gives back the same images, and how the recorder behaves when frames come in faster than the
+// writer thread can keep up. It only needs a C++17 compiler and threads, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -pthread -I.. recording_benchmark.cpp -o recording_benchmark
+//   ./recording_benchmark
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../frame_recorder.h"
+#include "../synthetic_frame_source.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static double seconds_since(benchmark_clock::time_point start)
+{
+    return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+}
+
+/// <summary>The frames a synthetic layout shows at 60 Hz, as tightly packed BGRX images.</summary>
+struct frame_sequence
+{
+    const char* name;
+    uint32_t width, height;
+    std::vector<std::vector<uint8_t>> images;
+};
+
+static frame_sequence make_sequence(const char* name, uint32_t width, uint32_t split_count, uint32_t scale, uint32_t count)
+{
+    synthetic_frame_source source;
+    source.configure(width, split_count, scale);
+    // Stay within one size, so that keyframes only come from the interval.
+    frame_sequence sequence = { name, source.width(), source.height(0), {} };
+    for (uint32_t i = 0; i < count; i++)
+    {
+        std::vector<uint8_t> image(size_t(sequence.width) * sequence.height * 4);
+        source.render(uint64_t(i) * 16667, sequence.height, image.data(), size_t(sequence.width) * 4);
+        sequence.images.push_back(std::move(image));
+    }
+    return sequence;
+}
+
+/// <summary>Encodes all frames of a sequence into memory, decodes them again and compares.</summary>
+static bool measure_codec(const frame_sequence& sequence)
+{
+    const size_t row_pitch = size_t(sequence.width) * 4;
+    const double raw_mib = double(sequence.images.size()) * row_pitch * sequence.height / 1048576.0;
+
+    frame_delta_encoder encoder;
+    std::vector<uint8_t> stream;
+    frame_delta_encoder::append(stream, recording_format::file_header { recording_format::MAGIC, recording_format::VERSION });
+    benchmark_clock::time_point start = benchmark_clock::now();
+    for (size_t i = 0; i < sequence.images.size(); i++)
+        encoder.encode(sequence.images[i].data(), row_pitch, sequence.width, sequence.height, i + 1, i * 16667, stream);
+    const double encode_s = seconds_since(start);
+
+    FILE* file = tmpfile();
+    fwrite(stream.data(), stream.size(), 1, file);
+    rewind(file);
+    recording_reader reader(file);
+    bool identical = reader.read_header();
+    size_t decoded = 0;
+    start = benchmark_clock::now();
+    recording_format::record_type type;
+    while (identical && reader.next(type))
+    {
+        identical = type == recording_format::RECORD_FRAME && reader.frame_valid()
+            && memcmp(reader.image().data(), sequence.images[decoded].data(), sequence.images[decoded].size()) == 0;
+        decoded++;
+    }
+    const double decode_s = seconds_since(start);
+    fclose(file);
+    identical = identical && decoded == sequence.images.size();
+
+    printf("%-24s %4ux%-4u  encode %7.0f MiB/s  decode %7.0f MiB/s  %6.1f KiB/frame (%5.1fx smaller)  %s\n", sequence.name,
+        sequence.width, sequence.height, raw_mib / encode_s, raw_mib / decode_s, stream.size() / 1024.0 / sequence.images.size(),
+        raw_mib * 1048576.0 / stream.size(), identical ? "round trip identical" : "ROUND TRIP MISMATCH");
+    return identical;
+}
+
+/// <summary>An auto-reset event with a timeout, like the one that wakes the recorder's writer thread.</summary>
+class wake_event
+{
+public:
+    void set()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _signaled = true;
+        _condition.notify_one();
+    }
+
+    void wait_for(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait_for(lock, timeout, [this]() { return _signaled; });
+        _signaled = false;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _signaled = false;
+};
+
+/// <summary>
+/// Pushes a frame and a present at the given rate, while a writer thread drains the recorder every 10 ms or when it
+/// is woken because half of the frame slots are taken, like the add-on does, and reports what was dropped and how
+/// long a push took at most. With on_demand false, the writer only drains every 10 ms, for comparison.
+/// </summary>
+static void measure_recorder(const frame_sequence& sequence, uint32_t frames_per_second, double duration_s, bool on_demand)
+{
+    std::unique_ptr<frame_recorder> recorder(new frame_recorder());
+    FILE* file = tmpfile();
+    recorder->begin(file);
+    std::atomic<bool> stop(false);
+    wake_event wake;
+    std::thread writer([&]()
+    {
+        while (!stop.load())
+        {
+            wake.wait_for(std::chrono::milliseconds(10));
+            recorder->drain(file);
+        }
+        recorder->drain(file);
+    });
+
+    const size_t row_pitch = size_t(sequence.width) * 4;
+    const auto interval = std::chrono::nanoseconds(1000000000 / frames_per_second);
+    const benchmark_clock::time_point start = benchmark_clock::now();
+    benchmark_clock::time_point next = start;
+    uint64_t pushed = 0;
+    double worst_frame_push_us = 0, worst_present_push_us = 0;
+    while (seconds_since(start) < duration_s)
+    {
+        std::this_thread::sleep_until(next);
+        next += interval;
+        pushed++;
+        const uint64_t now_us = uint64_t(seconds_since(start) * 1000000);
+        benchmark_clock::time_point push_start = benchmark_clock::now();
+        recorder->push_frame(pushed, now_us, sequence.images[pushed % sequence.images.size()].data(), row_pitch, sequence.width, sequence.height);
+        // The first pushes allocate the slots' buffers.
+        if (pushed > frame_recorder::FRAME_SLOTS)
+            worst_frame_push_us = (std::max)(worst_frame_push_us, seconds_since(push_start) * 1000000);
+        if (on_demand && recorder->queued_frames() >= frame_recorder::FRAME_SLOTS / 2)
+            wake.set();
+        push_start = benchmark_clock::now();
+        recorder->push_present(now_us, pushed);
+        worst_present_push_us = (std::max)(worst_present_push_us, seconds_since(push_start) * 1000000);
+    }
+    stop = true;
+    wake.set();
+    writer.join();
+    const double elapsed_s = seconds_since(start);
+    fclose(file);
+
+    printf("%-24s %5u frames/s, %-9s pushed %6llu, dropped %6llu frames and %llu presents, wrote %6.1f MiB/s, worst push %6.1f us (frame) %5.1f us (present)\n",
+        sequence.name, frames_per_second, on_demand ? "woken:" : "polling:", (unsigned long long)pushed, (unsigned long long)recorder->dropped_frames(),
+        (unsigned long long)recorder->dropped_presents(), recorder->bytes_written() / 1048576.0 / elapsed_s, worst_frame_push_us, worst_present_push_us);
+}
+
+int main()
+{
+    const frame_sequence sequences[] = {
+        make_sequence("timer", 300, 0, 1, 600),
+        make_sequence("splits", 300, 15, 1, 600),
+        make_sequence("splits, 4K scaled", 300, 15, 2, 600)
+    };
+
+    bool identical = true;
+    for (const frame_sequence& sequence : sequences)
+        identical = measure_codec(sequence) && identical;
+    for (const frame_sequence& sequence : sequences)
+    {
+        measure_recorder(sequence, 144, 2, true);
+        measure_recorder(sequence, 5000, 2, false);
+        measure_recorder(sequence, 5000, 2, true);
+    }
+    return identical ? 0 : 1;
+}
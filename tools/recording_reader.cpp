@@ -0,0 +1,143 @@
+// Reads a recording made with "Record overlay to file" and prints what the overlay showed on each game frame, as CSV
+// on stdout: when the frame was presented, which capture it showed, when that capture was started and how old it was.
+// A summary goes to stderr. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. recording_reader.cpp -o recording_reader
+//   ./recording_reader livesplit_overlay_20240101_120000.lsrec > timeline.csv
+//   ./recording_reader livesplit_overlay_20240101_120000.lsrec --image 1234 frame_1234.ppm
+//
+// The second form writes the image of the given generation, or the last one recorded before it, as a PPM file.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "../frame_recording.h"
+
+/// <summary>Writes a BGRX image as a binary PPM file.</summary>
+static bool write_ppm(const char* path, const std::vector<uint32_t>& image, uint32_t width, uint32_t height)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    std::vector<uint8_t> row(size_t(width) * 3);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const uint32_t pixel = image[size_t(y) * width + x];
+            row[x * 3 + 0] = uint8_t(pixel >> 16);
+            row[x * 3 + 1] = uint8_t(pixel >> 8);
+            row[x * 3 + 2] = uint8_t(pixel);
+        }
+        fwrite(row.data(), row.size(), 1, file);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && !(argc == 5 && strcmp(argv[2], "--image") == 0))
+    {
+        fprintf(stderr, "Usage: %s <recording.lsrec> [--image <generation> <output.ppm>]\n", argv[0]);
+        return 2;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    recording_reader reader(file);
+    if (!reader.read_header())
+    {
+        fprintf(stderr, "%s is not a recording of a known version\n", argv[1]);
+        return 1;
+    }
+    const bool image_mode = argc == 5;
+    const uint64_t image_generation = image_mode ? strtoull(argv[3], nullptr, 10) : 0;
+    // The last image at or before the requested generation.
+    std::vector<uint32_t> image;
+    recording_format::frame_header image_frame = {};
+
+    // The capture times of the recorded frames, to tag the presents that showed them.
+    std::unordered_map<uint64_t, uint64_t> captured_us;
+    uint64_t frames = 0, keyframes = 0, damaged = 0, presents = 0, unrecorded = 0;
+    recording_format::drops_record drops = {};
+    std::vector<uint64_t> ages;
+    if (!image_mode)
+        puts("present_us,generation,captured_us,age_us");
+
+    recording_format::record_type type;
+    while (reader.next(type))
+    {
+        if (type == recording_format::RECORD_FRAME)
+        {
+            const recording_format::frame_header& frame = reader.frame();
+            if (image_mode && frame.generation > image_generation)
+                break;
+            frames++;
+            keyframes += (frame.flags & recording_format::FLAG_KEYFRAME) != 0;
+            if (!reader.frame_valid())
+            {
+                damaged++;
+                continue;
+            }
+            captured_us[frame.generation] = frame.captured_us;
+            if (image_mode)
+            {
+                image = reader.image();
+                image_frame = frame;
+            }
+        }
+        else if (type == recording_format::RECORD_PRESENT && !image_mode)
+        {
+            const recording_format::present_record& present = reader.present();
+            presents++;
+            const auto it = captured_us.find(present.generation);
+            if (present.generation != 0 && it != captured_us.end())
+            {
+                const uint64_t age = present.present_us - it->second;
+                ages.push_back(age);
+                printf("%llu,%llu,%llu,%llu\n", (unsigned long long)present.present_us, (unsigned long long)present.generation,
+                    (unsigned long long)it->second, (unsigned long long)age);
+            }
+            else
+            {
+                // Nothing was shown, or the frame that was shown was dropped before it could be written.
+                unrecorded += present.generation != 0;
+                printf("%llu,%llu,,\n", (unsigned long long)present.present_us, (unsigned long long)present.generation);
+            }
+        }
+        else if (type == recording_format::RECORD_DROPS)
+        {
+            drops = reader.drops();
+        }
+    }
+    fclose(file);
+
+    if (image_mode)
+    {
+        if (image_frame.generation == 0 || !write_ppm(argv[4], image, image_frame.width, image_frame.height))
+        {
+            fprintf(stderr, "No image for generation %llu\n", (unsigned long long)image_generation);
+            return 1;
+        }
+        fprintf(stderr, "Wrote generation %llu (%ux%u) to %s\n", (unsigned long long)image_frame.generation, image_frame.width, image_frame.height, argv[4]);
+        return 0;
+    }
+
+    fprintf(stderr, "%llu frames (%llu keyframes, %llu damaged), %llu presents, %llu showing a frame that wasn't recorded\n",
+        (unsigned long long)frames, (unsigned long long)keyframes, (unsigned long long)damaged, (unsigned long long)presents, (unsigned long long)unrecorded);
+    fprintf(stderr, "dropped while recording: %llu frames, %llu presents\n", (unsigned long long)drops.frames, (unsigned long long)drops.presents);
+    if (!ages.empty())
+    {
+        std::sort(ages.begin(), ages.end());
+        fprintf(stderr, "capture age at present: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", ages[ages.size() / 2] / 1000.0,
+            ages[ages.size() * 99 / 100] / 1000.0, ages.back() / 1000.0);
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Checks how resource_pool sizes, keeps and replaces resources, then replays resize storms, like dragging the edge
+// of the LiveSplit window or a layout that keeps changing its height, and shows that the resources created stay
+// bounded by the size classes the storm passes through instead of growing with every change in size. It only needs
+// a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. resource_pool_test.cpp -o resource_pool_test
+//   ./resource_pool_test
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+#include "../resource_pool.h"
+#include "../synthetic_frame_source.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+struct fake_resource
+{
+    uint32_t id, width, height;
+};
+
+/// <summary>Hands out made-up resources and keeps track of how many exist and how much memory they would take.</summary>
+class counting_factory : public resource_factory<fake_resource>
+{
+public:
+    uint32_t attempts = 0, created = 0, destroyed = 0;
+    uint32_t live = 0, peak_live = 0;
+    uint64_t live_bytes = 0, peak_bytes = 0;
+    /// <summary>Creating a resource of at least this height fails, like running out of video memory.</summary>
+    uint32_t fail_from_height = UINT32_MAX;
+
+    bool create(uint32_t width, uint32_t height, fake_resource& resource) override
+    {
+        attempts++;
+        if (height >= fail_from_height)
+            return false;
+        resource = { ++created, width, height };
+        live++;
+        live_bytes += uint64_t(width) * height * 4;
+        peak_live = std::max(peak_live, live);
+        peak_bytes = std::max(peak_bytes, live_bytes);
+        return true;
+    }
+
+    void destroy(fake_resource& resource) override
+    {
+        destroyed++;
+        live--;
+        live_bytes -= uint64_t(resource.width) * resource.height * 4;
+    }
+};
+
+static const uint64_t FRAME_US = 16667;
+
+static void test_size_class()
+{
+    check(size_class::round_up(1) == 64 && size_class::round_up(64) == 64, "small sizes round up to the minimum");
+    check(size_class::round_up(65) == 80 && size_class::round_up(100) == 112, "sizes round up to a quarter of their power of two");
+    check(size_class::round_up(300) == 320 && size_class::round_up(460) == 512 && size_class::round_up(920) == 1024,
+        "LiveSplit sizes round up to their class");
+    bool monotonic = true, bounded = true;
+    for (uint64_t size = 1; size < 5000; size++)
+    {
+        monotonic &= size_class::round_up(size) <= size_class::round_up(size + 1);
+        bounded &= size_class::round_up(size) >= size && size_class::round_up(size) < size * 3 / 2 + 64;
+    }
+    check(monotonic && bounded, "classes never shrink with the size and waste less than half of it");
+}
+
+static void test_growing_and_shrinking()
+{
+    counting_factory factory;
+    resource_pool<fake_resource> pool(factory, 0);
+    const fake_resource* resource = pool.acquire(300, 460, 0);
+    check(resource != nullptr && pool.width() == 320 && pool.height() == 512, "the first resource has the size class of the image");
+    check(pool.acquire(310, 500, FRAME_US) == resource && factory.created == 1, "an image that still fits keeps its resource");
+    check(pool.acquire(300, 520, 2 * FRAME_US)->height == 640 && factory.created == 2 && factory.live == 1,
+        "an image that doesn't fit gets a larger resource right away");
+
+    uint64_t now_us = 3 * FRAME_US;
+    pool.acquire(300, 300, now_us);
+    pool.acquire(300, 400, now_us + resource_pool<fake_resource>::SHRINK_DELAY_US / 2);
+    check(pool.acquire(300, 300, now_us + resource_pool<fake_resource>::SHRINK_DELAY_US - 1)->height == 640,
+        "a smaller image doesn't shrink the resource before the delay");
+    check(pool.acquire(300, 300, now_us + resource_pool<fake_resource>::SHRINK_DELAY_US)->height == 448 && factory.created == 3,
+        "after the delay the resource shrinks to the largest size seen while waiting");
+
+    now_us += 2 * resource_pool<fake_resource>::SHRINK_DELAY_US;
+    pool.acquire(300, 300, now_us);
+    pool.acquire(300, 448, now_us + FRAME_US);
+    check(pool.acquire(300, 300, now_us + resource_pool<fake_resource>::SHRINK_DELAY_US)->height == 448,
+        "returning to the current class while waiting cancels the shrink");
+}
+
+static void test_spares()
+{
+    const uint64_t delay_us = resource_pool<fake_resource>::SHRINK_DELAY_US;
+    counting_factory factory;
+    resource_pool<fake_resource> pool(factory, 2);
+    pool.acquire(300, 460, 0);
+    const uint32_t large = pool.acquire(600, 920, FRAME_US)->id;
+    check(factory.live == 2, "a replaced resource is kept as a spare");
+    uint64_t now_us = FRAME_US + delay_us;
+    pool.acquire(600, 920, now_us);
+    check(factory.live == 1, "spares expire after the delay");
+
+    pool.acquire(300, 460, now_us + FRAME_US);
+    pool.acquire(300, 460, now_us + FRAME_US + delay_us);
+    check(factory.created == 3 && factory.live == 2, "a resource that shrinks is kept as a spare as well");
+    check(pool.acquire(600, 920, now_us + 2 * FRAME_US + delay_us)->id == large && pool.reuses() == 1 && factory.created == 3,
+        "a spare of the right size is reused when the image grows back");
+
+    now_us += 3 * FRAME_US + delay_us;
+    pool.acquire(700, 920, now_us);
+    pool.acquire(900, 920, now_us + FRAME_US);
+    pool.acquire(1100, 920, now_us + 2 * FRAME_US);
+    check(factory.live == 3, "no more spares are kept than allowed");
+    pool.clear();
+    check(factory.live == 0 && factory.created == factory.destroyed, "clear() destroys the resource and all spares");
+}
+
+static void test_failures()
+{
+    counting_factory factory;
+    factory.fail_from_height = 1000;
+    resource_pool<fake_resource> pool(factory, 0);
+    check(pool.acquire(300, 460, 0) != nullptr, "a resource is created");
+    check(pool.acquire(300, 1000, FRAME_US) == nullptr && factory.live == 0, "a resource that can't be created leaves none");
+    const uint32_t attempts = factory.attempts;
+    for (uint32_t i = 0; i < 100; i++)
+        pool.acquire(300, 1000 + i % 20, (2 + i) * FRAME_US);
+    check(factory.attempts == attempts, "a size that failed isn't tried again while the image stays in its class");
+    check(pool.acquire(300, 460, 200 * FRAME_US) != nullptr, "a size that fits is tried again right away");
+}
+
+/// <summary>A sequence of image sizes, one per frame at 60 Hz.</summary>
+struct size_trace
+{
+    const char* name;
+    std::vector<std::pair<uint32_t, uint32_t>> sizes;
+};
+
+/// <summary>
+/// Someone drags the corner of the LiveSplit window around for a few seconds, then lets go at a smaller size that is
+/// kept from then on.
+/// </summary>
+static size_trace window_drag(uint32_t seconds)
+{
+    size_trace trace = { "window drag", {} };
+    std::mt19937 random(7);
+    int width = 300, height = 460;
+    for (uint32_t i = 0; i < seconds * 60; i++)
+    {
+        width = std::min(std::max(width + int(random() % 49) - 24, 250), 700);
+        height = std::min(std::max(height + int(random() % 81) - 40, 300), 1100);
+        trace.sizes.push_back({ uint32_t(width), uint32_t(height) });
+    }
+    for (uint32_t i = 0; i < 20 * 60; i++)
+        trace.sizes.push_back({ 280, 350 });
+    return trace;
+}
+
+/// <summary>The synthetic layout over two minutes, which grows by a row for the last third of every 30 seconds.</summary>
+static size_trace expanding_layout(uint32_t scale)
+{
+    size_trace trace = { scale == 1 ? "expanding layout" : "expanding layout, 4K", {} };
+    synthetic_frame_source source;
+    source.configure(300, 15, scale);
+    for (uint64_t now_us = 0; now_us < 120000000; now_us += FRAME_US)
+        trace.sizes.push_back({ source.width(), source.height(now_us) });
+    return trace;
+}
+
+/// <summary>A layout whose height keeps flipping between two values on either side of a class boundary.</summary>
+static size_trace flapping_layout()
+{
+    size_trace trace = { "flapping across a class", {} };
+    for (uint32_t i = 0; i < 60 * 60; i++)
+        trace.sizes.push_back({ 300, i % 20 < 10 ? 510u : 515u });
+    return trace;
+}
+
+/// <summary>
+/// Replays a trace through a pool with the given number of spares and compares the resources created with the
+/// number of size changes, which is how many a renderer would create that keeps its resource at the image size.
+/// Creations are bounded by the size classes that the trace visits.
+/// </summary>
+static void replay(const size_trace& trace, size_t max_spares)
+{
+    counting_factory factory;
+    resource_pool<fake_resource> pool(factory, max_spares);
+    uint32_t size_changes = 0;
+    std::set<std::pair<uint64_t, uint64_t>> classes;
+    bool always_fits = true;
+    for (size_t i = 0; i < trace.sizes.size(); i++)
+    {
+        const uint32_t width = trace.sizes[i].first, height = trace.sizes[i].second;
+        size_changes += i == 0 || trace.sizes[i] != trace.sizes[i - 1];
+        classes.insert({ size_class::round_up(width), size_class::round_up(height) });
+        const fake_resource* resource = pool.acquire(width, height, i * FRAME_US);
+        always_fits &= resource != nullptr && resource->width >= width && resource->height >= height;
+    }
+    printf("%-26s %u spares: %5zu frames, %4u size changes, %3zu size classes -> %2u created, %2llu reused, %u alive at most, %6.1f MiB at most\n",
+        trace.name, unsigned(max_spares), trace.sizes.size(), size_changes, classes.size(), factory.created,
+        (unsigned long long)pool.reuses(), factory.peak_live, factory.peak_bytes / 1048576.0);
+    check(always_fits, "every image fits the resource it gets");
+    check(factory.created <= classes.size(), "no more resources are created than the size classes visited");
+    check(factory.peak_live <= 1 + max_spares, "no more resources exist than the current one and the spares");
+}
+
+int main()
+{
+    test_size_class();
+    test_growing_and_shrinking();
+    test_spares();
+    test_failures();
+
+    for (size_t max_spares : { size_t(0), size_t(2) })
+    {
+        replay(window_drag(4), max_spares);
+        replay(expanding_layout(1), max_spares);
+        replay(expanding_layout(2), max_spares);
+        replay(flapping_layout(), max_spares);
+    }
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+// Checks shared_frame_ring within one process and across two, with a forked publisher that keeps overwriting the
+// ring while this process reads from it, and checks that no torn frame is ever accepted. Then it measures how long a
+// frame takes from publish() to a reader that polls for it. It needs a C++17 compiler and POSIX shared memory, on
+// Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. shared_frame_ring_test.cpp -o shared_frame_ring_test
+//   ./shared_frame_ring_test
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include "../shared_frame_ring.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static uint64_t now_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(benchmark_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>A name of its own for each run, so that runs don't see each other's rings.</summary>
+static const std::string g_name = "/livesplit_overlay_test_" + std::to_string(getpid());
+
+/// <summary>Where read() copies frames to.</summary>
+struct frame_storage
+{
+    std::vector<uint8_t> pixels;
+    /// <summary>
+    /// Lets the reader pause right before its next copy, as if it was preempted, so that the publisher can overwrite
+    /// the slot in the meantime even when both processes share a single core.
+    /// </summary>
+    bool pause_next = false;
+
+    uint8_t* operator()(uint32_t width, uint32_t height, size_t& row_pitch)
+    {
+        if (pause_next)
+        {
+            pause_next = false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        row_pitch = size_t(width) * 4;
+        pixels.resize(row_pitch * height);
+        return pixels.data();
+    }
+};
+
+/// <summary>The size of a frame in the stress test, which changes with every frame.</summary>
+static void frame_size(uint64_t sequence, uint32_t& width, uint32_t& height)
+{
+    width = 64 + uint32_t(sequence % 61);
+    height = 16 + uint32_t(sequence % 17);
+}
+
+/// <summary>Checks that every pixel of a frame holds the number of the frame, as the stress test publishes them.</summary>
+static bool is_whole(const frame_storage& storage, const shared_frame_ring::frame_info& info)
+{
+    uint32_t width, height;
+    frame_size(info.sequence, width, height);
+    if (info.width != width || info.height != height || storage.pixels.size() != size_t(width) * 4 * height)
+        return false;
+    const uint32_t expected = uint32_t(info.sequence);
+    for (size_t i = 0; i < storage.pixels.size(); i += 4)
+    {
+        uint32_t pixel;
+        memcpy(&pixel, storage.pixels.data() + i, 4);
+        if (pixel != expected)
+            return false;
+    }
+    return true;
+}
+
+static void test_single_process()
+{
+    shared_frame_ring reader, publisher;
+    check(!reader.open(g_name.c_str()), "a ring can't be opened before it is created");
+    check(publisher.create(g_name.c_str(), 64, 32), "a ring is created");
+    check(reader.open(g_name.c_str()) && reader.published() == 0, "a new ring can be opened and has no frames");
+    frame_storage storage;
+    shared_frame_ring::frame_info info;
+    check(!reader.read(std::ref(storage), info), "nothing can be read before a publish");
+
+    std::vector<uint8_t> image(64 * 32 * 4, 0x11);
+    check(publisher.publish(image.data(), 64, 32, 64 * 4, 1000), "a frame of the maximum size is published");
+    std::fill(image.begin(), image.end(), 0x22);
+    check(publisher.publish(image.data() + 4, 40, 10, 64 * 4, 2000), "a smaller frame with padding is published");
+    check(reader.read(std::ref(storage), info) && info.width == 40 && info.height == 10 && info.sequence == 2 && info.timestamp_us == 2000,
+        "the newest frame is read");
+    check(std::all_of(storage.pixels.begin(), storage.pixels.end(), [](uint8_t value) { return value == 0x22; }), "the pixels of the newest frame are read");
+    check(!publisher.publish(image.data(), 65, 32, 65 * 4, 3000) && !publisher.publish(image.data(), 64, 33, 64 * 4, 3000),
+        "frames larger than the ring are rejected");
+    check(!reader.publish(image.data(), 8, 8, 8 * 4, 3000), "a reader can't publish");
+    check(reader.published() == 2, "rejected frames don't count");
+
+    shared_frame_ring again;
+    check(again.create(g_name.c_str(), 64, 32) && again.published() == 2 && !reader.layout_changed(),
+        "a publisher that comes back with the same layout keeps the frames");
+    shm_unlink(g_name.c_str());
+}
+
+static void test_max_dimension()
+{
+    shared_frame_ring ring;
+    check(!ring.create(g_name.c_str(), shared_frame_ring::MAX_DIMENSION + 1, 1), "a ring wider than MAX_DIMENSION is rejected");
+    check(!ring.create(g_name.c_str(), 1, UINT32_MAX), "a ring taller than MAX_DIMENSION is rejected");
+
+    // A publisher that doesn't use this class may claim any size. Tamper with the header the way one could.
+    check(ring.create(g_name.c_str(), 64, 32), "a ring is created");
+    const int file = shm_open(g_name.c_str(), O_RDWR, 0);
+    uint32_t* const header = (uint32_t*)mmap(nullptr, 64, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    header[3] = UINT32_MAX;
+    header[4] = UINT32_MAX;
+    shared_frame_ring reader;
+    check(!reader.open(g_name.c_str()), "a ring claiming frames larger than MAX_DIMENSION isn't opened");
+    header[3] = 128;
+    header[4] = 128;
+    check(!reader.open(g_name.c_str()), "a ring whose slot size doesn't match its frame size isn't opened");
+    ((uint64_t*)header)[3] = (64 + 128 * 128 * 4 + 63) / 64 * 64;
+    check(!reader.open(g_name.c_str()), "a ring claiming more memory than it has isn't opened");
+    munmap(header, 64);
+    shm_unlink(g_name.c_str());
+}
+
+static void test_layout_changed()
+{
+    shared_frame_ring publisher, reader;
+    publisher.create(g_name.c_str(), 64, 32);
+    check(reader.open(g_name.c_str()) && !reader.layout_changed(), "a freshly opened ring has the layout it was opened with");
+
+    shared_frame_ring larger;
+    check(larger.create(g_name.c_str(), 128, 64), "a publisher may create the ring anew with a larger layout");
+    check(reader.layout_changed(), "the reader notices the new layout");
+    std::vector<uint8_t> image(128 * 64 * 4, 0x33);
+    larger.publish(image.data(), 128, 64, 128 * 4, 1);
+    frame_storage storage;
+    shared_frame_ring::frame_info info;
+    check(!reader.read(std::ref(storage), info) || info.width <= 64, "the old layout never lets the reader copy larger frames");
+    check(reader.open(g_name.c_str()) && !reader.layout_changed(), "opening again takes on the new layout");
+    check(reader.read(std::ref(storage), info) && info.width == 128 && info.height == 64, "frames of the new layout are read after opening again");
+    shm_unlink(g_name.c_str());
+}
+
+/// <summary>Runs a function in a forked process, which exits with 0 when the function returns true.</summary>
+template <typename function>
+static pid_t run_in_child(function body)
+{
+    const pid_t child = fork();
+    if (child == 0)
+        _exit(body() ? 0 : 1);
+    return child;
+}
+
+static bool child_succeeded(pid_t child)
+{
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/// <summary>
+/// Lets a forked publisher fill frames of changing sizes with their number as fast as it can, while this process
+/// reads as fast as it can, and checks that every accepted frame is whole and newer than the one before.
+/// </summary>
+static void test_cross_process(double duration_s)
+{
+    shared_frame_ring setup;
+    setup.create(g_name.c_str(), 128, 32);
+    setup.close();
+    const uint64_t end_us = now_us() + uint64_t(duration_s * 1000000);
+    const pid_t child = run_in_child([&]()
+    {
+        shared_frame_ring publisher;
+        if (!publisher.create(g_name.c_str(), 128, 32))
+            return false;
+        std::vector<uint32_t> image(128 * 32);
+        for (uint64_t sequence = 1; now_us() < end_us; sequence++)
+        {
+            uint32_t width, height;
+            frame_size(sequence, width, height);
+            std::fill(image.begin(), image.begin() + width * height, uint32_t(sequence));
+            if (!publisher.publish((const uint8_t*)image.data(), width, height, size_t(width) * 4, now_us()))
+                return false;
+        }
+        return true;
+    });
+
+    shared_frame_ring reader;
+    check(reader.open(g_name.c_str()), "the reader opens the publisher's ring");
+    frame_storage storage;
+    shared_frame_ring::frame_info info;
+    uint64_t reads = 0, failed = 0, torn = 0, out_of_order = 0, previous = 0;
+    while (now_us() < end_us)
+    {
+        if (reader.published() == previous)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        storage.pause_next = (reads + failed) % 2 == 0;
+        if (!reader.read(std::ref(storage), info))
+        {
+            failed++;
+            continue;
+        }
+        reads++;
+        torn += !is_whole(storage, info);
+        out_of_order += info.sequence < previous;
+        previous = info.sequence;
+    }
+    check(child_succeeded(child), "the publisher process publishes all its frames");
+    shm_unlink(g_name.c_str());
+
+    printf("cross-process: %llu frames published, %llu read, %llu reads gave up, %llu torn, %llu out of order\n",
+        (unsigned long long)reader.published(), (unsigned long long)reads, (unsigned long long)failed, (unsigned long long)torn,
+        (unsigned long long)out_of_order);
+    check(reads > 0, "the reader gets frames while the publisher keeps overwriting the ring");
+    check(torn == 0, "the reader never accepts a frame the publisher is writing");
+    check(out_of_order == 0, "the reader never gets an older frame after a newer one");
+}
+
+/// <summary>
+/// Lets a forked publisher publish frames of the given size at the given rate, while this process polls published()
+/// at the given interval like the worker thread does, and reports how old frames are once they are copied.
+/// </summary>
+static void measure_latency(uint32_t width, uint32_t height, uint32_t frames_per_second, uint32_t poll_interval_us, double duration_s)
+{
+    shared_frame_ring setup;
+    setup.create(g_name.c_str(), width, height);
+    setup.close();
+    const uint64_t end_us = now_us() + uint64_t(duration_s * 1000000);
+    const pid_t child = run_in_child([&]()
+    {
+        shared_frame_ring publisher;
+        if (!publisher.create(g_name.c_str(), width, height))
+            return false;
+        std::vector<uint8_t> image(size_t(width) * 4 * height, 0x40);
+        const auto interval = std::chrono::nanoseconds(1000000000 / frames_per_second);
+        benchmark_clock::time_point next = benchmark_clock::now();
+        while (now_us() < end_us)
+        {
+            std::this_thread::sleep_until(next);
+            next += interval;
+            publisher.publish(image.data(), width, height, size_t(width) * 4, now_us());
+        }
+        return true;
+    });
+
+    shared_frame_ring reader;
+    while (!reader.open(g_name.c_str()) && now_us() < end_us)
+        std::this_thread::yield();
+    frame_storage storage;
+    shared_frame_ring::frame_info info;
+    std::vector<double> ages_us, copies_us;
+    uint64_t previous = 0;
+    while (now_us() < end_us)
+    {
+        if (poll_interval_us != 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(poll_interval_us));
+        if (reader.published() == previous)
+            continue;
+        const uint64_t start_us = now_us();
+        if (!reader.read(std::ref(storage), info))
+            continue;
+        const uint64_t copied_us = now_us();
+        ages_us.push_back(double(copied_us - info.timestamp_us));
+        copies_us.push_back(double(copied_us - start_us));
+        previous = info.sequence;
+    }
+    child_succeeded(child);
+    shm_unlink(g_name.c_str());
+
+    std::sort(ages_us.begin(), ages_us.end());
+    std::sort(copies_us.begin(), copies_us.end());
+    const auto percentile = [](const std::vector<double>& values, double p) { return values.empty() ? 0 : values[size_t(p * (values.size() - 1))]; };
+    printf("%4ux%-4u %5u frames/s, polled every %5u us: %6zu read, age p50 %7.1f us  p99 %7.1f us, copy p50 %6.1f us\n",
+        width, height, frames_per_second, poll_interval_us, ages_us.size(), percentile(ages_us, 0.5), percentile(ages_us, 0.99),
+        percentile(copies_us, 0.5));
+}
+
+int main()
+{
+    test_single_process();
+    test_max_dimension();
+    test_layout_changed();
+    test_cross_process(2);
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_latency(300, 460, 60, 0, 1);
+    measure_latency(300, 460, 60, 1000, 1);
+    measure_latency(600, 920, 60, 1000, 1);
+    measure_latency(600, 920, 240, 1000, 1);
+    return g_failures == 0 ? 0 : 1;
+}
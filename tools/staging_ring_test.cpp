@@ -0,0 +1,188 @@
+// Checks staging_ring against a mock GPU whose fence completes the submitted copies a few frames later: a buffer is
+// never handed out while a copy from it is still in flight, uploads are skipped instead of waiting when every buffer
+// is busy, and the ring only counts as idle once the GPU caught up. Then it simulates GPUs that fall behind by
+// different amounts and reports how often uploads had to be skipped. It only needs a C++17 compiler, on Linux for
+// example:
+//
+//   g++ -std=c++17 -O2 -I.. staging_ring_test.cpp -o staging_ring_test
+//   ./staging_ring_test
+
+#include <cstdio>
+#include <deque>
+#include <random>
+#include "../staging_ring.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>
+/// A fence on a mock GPU. Signals are queued with the frame they were submitted on and complete a number of frames
+/// later, in order, like a command queue that runs behind the CPU.
+/// </summary>
+class mock_fence
+{
+public:
+    explicit mock_fence(uint32_t latency_frames) : _latency_frames(latency_frames)
+    {
+    }
+
+    /// <summary>Makes the GPU stop completing anything for a number of frames, like a hitch in the game's rendering.</summary>
+    void stall(uint32_t frames)
+    {
+        _stalled_until = _frame + frames;
+    }
+
+    uint64_t signal()
+    {
+        _pending.push_back({ _frame, ++_value });
+        return _value;
+    }
+
+    uint64_t completed_value() const
+    {
+        return _completed_value;
+    }
+
+    /// <summary>Moves on by a frame and completes the signals that are old enough.</summary>
+    void end_frame()
+    {
+        _frame++;
+        if (_frame >= _stalled_until)
+            complete(_latency_frames);
+    }
+
+    /// <summary>Waits until the GPU is done with everything.</summary>
+    void finish()
+    {
+        complete(0);
+    }
+
+private:
+    struct pending_signal
+    {
+        uint64_t frame;
+        uint64_t value;
+    };
+
+    const uint32_t _latency_frames;
+    uint64_t _frame = 0;
+    uint64_t _stalled_until = 0;
+    uint64_t _value = 0;
+    uint64_t _completed_value = 0;
+    std::deque<pending_signal> _pending;
+
+    void complete(uint32_t latency_frames)
+    {
+        while (!_pending.empty() && _pending.front().frame + latency_frames <= _frame)
+        {
+            _completed_value = _pending.front().value;
+            _pending.pop_front();
+        }
+    }
+};
+
+static void test_fresh_ring()
+{
+    staging_ring ring;
+    check(ring.idle(0) && ring.last_value() == 0 && ring.stalls() == 0, "a fresh ring is idle");
+    check(ring.acquire(0) == 0, "a fresh ring hands out its first buffer");
+}
+
+static void test_round_robin()
+{
+    staging_ring ring;
+    mock_fence fence(0);
+    for (size_t i = 0; i < 2 * staging_ring::BUFFER_COUNT; i++)
+    {
+        const size_t index = ring.acquire(fence.completed_value());
+        check(index == i % staging_ring::BUFFER_COUNT, "buffers are used in turn while the GPU keeps up");
+        ring.submit(index, fence.signal());
+        fence.end_frame();
+    }
+}
+
+static void test_never_overwrites_in_flight()
+{
+    staging_ring ring;
+    mock_fence fence(100);
+    for (size_t i = 0; i < staging_ring::BUFFER_COUNT; i++)
+        ring.submit(ring.acquire(fence.completed_value()), fence.signal());
+    check(ring.acquire(fence.completed_value()) == staging_ring::NONE, "no buffer is handed out while all are in flight");
+    check(ring.acquire(fence.completed_value()) == staging_ring::NONE && ring.stalls() == 2, "every failed acquire counts as a stall");
+    check(!ring.idle(fence.completed_value()), "a ring with copies in flight isn't idle");
+
+    // Completing the first copy frees exactly the first buffer.
+    check(ring.acquire(1) == 0, "the buffer whose copy completed is handed out");
+    ring.submit(0, 4);
+    check(ring.acquire(1) == staging_ring::NONE, "buffers whose copies didn't complete aren't handed out");
+    check(ring.acquire(2) == 1, "the next buffer is handed out once its copy completed");
+    check(!ring.idle(3) && ring.idle(4), "the ring is idle once the last copy completed");
+}
+
+static void test_least_recently_used_first()
+{
+    staging_ring ring;
+    ring.submit(ring.acquire(0), 1);
+    ring.submit(ring.acquire(0), 2);
+    check(ring.acquire(2) == 2, "the buffer after the last submitted one is tried first");
+    ring.submit(2, 3);
+    check(ring.acquire(1) == 0, "an older buffer is used once its copy completed");
+}
+
+/// <summary>
+/// Runs an upload every frame against a GPU that falls behind by the given number of frames, now and then by a few
+/// more, and tracks which buffers the mock GPU still reads from to catch a buffer that is handed out too early.
+/// </summary>
+static void simulate(uint32_t latency_frames, uint32_t hiccup_frames, uint32_t frames)
+{
+    staging_ring ring;
+    mock_fence fence(latency_frames);
+    std::mt19937 random(latency_frames * 31 + hiccup_frames);
+    uint64_t in_flight_until[staging_ring::BUFFER_COUNT] = {};
+    uint64_t uploads = 0, overwrites = 0;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        const uint64_t completed = fence.completed_value();
+        const size_t index = ring.acquire(completed);
+        if (index != staging_ring::NONE)
+        {
+            overwrites += in_flight_until[index] > completed;
+            in_flight_until[index] = fence.signal();
+            ring.submit(index, in_flight_until[index]);
+            uploads++;
+        }
+        if (hiccup_frames != 0 && random() % 100 == 0)
+            fence.stall(hiccup_frames);
+        fence.end_frame();
+    }
+    fence.finish();
+    printf("GPU %u frames behind, hiccups of %2u frames: %5llu of %u frames uploaded, %5llu stalls\n", latency_frames, hiccup_frames,
+        (unsigned long long)uploads, frames, (unsigned long long)ring.stalls());
+    check(overwrites == 0, "a buffer is never handed out while the GPU still reads from it");
+    check(uploads + ring.stalls() == frames, "every frame either uploads or counts a stall");
+    check(ring.idle(fence.completed_value()), "the ring is idle once the GPU is done");
+    if (latency_frames < staging_ring::BUFFER_COUNT && hiccup_frames == 0)
+        check(ring.stalls() == 0, "a GPU fewer frames behind than there are buffers never stalls uploads");
+}
+
+int main()
+{
+    test_fresh_ring();
+    test_round_robin();
+    test_never_overwrites_in_flight();
+    test_least_recently_used_first();
+    for (uint32_t latency : { 0u, 1u, 2u, 3u, 4u })
+        simulate(latency, 0, 6000);
+    simulate(1, 10, 6000);
+    simulate(2, 30, 6000);
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
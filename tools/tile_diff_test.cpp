@@ -0,0 +1,198 @@
+// Checks that tile_diff reports exactly the tiles that changed, and measures how fast it hashes synthetic LiveSplit
+// images and how much of them it reports as dirty. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. tile_diff_test.cpp -o tile_diff_test
+//   ./tile_diff_test
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "../synthetic_frame_source.h"
+#include "../tile_diff.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static bool same_rect(const dirty_rect& rect, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+{
+    return rect.left == left && rect.top == top && rect.right == right && rect.bottom == bottom;
+}
+
+/// <summary>A BGRX image with room for padding at the end of each row.</summary>
+struct test_image
+{
+    uint32_t width, height;
+    size_t row_pitch;
+    std::vector<uint8_t> pixels;
+
+    test_image(uint32_t width, uint32_t height, size_t padding = 0) :
+        width(width), height(height), row_pitch(size_t(width) * 4 + padding), pixels(row_pitch * height, 0x20)
+    {
+    }
+
+    void set(uint32_t x, uint32_t y, uint8_t value)
+    {
+        pixels[y * row_pitch + x * 4] = value;
+    }
+
+    bool update(tile_diff& diff) const
+    {
+        return diff.update(pixels.data(), width, height, row_pitch);
+    }
+};
+
+static void test_first_capture_is_dirty()
+{
+    tile_diff diff;
+    test_image image(300, 100);
+    std::vector<dirty_rect> rects;
+    check(image.update(diff), "the first capture counts as a change");
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 1 && same_rect(rects[0], 0, 0, 300, 100), "the first capture is dirty as a whole");
+}
+
+static void test_unchanged_capture()
+{
+    tile_diff diff;
+    test_image image(300, 100);
+    std::vector<dirty_rect> rects;
+    image.update(diff);
+    diff.clear_dirty();
+    check(!image.update(diff), "the same capture again isn't a change");
+    check(!diff.is_dirty(), "nothing is dirty after the same capture");
+    diff.collect_dirty_rects(rects);
+    check(rects.empty(), "the same capture has no dirty rects");
+}
+
+static void test_single_pixel()
+{
+    tile_diff diff;
+    test_image image(300, 100);
+    std::vector<dirty_rect> rects;
+    image.update(diff);
+    diff.clear_dirty();
+    image.set(100, 40, 0xff);
+    check(image.update(diff), "a changed pixel is a change");
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 1 && same_rect(rects[0], 64, 32, 128, 48), "a changed pixel dirties its tile only");
+}
+
+static void test_changes_accumulate()
+{
+    tile_diff diff;
+    test_image image(300, 100);
+    std::vector<dirty_rect> rects;
+    image.update(diff);
+    diff.clear_dirty();
+    image.set(10, 5, 0xff);
+    image.update(diff);
+    image.set(10, 5, 0x20);
+    image.set(290, 90, 0xff);
+    check(image.update(diff), "a second change is a change");
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 2 && same_rect(rects[0], 0, 0, 64, 16) && same_rect(rects[1], 256, 80, 300, 96),
+        "changes accumulate until clear_dirty(), even when a pixel changed back");
+    diff.clear_dirty();
+    check(!diff.is_dirty(), "clear_dirty() acknowledges everything");
+}
+
+static void test_adjacent_rows_merge()
+{
+    tile_diff diff;
+    test_image image(300, 100);
+    std::vector<dirty_rect> rects;
+    image.update(diff);
+    diff.clear_dirty();
+    image.set(10, 20, 0xff);
+    image.set(200, 40, 0xff);
+    image.update(diff);
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 1 && same_rect(rects[0], 0, 16, 256, 48), "vertically adjacent dirty rows are merged");
+}
+
+static void test_resize_and_invalidate()
+{
+    tile_diff diff;
+    test_image image(300, 100), taller(300, 124);
+    std::vector<dirty_rect> rects;
+    image.update(diff);
+    diff.clear_dirty();
+    check(taller.update(diff), "a resized capture is a change");
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 1 && same_rect(rects[0], 0, 0, 300, 124), "a resized capture is dirty as a whole");
+
+    diff.clear_dirty();
+    diff.invalidate();
+    check(taller.update(diff), "a capture after invalidate() is a change");
+    diff.collect_dirty_rects(rects);
+    check(rects.size() == 1 && same_rect(rects[0], 0, 0, 300, 124), "a capture after invalidate() is dirty as a whole");
+}
+
+static void test_padding_is_ignored()
+{
+    tile_diff diff;
+    test_image image(100, 20, 48);
+    image.update(diff);
+    diff.clear_dirty();
+    image.pixels[image.row_pitch - 4] = 0xff;
+    check(!image.update(diff), "bytes past the end of a row aren't part of the image");
+}
+
+/// <summary>Runs the synthetic layouts through the diff at 60 Hz, like the worker thread would.</summary>
+static void measure_diff(const char* name, uint32_t width, uint32_t split_count, uint32_t scale, uint32_t count)
+{
+    synthetic_frame_source source;
+    source.configure(width, split_count, scale);
+    const uint32_t height = source.height(0);
+    const size_t row_pitch = size_t(source.width()) * 4;
+    std::vector<std::vector<uint8_t>> images(count, std::vector<uint8_t>(row_pitch * height));
+    for (uint32_t i = 0; i < count; i++)
+        source.render(uint64_t(i) * 16667, height, images[i].data(), row_pitch);
+
+    tile_diff diff;
+    std::vector<dirty_rect> rects;
+    uint64_t dirty_pixels = 0, rect_count = 0;
+    double diff_s = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const benchmark_clock::time_point start = benchmark_clock::now();
+        diff.update(images[i].data(), source.width(), height, row_pitch);
+        diff.collect_dirty_rects(rects);
+        diff.clear_dirty();
+        diff_s += std::chrono::duration<double>(benchmark_clock::now() - start).count();
+        for (const dirty_rect& rect : rects)
+            dirty_pixels += uint64_t(rect.right - rect.left) * (rect.bottom - rect.top);
+        rect_count += rects.size();
+    }
+    const double total_pixels = double(count) * source.width() * height;
+    printf("%-24s %4ux%-4u  diff %7.0f MiB/s  %6.2f us/frame  %5.2f rects/frame  %5.1f%% dirty\n", name, source.width(), height,
+        total_pixels * 4 / 1048576.0 / diff_s, diff_s * 1000000 / count, double(rect_count) / count, dirty_pixels * 100.0 / total_pixels);
+}
+
+int main()
+{
+    test_first_capture_is_dirty();
+    test_unchanged_capture();
+    test_single_pixel();
+    test_changes_accumulate();
+    test_adjacent_rows_merge();
+    test_resize_and_invalidate();
+    test_padding_is_ignored();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+
+    measure_diff("timer", 300, 0, 1, 600);
+    measure_diff("splits", 300, 15, 1, 600);
+    measure_diff("splits, 4K scaled", 300, 15, 2, 600);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+// Checks window_discovery against a fake list of windows: which windows it accepts, how often it queries processes,
+// and that window notifications arriving while it examines windows, as they do on Windows while a window title is
+// queried, neither crash it nor get lost. It only needs a C++17 compiler, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -I.. window_discovery_test.cpp -o window_discovery_test
+//   ./window_discovery_test
+
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "../window_discovery.h"
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+/// <summary>A desktop of made-up windows and processes.</summary>
+class fake_enumerator : public window_enumerator
+{
+public:
+    struct window
+    {
+        bool visible;
+        uint32_t process_id;
+        std::wstring title;
+    };
+
+    std::map<window_id, window> windows;
+    std::map<uint32_t, std::wstring> processes;
+    uint64_t enumerations = 0;
+    uint64_t process_queries = 0;
+    /// <summary>Called for every title query, like the messages a window title query lets through on Windows.</summary>
+    std::function<void(window_id)> on_get_title;
+
+    void enumerate(std::vector<window_id>& list) override
+    {
+        enumerations++;
+        for (const auto& entry : windows)
+            list.push_back(entry.first);
+    }
+
+    bool is_visible(window_id id) override
+    {
+        const auto it = windows.find(id);
+        return it != windows.end() && it->second.visible;
+    }
+
+    uint32_t get_process_id(window_id id) override
+    {
+        const auto it = windows.find(id);
+        return it != windows.end() ? it->second.process_id : 0;
+    }
+
+    bool get_process_image(uint32_t process_id, std::wstring& image) override
+    {
+        process_queries++;
+        const auto it = processes.find(process_id);
+        if (it == processes.end())
+            return false;
+        image = it->second;
+        return true;
+    }
+
+    bool get_title(window_id id, std::wstring& title) override
+    {
+        if (on_get_title)
+            on_get_title(id);
+        const auto it = windows.find(id);
+        if (it == windows.end())
+            return false;
+        title = it->second.title;
+        return true;
+    }
+};
+
+static void add_desktop(fake_enumerator& desktop)
+{
+    desktop.processes[10] = L"C:\\Windows\\explorer.exe";
+    desktop.processes[20] = L"C:\\Games\\Game.exe";
+    desktop.windows[1] = { true, 10, L"LiveSplit" }; // An Explorer window showing LiveSplit's folder.
+    desktop.windows[2] = { true, 20, L"Game" };
+    desktop.windows[3] = { true, 10, L"Program Manager" };
+}
+
+static void test_finds_the_right_process()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    desktop.windows[4] = { false, 30, L"LiveSplit" };
+    desktop.windows[5] = { true, 30, L"LiveSplit" };
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    check(discovery.find(0) == 5, "only the visible LiveSplit window of LiveSplit.exe is accepted");
+    check(discovery.find(1) == 5 && desktop.enumerations == 1, "a found window is kept without looking again");
+}
+
+static void test_any_case()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    desktop.processes[30] = L"c:\\tools\\livesplit\\LIVESPLIT.EXE";
+    desktop.windows[4] = { true, 30, L"LiveSplit" };
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    check(discovery.find(0) == 4, "executable names match in any case");
+}
+
+static void test_title_pattern()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    desktop.processes[30] = L"C:\\Tools\\InputDisplay.exe";
+    desktop.windows[4] = { true, 30, L"Settings" };
+    desktop.windows[5] = { true, 30, L"Input Display v1.2 - Pad 1" };
+    window_discovery discovery(desktop, L"\\InputDisplay.exe", L"Input Display*Pad ?");
+    check(discovery.find(0) == 5, "* and ? match any text and any single character");
+}
+
+static void test_notifications()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    check(discovery.find(0) == 0, "nothing is found without LiveSplit");
+    const uint64_t queries = desktop.process_queries;
+
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    desktop.windows[7] = { true, 30, L"LiveSplit" };
+    discovery.on_window_changed(1);
+    discovery.on_window_changed(7);
+    discovery.on_window_changed(7);
+    check(discovery.find(1000) == 7 && desktop.enumerations == 1, "a new window is found from its notification alone");
+    check(desktop.process_queries == queries + 1, "known processes aren't queried again");
+
+    discovery.on_window_removed(7);
+    desktop.windows.erase(7);
+    check(discovery.find(2000) == 0, "a removed window is forgotten");
+    desktop.windows[8] = { true, 30, L"LiveSplit" };
+    check(discovery.find(3000) == 0, "a window without notification waits for the next scan");
+    check(discovery.find(window_discovery::SCAN_INTERVAL_US + 2000) == 8, "the next scan finds it");
+}
+
+static void test_title_change()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    desktop.windows[7] = { true, 30, L"LiveSplit" };
+    desktop.windows[8] = { true, 30, L"LiveSplit Settings" };
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit*");
+    check(discovery.find(0) == 7, "the first LiveSplit window is found");
+
+    desktop.windows[7].title = L"LiveSplit - Any%";
+    discovery.on_window_changed(7);
+    check(discovery.find(1000) == 7 && desktop.enumerations == 1, "a renamed window that still matches is kept without a scan");
+
+    desktop.windows[7].title = L"Notepad";
+    discovery.on_window_changed(7);
+    check(discovery.find(2000) == 0 && desktop.enumerations == 1, "a renamed window that doesn't match anymore is dropped right away");
+    check(discovery.find(3000) == 8 && desktop.enumerations == 2, "then all windows are scanned for another one");
+}
+
+static void test_process_cache()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    for (window_enumerator::window_id id = 100; id < 200; id++)
+        desktop.windows[id] = { true, 20, L"Game tool window" };
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    discovery.find(0);
+    check(desktop.process_queries == 2, "each process is queried once, however many windows it has");
+    discovery.invalidate();
+    discovery.find(window_discovery::PROCESS_CACHE_TTL_US + 1);
+    check(desktop.process_queries == 4, "processes are queried again once the cache expires");
+}
+
+static void test_reentrant_notifications()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    for (window_enumerator::window_id id = 100; id < 110; id++)
+        desktop.windows[id] = { true, 30, L"LiveSplit Settings" };
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+
+    // Every title query lets a burst of notifications through, enough to make any list being iterated grow.
+    window_enumerator::window_id next = 1000;
+    bool flooding = true;
+    desktop.on_get_title = [&](window_enumerator::window_id)
+    {
+        if (!flooding)
+            return;
+        for (int i = 0; i < 64; i++, next++)
+        {
+            desktop.windows[next] = { true, 20, L"Popup" };
+            discovery.on_window_changed(next);
+        }
+        desktop.windows[next] = { true, 30, L"LiveSplit" };
+        discovery.on_window_changed(next++);
+        flooding = false;
+    };
+    check(discovery.find(0) == 0, "windows that show up during a find() wait for the next one");
+    check(discovery.find(1) == next - 1, "a window that showed up during a find() is found by the next one");
+}
+
+static void test_notification_flood()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    discovery.find(0);
+    const uint64_t enumerations = desktop.enumerations;
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    for (window_enumerator::window_id id = 100; id < 100 + 3 * window_discovery::MAX_PENDING; id++)
+    {
+        desktop.windows[id] = { true, 20, L"Popup" };
+        discovery.on_window_changed(id);
+    }
+    desktop.windows[50] = { true, 30, L"LiveSplit" };
+    discovery.on_window_changed(50);
+    check(discovery.find(window_discovery::SCAN_INTERVAL_US) == 50 && desktop.enumerations == enumerations + 1,
+        "a flood of notifications turns into one scan over all windows");
+}
+
+static void test_polling()
+{
+    fake_enumerator desktop;
+    add_desktop(desktop);
+    window_discovery discovery(desktop, L"\\LiveSplit.exe", L"LiveSplit");
+    discovery.set_polling(true);
+    discovery.find(0);
+    discovery.find(1000);
+    check(desktop.enumerations == 1, "polling scans at most once per interval");
+    desktop.processes[30] = L"C:\\Tools\\LiveSplit\\LiveSplit.exe";
+    desktop.windows[9] = { true, 30, L"LiveSplit" };
+    check(discovery.find(window_discovery::SCAN_INTERVAL_US) == 9 && desktop.enumerations == 2, "polling finds windows without notifications");
+}
+
+int main()
+{
+    test_finds_the_right_process();
+    test_any_case();
+    test_title_pattern();
+    test_notifications();
+    test_title_change();
+    test_process_cache();
+    test_reentrant_notifications();
+    test_notification_flood();
+    test_polling();
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+// Checks worker_lifecycle on its own, then drives it the way the render thread does while the overlay is shown and
+// hidden in quick succession and the worker thread now and then gets stuck in a capture, like in GetDIBits or
+// EnumWindows. It checks that a frame never waits for the worker thread, that hiding and showing again resumes the
+// parked worker thread instead of starting a new one, and that there is never more than one worker thread. It only
+// needs a C++17 compiler and threads, on Linux for example:
+//
+//   g++ -std=c++17 -O2 -pthread -I.. worker_lifecycle_test.cpp -o worker_lifecycle_test
+//   ./worker_lifecycle_test
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../worker_lifecycle.h"
+
+using benchmark_clock = std::chrono::steady_clock;
+using state = worker_lifecycle::state;
+using action = worker_lifecycle::action;
+
+static int g_failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        g_failures++;
+    }
+}
+
+static void test_show_and_hide()
+{
+    worker_lifecycle lifecycle;
+    check(lifecycle.update(0, false) == action::none && lifecycle.get_state() == state::stopped, "nothing starts while hidden");
+    lifecycle.set_wanted(true, true);
+    check(lifecycle.update(1, false) == action::start && lifecycle.wakes_worker() && lifecycle.starts() == 1, "showing starts a worker thread");
+    check(lifecycle.update(2, false) == action::none && lifecycle.starts() == 1, "a running worker thread isn't started again");
+
+    lifecycle.set_wanted(false, true);
+    check(lifecycle.update(3, false) == action::none && lifecycle.get_state() == state::standby && !lifecycle.wakes_worker(),
+        "hiding parks the worker thread");
+    lifecycle.set_wanted(true, true);
+    check(lifecycle.update(4, false) == action::none && lifecycle.wakes_worker() && lifecycle.resumes() == 1 && lifecycle.starts() == 1,
+        "showing again resumes the parked worker thread");
+}
+
+static void test_standby_timeout()
+{
+    worker_lifecycle lifecycle;
+    lifecycle.set_wanted(true, true);
+    lifecycle.update(0, false);
+    lifecycle.set_wanted(false, true);
+    lifecycle.update(1000, false);
+    check(lifecycle.update(1000 + worker_lifecycle::STANDBY_TIMEOUT_US - 1, false) == action::none, "the worker thread stays parked until the timeout");
+    check(lifecycle.update(1000 + worker_lifecycle::STANDBY_TIMEOUT_US, false) == action::stop && lifecycle.get_state() == state::stopping,
+        "the worker thread is stopped after the timeout");
+
+    lifecycle.set_wanted(true, true);
+    check(lifecycle.update(2000 + worker_lifecycle::STANDBY_TIMEOUT_US, false) == action::none && !lifecycle.wakes_worker(),
+        "no new worker thread is started before the old one exited");
+    check(lifecycle.update(3000 + worker_lifecycle::STANDBY_TIMEOUT_US, true) == action::start && lifecycle.starts() == 2,
+        "a new worker thread is started once the old one exited");
+}
+
+static void test_standby_not_allowed()
+{
+    worker_lifecycle lifecycle;
+    lifecycle.set_wanted(true, true);
+    lifecycle.update(0, false);
+    lifecycle.set_wanted(false, false);
+    check(lifecycle.update(1, false) == action::stop, "the worker thread is stopped right away when nothing could show the overlay");
+    check(lifecycle.update(2, false) == action::none && lifecycle.get_state() == state::stopping, "it is only told to stop once");
+    check(lifecycle.update(3, true) == action::none && lifecycle.get_state() == state::stopped, "it is stopped once it exited");
+}
+
+/// <summary>An auto-reset event like the one that wakes the worker thread.</summary>
+class auto_reset_event
+{
+public:
+    void set()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _signaled = true;
+        _condition.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return _signaled; });
+        _signaled = false;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _signaled = false;
+};
+
+/// <summary>
+/// A stand-in for the worker thread and the state the render thread keeps for it. A pass usually takes a fraction of
+/// a millisecond, but now and then gets stuck for much longer. Every worker thread sets up its buffers once when it
+/// starts, so that resuming a parked one can be told from starting a new one.
+/// </summary>
+struct stand_in_worker
+{
+    static constexpr uint32_t STUCK_MS = 60;
+
+    std::thread thread;
+    auto_reset_event* go = nullptr;
+    std::atomic<bool> busy{ false };
+    std::atomic<bool> terminate{ false };
+    std::atomic<bool> exited{ false };
+    std::atomic<uint32_t> alive{ 0 };
+    std::atomic<bool> overlapped{ false };
+    std::atomic<uint64_t> passes{ 0 }, stuck_passes{ 0 }, buffer_setups{ 0 };
+
+    /// <summary>Starts a worker thread, which makes its first pass right away, like start_worker().</summary>
+    void start(uint32_t seed)
+    {
+        go = new auto_reset_event();
+        busy = true;
+        exited = false;
+        thread = std::thread([this, seed]() { run(seed); });
+    }
+
+    /// <summary>Cleans up after a worker thread that exited, like update_worker_lifecycle().</summary>
+    void clean_up()
+    {
+        if (thread.joinable())
+            thread.join();
+        delete go;
+        go = nullptr;
+        terminate = false;
+        busy = false;
+    }
+
+private:
+    void run(uint32_t seed)
+    {
+        if (++alive > 1)
+            overlapped = true;
+        buffer_setups++;
+        std::mt19937 random(seed);
+        while (!terminate.load(std::memory_order_acquire))
+        {
+            const bool stuck = random() % 16 == 0;
+            std::this_thread::sleep_for(stuck ? std::chrono::microseconds(STUCK_MS * 1000) : std::chrono::microseconds(200));
+            passes++;
+            stuck_passes += stuck;
+            busy.store(false, std::memory_order_release);
+            go->wait();
+            if (terminate.load(std::memory_order_acquire))
+                break;
+        }
+        alive--;
+        exited.store(true, std::memory_order_release);
+    }
+};
+
+/// <summary>
+/// Shows and hides the overlay at random, sometimes on every frame, while the worker thread gets stuck now and then.
+/// Every frame runs what the render thread does: update the lifecycle, start or stop the worker thread as it says and
+/// wake the worker thread when it isn't busy. The clock the lifecycle sees moves a 60 Hz frame on every frame, and
+/// now and then the overlay stays hidden past the standby timeout or the last device goes away, so that the worker
+/// thread is stopped and started again while the overlay keeps flipping.
+/// </summary>
+static void test_toggle_stress(uint32_t frames)
+{
+    worker_lifecycle lifecycle;
+    stand_in_worker worker;
+    std::mt19937 random(18);
+    bool visible = false, lifecycle_visible = false, standby_allowed = true;
+    uint64_t now_us = 0, wakes = 0, stops = 0, toggles = 0;
+    std::vector<double> frame_us;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        now_us += 16667;
+        const uint32_t phase = frame % 400;
+        if (phase < 100)
+            visible = random() % 2 == 0; // A burst of toggles on every frame.
+        else if (random() % 20 == 0)
+            visible = !visible;
+        standby_allowed = phase != 300;
+        if (phase == 200)
+        {
+            visible = false;
+            now_us += worker_lifecycle::STANDBY_TIMEOUT_US;
+        }
+        toggles += visible != lifecycle_visible;
+        lifecycle_visible = visible;
+
+        const benchmark_clock::time_point start = benchmark_clock::now();
+        lifecycle.set_wanted(visible, standby_allowed);
+        bool exited = false;
+        if (lifecycle.get_state() == state::stopping)
+        {
+            exited = worker.exited.load(std::memory_order_acquire);
+            if (exited)
+                worker.clean_up();
+        }
+        switch (lifecycle.update(now_us, exited))
+        {
+        case action::start:
+            worker.start(frame);
+            break;
+        case action::stop:
+            worker.terminate.store(true, std::memory_order_release);
+            worker.go->set();
+            stops++;
+            break;
+        default:
+            break;
+        }
+        if (lifecycle.wakes_worker() && !worker.busy.load(std::memory_order_acquire))
+        {
+            worker.busy.store(true, std::memory_order_relaxed);
+            worker.go->set();
+            wakes++;
+        }
+        frame_us.push_back(std::chrono::duration<double, std::micro>(benchmark_clock::now() - start).count());
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The last device goes away: the worker thread is stopped and cleaned up without waiting for it on any frame.
+    lifecycle.set_wanted(false, false);
+    for (bool exited = false; lifecycle.get_state() != state::stopped; )
+    {
+        if (lifecycle.get_state() == state::stopping && (exited = worker.exited.load(std::memory_order_acquire)))
+            worker.clean_up();
+        if (lifecycle.update(now_us += 16667, exited) == action::stop)
+        {
+            worker.terminate.store(true, std::memory_order_release);
+            worker.go->set();
+            stops++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::sort(frame_us.begin(), frame_us.end());
+    const double max_frame_us = frame_us.back();
+    printf("toggle stress: %u frames, %llu changes in visibility, %llu wakes, %llu passes of which %llu got stuck for %u ms\n",
+        frames, (unsigned long long)toggles, (unsigned long long)wakes, (unsigned long long)worker.passes.load(),
+        (unsigned long long)worker.stuck_passes.load(), stand_in_worker::STUCK_MS);
+    printf("               %llu worker threads started, %llu stopped, %llu resumed from standby; time per frame %.1f us median, %.1f us p99, %.1f us max\n",
+        (unsigned long long)lifecycle.starts(), (unsigned long long)stops, (unsigned long long)lifecycle.resumes(),
+        frame_us[frame_us.size() / 2], frame_us[size_t(0.99 * (frame_us.size() - 1))], max_frame_us);
+    check(worker.stuck_passes > 0, "the worker thread got stuck during the stress test");
+    check(max_frame_us < stand_in_worker::STUCK_MS * 1000 / 2, "a frame never waits for a stuck worker thread");
+    check(!worker.overlapped, "there is never more than one worker thread");
+    check(lifecycle.starts() == worker.buffer_setups && lifecycle.starts() == stops, "every worker thread started was stopped again");
+    check(lifecycle.resumes() > 10 * lifecycle.starts(), "showing the overlay again mostly resumes the parked worker thread");
+    check(worker.alive == 0 && !worker.thread.joinable(), "every worker thread exited");
+}
+
+int main()
+{
+    test_show_and_hide();
+    test_standby_timeout();
+    test_standby_not_allowed();
+    test_toggle_stress(2400);
+    printf("%s\n", g_failures == 0 ? "All tests passed." : "Some tests FAILED.");
+    return g_failures == 0 ? 0 : 1;
+}
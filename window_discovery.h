@@ -0,0 +1,254 @@
+#ifndef WINDOW_DISCOVERY_H
+#define WINDOW_DISCOVERY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cwctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>Access to the desktop's top-level windows and the processes they belong to.</summary>
+class window_enumerator
+{
+public:
+    typedef uintptr_t window_id;
+
+    virtual ~window_enumerator() {}
+
+    /// <summary>Appends all top-level windows to the list.</summary>
+    virtual void enumerate(std::vector<window_id>& windows) = 0;
+    /// <summary>Checks whether the window exists and is visible.</summary>
+    virtual bool is_visible(window_id window) = 0;
+    /// <summary>Gets the id of the process that created the window, or 0 if the window is gone.</summary>
+    virtual uint32_t get_process_id(window_id window) = 0;
+    /// <summary>Gets the path of the process' executable. Returns false if the process can't be queried.</summary>
+    virtual bool get_process_image(uint32_t process_id, std::wstring& image) = 0;
+    /// <summary>Gets the window's title. Returns false if the window is gone.</summary>
+    virtual bool get_title(window_id window, std::wstring& title) = 0;
+};
+
+/// <summary>
+/// Keeps track of the one window that matches an executable name and a window title. Instead of polling all windows,
+/// it is told about created, shown, renamed, hidden and destroyed windows and only examines those. Whether a process
+/// runs the wanted executable is cached, so the expensive process query happens once per process rather than once
+/// per window and event. When no notifications are available, polling mode scans all windows once per interval.
+/// </summary>
+class window_discovery
+{
+public:
+    /// <summary>Minimum time between two scans over all windows.</summary>
+    static constexpr uint64_t SCAN_INTERVAL_US = 1000000;
+    /// <summary>How long a cached process lookup is trusted, since process ids are eventually reused.</summary>
+    static constexpr uint64_t PROCESS_CACHE_TTL_US = 60000000;
+    /// <summary>Notifications kept between two calls to find() before falling back to a scan over all windows.</summary>
+    static constexpr size_t MAX_PENDING = 1024;
+
+    /// <param name="enumerator">Access to the windows.</param>
+    /// <param name="image_suffix">The end of the wanted executable's path, including the path separator, in any case.</param>
+    /// <param name="title">The wanted window title, where * matches any text and ? any single character.</param>
+    window_discovery(window_enumerator& enumerator, const wchar_t* image_suffix, const wchar_t* title) :
+        _enumerator(enumerator), _image_suffix(image_suffix), _title(title)
+    {
+    }
+
+    /// <summary>Switches between scanning all windows periodically and relying on notifications.</summary>
+    void set_polling(bool polling)
+    {
+        _polling = polling;
+        _scan_requested = true;
+    }
+
+    /// <summary>Notifies about a window that was created, shown or renamed.</summary>
+    void on_window_changed(window_enumerator::window_id window)
+    {
+        if (_current == 0)
+        {
+            // Windows tend to send several events in a row, and a flood of them is cheaper handled by one scan.
+            if (!_pending.empty() && _pending.back() == window)
+                return;
+            if (_pending.size() >= MAX_PENDING)
+            {
+                _pending.clear();
+                _scan_requested = true;
+                return;
+            }
+            _pending.push_back(window);
+        }
+        else if (window == _current)
+        {
+            // A renamed window is checked again on its own, so that it is kept right away if its title still matches,
+            // and only if it doesn't are all windows scanned for another one.
+            _current = 0;
+            _pending.push_back(window);
+            _rechecking = window;
+        }
+    }
+
+    /// <summary>Notifies about a window that was hidden or destroyed.</summary>
+    void on_window_removed(window_enumerator::window_id window)
+    {
+        if (window == _current)
+            invalidate();
+    }
+
+    /// <summary>Forgets the current window, e.g. because it can no longer be captured, and looks for it again.</summary>
+    void invalidate()
+    {
+        _current = 0;
+        _scan_requested = true;
+    }
+
+    /// <summary>Examines the windows that changed since the last call, or all windows if a scan is due.</summary>
+    /// <param name="now_us">The current time in microseconds.</param>
+    /// <returns>The matching window or 0 if there is none.</returns>
+    window_enumerator::window_id find(uint64_t now_us)
+    {
+        if (_current != 0)
+            return _current;
+
+        if ((_scan_requested || _polling) && (!_scanned || now_us - _last_scan_us >= SCAN_INTERVAL_US))
+        {
+            _scan_requested = false;
+            _scanned = true;
+            _last_scan_us = now_us;
+            _enumerator.enumerate(_pending);
+            prune_process_cache(now_us);
+        }
+
+        // Querying a window's title sends it a message, during which notifications can arrive and add to _pending, so
+        // examine a list of our own. Windows that show up meanwhile are examined on the next call.
+        std::swap(_pending, _examining);
+        std::sort(_examining.begin(), _examining.end());
+        _examining.erase(std::unique(_examining.begin(), _examining.end()), _examining.end());
+        for (window_enumerator::window_id window : _examining)
+        {
+            if (matches(window, now_us))
+            {
+                _current = window;
+                break;
+            }
+        }
+        _examining.clear();
+        if (_current != 0)
+            _pending.clear();
+        else if (_rechecking != 0)
+        {
+            // Losing the current window to a rename is rare, so the scan for another one doesn't wait for the interval.
+            _scan_requested = true;
+            _scanned = false;
+        }
+        _rechecking = 0;
+        return _current;
+    }
+
+    /// <summary>Number of processes whose executable was actually queried, for statistics.</summary>
+    uint64_t process_queries() const
+    {
+        return _process_queries;
+    }
+
+private:
+    struct process_info
+    {
+        bool matches;
+        uint64_t time_us;
+    };
+
+    bool matches(window_enumerator::window_id window, uint64_t now_us)
+    {
+        // Window must not be a hidden window.
+        if (!_enumerator.is_visible(window))
+            return false;
+
+        // Check that this window belongs to the right process, as it could be e.g. an Explorer window open on the
+        // folder of the executable.
+        const uint32_t process_id = _enumerator.get_process_id(window);
+        if (process_id == 0)
+            return false;
+        auto it = _processes.find(process_id);
+        if (it == _processes.end() || now_us - it->second.time_us >= PROCESS_CACHE_TTL_US)
+        {
+            _process_queries++;
+            const bool matches = _enumerator.get_process_image(process_id, _text) && ends_with(_text, _image_suffix);
+            it = _processes.insert_or_assign(process_id, process_info { matches, now_us }).first;
+        }
+        if (!it->second.matches)
+            return false;
+
+        // We check the title after identifying the process or else we could query our game's window which might
+        // become unresponsive.
+        return _enumerator.get_title(window, _text) && matches_pattern(_text.c_str(), _title.c_str());
+    }
+
+    /// <summary>Matches text against a pattern with * and ? wildcards.</summary>
+    static bool matches_pattern(const wchar_t* text, const wchar_t* pattern)
+    {
+        // Backtrack to the last * on a mismatch, which is enough since a later * can match everything an earlier could.
+        const wchar_t* star = nullptr;
+        const wchar_t* star_text = nullptr;
+        while (*text != L'\0')
+        {
+            if (*pattern == L'*')
+            {
+                star = pattern++;
+                star_text = text;
+            }
+            else if (*pattern == L'?' || *pattern == *text)
+            {
+                pattern++;
+                text++;
+            }
+            else if (star != nullptr)
+            {
+                pattern = star + 1;
+                text = ++star_text;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (*pattern == L'*')
+            pattern++;
+        return *pattern == L'\0';
+    }
+
+    void prune_process_cache(uint64_t now_us)
+    {
+        for (auto it = _processes.begin(); it != _processes.end();)
+        {
+            if (now_us - it->second.time_us >= PROCESS_CACHE_TTL_US)
+                it = _processes.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    /// <summary>Compares the end of a path case-insensitively, like Windows compares file names.</summary>
+    static bool ends_with(const std::wstring& text, const std::wstring& suffix)
+    {
+        if (text.size() < suffix.size())
+            return false;
+        return std::equal(suffix.begin(), suffix.end(), text.end() - suffix.size(),
+            [](wchar_t a, wchar_t b) { return towlower(wint_t(a)) == towlower(wint_t(b)); });
+    }
+
+    window_enumerator& _enumerator;
+    const std::wstring _image_suffix;
+    const std::wstring _title;
+    window_enumerator::window_id _current = 0;
+    window_enumerator::window_id _rechecking = 0;
+    std::vector<window_enumerator::window_id> _pending;
+    std::vector<window_enumerator::window_id> _examining;
+    std::unordered_map<uint32_t, process_info> _processes;
+    std::wstring _text;
+    bool _polling = false;
+    bool _scan_requested = true;
+    bool _scanned = false;
+    uint64_t _last_scan_us = 0;
+    uint64_t _process_queries = 0;
+};
+
+#endif //WINDOW_DISCOVERY_H
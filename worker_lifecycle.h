@@ -0,0 +1,112 @@
+#ifndef WORKER_LIFECYCLE_H
+#define WORKER_LIFECYCLE_H
+
+#include <cstdint>
+
+/// <summary>
+/// Decides when the worker thread is started, parked and stopped, so that the render thread never has to wait for
+/// it. Hiding the overlay only parks the worker thread: it isn't woken anymore, but keeps its window handles and
+/// buffers, so that showing the overlay again resumes with the next frame. Only after a while in standby, or when
+/// nothing could show the overlay anymore, is the worker thread told to stop, without waiting for it to do so. A
+/// new worker thread is only started after the previous one exited, since they would share the same state. Like
+/// capture_scheduler it doesn't read any clock itself; all times are passed in by the caller in microseconds.
+/// </summary>
+class worker_lifecycle
+{
+public:
+    /// <summary>How long the worker thread stays parked before it is stopped.</summary>
+    static constexpr uint64_t STANDBY_TIMEOUT_US = 60000000;
+
+    enum class state
+    {
+        stopped,  // There is no worker thread.
+        running,  // The worker thread is woken for captures.
+        standby,  // The worker thread is parked and isn't woken.
+        stopping  // The worker thread was told to stop, but hasn't exited yet.
+    };
+
+    enum class action
+    {
+        none,
+        start, // Start a worker thread.
+        stop   // Tell the worker thread to stop, without waiting for it.
+    };
+
+    /// <summary>Changes what the worker thread is needed for. Takes effect on the next call to update().</summary>
+    /// <param name="visible">Whether the overlay is shown, so the worker thread should capture.</param>
+    /// <param name="standby_allowed">Whether the worker thread may stay parked while the overlay is hidden, because it
+    /// could be shown again.</param>
+    void set_wanted(bool visible, bool standby_allowed)
+    {
+        _visible = visible;
+        _standby_allowed = standby_allowed;
+    }
+
+    /// <summary>Advances the lifecycle and tells the caller what to do for it.</summary>
+    /// <param name="now_us">The current time.</param>
+    /// <param name="exited">Whether the worker thread that was told to stop has exited.</param>
+    action update(uint64_t now_us, bool exited)
+    {
+        if (_state == state::stopping && exited)
+            _state = state::stopped;
+
+        if (_state == state::stopped && _visible)
+        {
+            _state = state::running;
+            _starts++;
+            return action::start;
+        }
+        if (_state == state::running && !_visible)
+        {
+            _state = state::standby;
+            _standby_since_us = now_us;
+        }
+        if (_state == state::standby)
+        {
+            if (_visible)
+            {
+                _state = state::running;
+                _resumes++;
+            }
+            else if (!_standby_allowed || now_us - _standby_since_us >= STANDBY_TIMEOUT_US)
+            {
+                _state = state::stopping;
+                return action::stop;
+            }
+        }
+        return action::none;
+    }
+
+    state get_state() const
+    {
+        return _state;
+    }
+
+    /// <summary>Whether the worker thread may be woken for a capture.</summary>
+    bool wakes_worker() const
+    {
+        return _state == state::running;
+    }
+
+    /// <summary>Number of worker threads started so far.</summary>
+    uint64_t starts() const
+    {
+        return _starts;
+    }
+
+    /// <summary>Number of times a parked worker thread was resumed instead of starting a new one.</summary>
+    uint64_t resumes() const
+    {
+        return _resumes;
+    }
+
+private:
+    state _state = state::stopped;
+    bool _visible = false;
+    bool _standby_allowed = false;
+    uint64_t _standby_since_us = 0;
+    uint64_t _starts = 0;
+    uint64_t _resumes = 0;
+};
+
+#endif //WORKER_LIFECYCLE_H